@@ -30,122 +30,146 @@ SOFTWARE.
 const DEBUG = false;
 var DEBUG_IP = "IP_address_here"; // TODO put your IP address here
 
-const UPDATE_TIME = 1000;
-var getStatus_interval;
+const STATUS_TIMEOUT = 5000; // the board sends a status event at least every 2 seconds
+var board_status;
+var status_timeout;
 var connection_error_alert = false;
 
 function start() {
-    setTimeout(getStatus, 0);
-    getStatus_interval = setInterval(getStatus, UPDATE_TIME);
+    // full status at the connection, then only the changed fields
+    const source = new ReconnectingEventSource(`${DEBUG ? `http://${DEBUG_IP}` : ""}/status_sse`);
+    source.addEventListener("snapshot", function (e) {
+        board_status = JSON.parse(e.data)["rsp"];
+        updateStatus(board_status);
+    });
+    source.addEventListener("delta", function (e) {
+        if (board_status == undefined) return;
+        mergeStatus(board_status, JSON.parse(e.data)["rsp"]);
+        updateStatus(board_status);
+    });
+    source.addEventListener("heartbeat", function (e) {
+        if (board_status != undefined) updateStatus(board_status);
+    });
+    source.onerror = function (e) {
+        board_status = undefined;
+        statusUnavailable();
+    };
 }
 
-function getStatus() {
-    const request = new Request(`${DEBUG ? `http://${DEBUG_IP}` : ""}/api?json=${encodeURIComponent(JSON.stringify({ "cmd": "status" }))}`);
-    fetchTimeout(request)
-        .then(rsp => {
-            if (connection_error_alert) {
-                connection_error_alert = false;
-                Toast.fire({
-                    icon: "success",
-                    title: "Connection restored"
-                });
-            }
-            // update main buttons
-            document.getElementById("current-status-box").style.opacity = 1;
-            document.getElementById("current-status-man").style.display = !rsp["optoin"]["auto"] ? "" : "none";
-            document.getElementById("current-status").innerText = `Azimuth: ${rsp["dome-azimuth"]}°${rsp["movement-status"] ? `, moving to ${rsp["target-azimuth"]}°` : ""}`;
-            const disable_motion_buttons = !rsp["optoin"]["auto"];
-            document.getElementById("az-target").disabled = disable_motion_buttons;
-            document.getElementById("slew-to-az-button").disabled = disable_motion_buttons;
-            document.getElementById("slew-to-az-button").className = rsp["movement-status"] ? "orange" : "gray";
-            document.getElementById("park-button").disabled = disable_motion_buttons;
-            document.getElementById("abort-button").disabled = disable_motion_buttons;
-            // update other buttons
-            document.getElementById("ignite-switchboard-button").disabled = rsp["optoin"]["switchboard-status"] || disable_motion_buttons;
-            document.getElementById("find-zero-button").disabled = disable_motion_buttons;
-            document.getElementById("restart-button").disabled = false;
-            document.getElementById("force-restart-button").disabled = false;
-            document.getElementById("turn-off-button").disabled = disable_motion_buttons;
-            document.getElementById("reset-EEPROM-button").disabled = false;
-            // document.getElementById("log").disabled = false;
-            document.getElementById("infoButton").disabled = false;
-            // update informations
-            document.getElementById("firmware-version").innerText = rsp["firmware-version"];
-            document.getElementById("uptime").innerText = rsp["uptime"];
-            document.getElementById("dome-azimuth").innerText = rsp["dome-azimuth"];
-            document.getElementById("target-azimuth").innerText = rsp["target-azimuth"];
-            document.getElementById("movement-status").innerText = rsp["movement-status"];
-            document.getElementById("in-park").innerText = rsp["in-park"];
-            document.getElementById("finding-park").innerText = rsp["finding-park"];
-            document.getElementById("finding-zero").innerText = rsp["finding-zero"];
-            document.getElementById("relay-list").innerText = "";
-            for (const el of rsp["relay"]["list"]) document.getElementById("relay-list").innerText += `${(el | 0)}`;
-            document.getElementById("cw-motor").innerText = rsp["relay"]["cw-motor"];
-            document.getElementById("ccw-motor").innerText = rsp["relay"]["ccw-motor"];
-            document.getElementById("switchboard").innerText = rsp["relay"]["switchboard"];
-            document.getElementById("optoin-list").innerText = "";
-            for (const el of rsp["optoin"]["list"]) document.getElementById("optoin-list").innerText += `${(el | 0)}`;
-            document.getElementById("auto").innerText = rsp["optoin"]["auto"];
-            document.getElementById("switchboard-status").innerText = rsp["optoin"]["switchboard-status"];
-            document.getElementById("ac-presence").innerText = rsp["optoin"]["ac-presence"];
-            document.getElementById("manual-cw-button").innerText = rsp["optoin"]["manual-cw-button"];
-            document.getElementById("manual-ccw-button").innerText = rsp["optoin"]["manual-ccw-button"];
-            document.getElementById("manual-ignition").innerText = rsp["optoin"]["manual-ignition"];
-            document.getElementById("hostname").innerText = rsp["wifi"]["hostname"];
-            document.getElementById("mac-address").innerText = rsp["wifi"]["mac-address"];
-        })
-        .catch(error => {
-            console.trace(`An error has occured: ${error.message}`);
-            if (!connection_error_alert) {
-                connection_error_alert = true;
-                Toast2.fire({
-                    icon: "error",
-                    title: "Connection error",
-                    text: "Unable to connect to the controller."
-                });
-            }
-            // update page with default
-            // disable main buttons
-            document.getElementById("current-status-box").style.opacity = 0.4;
-            document.getElementById("current-status-man").style.display = "none";
-            document.getElementById("current-status").innerText = "Status unavailable";
-            document.getElementById("az-target").disabled = true;
-            document.getElementById("slew-to-az-button").disabled = true;
-            document.getElementById("slew-to-az-button").className = "gray";
-            document.getElementById("park-button").disabled = true;
-            document.getElementById("abort-button").disabled = true;
-            // disable other buttons
-            document.getElementById("ignite-switchboard-button").disabled = true;
-            document.getElementById("find-zero-button").disabled = true;
-            document.getElementById("restart-button").disabled = true;
-            document.getElementById("force-restart-button").disabled = true;
-            document.getElementById("turn-off-button").disabled = true;
-            document.getElementById("reset-EEPROM-button").disabled = true;
-            // document.getElementById("log").disabled = true;
-            document.getElementById("infoButton").disabled = true;
-            // default info
-            document.getElementById("firmware-version").innerText = "ND";
-            document.getElementById("uptime").innerText = "ND";
-            document.getElementById("dome-azimuth").innerText = "ND";
-            document.getElementById("target-azimuth").innerText = "ND";
-            document.getElementById("movement-status").innerText = "ND";
-            document.getElementById("in-park").innerText = "ND";
-            document.getElementById("finding-park").innerText = "ND";
-            document.getElementById("finding-zero").innerText = "ND";
-            document.getElementById("relay-list").innerText = "ND";
-            document.getElementById("cw-motor").innerText = "ND";
-            document.getElementById("ccw-motor").innerText = "ND";
-            document.getElementById("switchboard").innerText = "ND";
-            document.getElementById("optoin-list").innerText = "ND";
-            document.getElementById("auto").innerText = "ND";
-            document.getElementById("switchboard-status").innerText = "ND";
-            document.getElementById("ac-presence").innerText = "ND";
-            document.getElementById("manual-cw-button").innerText = "ND";
-            document.getElementById("manual-ccw-button").innerText = "ND";
-            document.getElementById("manual-ignition").innerText = "ND";
-            document.getElementById("hostname").innerText = "ND";
-            document.getElementById("mac-address").innerText = "ND";
+function mergeStatus(status, delta) {
+    for (const key in delta) {
+        if (typeof delta[key] == "object" && !Array.isArray(delta[key]) && typeof status[key] == "object") mergeStatus(status[key], delta[key]);
+        else status[key] = delta[key];
+    }
+}
+
+function updateStatus(rsp) {
+    // status unavailable if the events stop
+    clearTimeout(status_timeout);
+    status_timeout = setTimeout(statusUnavailable, STATUS_TIMEOUT);
+    if (connection_error_alert) {
+        connection_error_alert = false;
+        Toast.fire({
+            icon: "success",
+            title: "Connection restored"
+        });
+    }
+    // update main buttons
+    document.getElementById("current-status-box").style.opacity = 1;
+    document.getElementById("current-status-man").style.display = !rsp["optoin"]["auto"] ? "" : "none";
+    document.getElementById("current-status").innerText = `Azimuth: ${rsp["dome-azimuth"]}°${rsp["movement-status"] ? `, moving to ${rsp["target-azimuth"]}°` : ""}`;
+    const disable_motion_buttons = !rsp["optoin"]["auto"];
+    document.getElementById("az-target").disabled = disable_motion_buttons;
+    document.getElementById("slew-to-az-button").disabled = disable_motion_buttons;
+    document.getElementById("slew-to-az-button").className = rsp["movement-status"] ? "orange" : "gray";
+    document.getElementById("park-button").disabled = disable_motion_buttons;
+    document.getElementById("abort-button").disabled = disable_motion_buttons;
+    // update other buttons
+    document.getElementById("ignite-switchboard-button").disabled = rsp["optoin"]["switchboard-status"] || disable_motion_buttons;
+    document.getElementById("find-zero-button").disabled = disable_motion_buttons;
+    document.getElementById("restart-button").disabled = false;
+    document.getElementById("force-restart-button").disabled = false;
+    document.getElementById("turn-off-button").disabled = disable_motion_buttons;
+    document.getElementById("reset-EEPROM-button").disabled = false;
+    // document.getElementById("log").disabled = false;
+    document.getElementById("infoButton").disabled = false;
+    // update informations
+    document.getElementById("firmware-version").innerText = rsp["firmware-version"];
+    document.getElementById("uptime").innerText = rsp["uptime"];
+    document.getElementById("dome-azimuth").innerText = rsp["dome-azimuth"];
+    document.getElementById("target-azimuth").innerText = rsp["target-azimuth"];
+    document.getElementById("movement-status").innerText = rsp["movement-status"];
+    document.getElementById("in-park").innerText = rsp["in-park"];
+    document.getElementById("finding-park").innerText = rsp["finding-park"];
+    document.getElementById("finding-zero").innerText = rsp["finding-zero"];
+    document.getElementById("relay-list").innerText = "";
+    for (const el of rsp["relay"]["list"]) document.getElementById("relay-list").innerText += `${(el | 0)}`;
+    document.getElementById("cw-motor").innerText = rsp["relay"]["cw-motor"];
+    document.getElementById("ccw-motor").innerText = rsp["relay"]["ccw-motor"];
+    document.getElementById("switchboard").innerText = rsp["relay"]["switchboard"];
+    document.getElementById("optoin-list").innerText = "";
+    for (const el of rsp["optoin"]["list"]) document.getElementById("optoin-list").innerText += `${(el | 0)}`;
+    document.getElementById("auto").innerText = rsp["optoin"]["auto"];
+    document.getElementById("switchboard-status").innerText = rsp["optoin"]["switchboard-status"];
+    document.getElementById("ac-presence").innerText = rsp["optoin"]["ac-presence"];
+    document.getElementById("manual-cw-button").innerText = rsp["optoin"]["manual-cw-button"];
+    document.getElementById("manual-ccw-button").innerText = rsp["optoin"]["manual-ccw-button"];
+    document.getElementById("manual-ignition").innerText = rsp["optoin"]["manual-ignition"];
+    document.getElementById("hostname").innerText = rsp["wifi"]["hostname"];
+    document.getElementById("mac-address").innerText = rsp["wifi"]["mac-address"];
+}
+
+function statusUnavailable() {
+    clearTimeout(status_timeout);
+    if (!connection_error_alert) {
+        connection_error_alert = true;
+        Toast2.fire({
+            icon: "error",
+            title: "Connection error",
+            text: "Unable to connect to the controller."
         });
+    }
+    // update page with default
+    // disable main buttons
+    document.getElementById("current-status-box").style.opacity = 0.4;
+    document.getElementById("current-status-man").style.display = "none";
+    document.getElementById("current-status").innerText = "Status unavailable";
+    document.getElementById("az-target").disabled = true;
+    document.getElementById("slew-to-az-button").disabled = true;
+    document.getElementById("slew-to-az-button").className = "gray";
+    document.getElementById("park-button").disabled = true;
+    document.getElementById("abort-button").disabled = true;
+    // disable other buttons
+    document.getElementById("ignite-switchboard-button").disabled = true;
+    document.getElementById("find-zero-button").disabled = true;
+    document.getElementById("restart-button").disabled = true;
+    document.getElementById("force-restart-button").disabled = true;
+    document.getElementById("turn-off-button").disabled = true;
+    document.getElementById("reset-EEPROM-button").disabled = true;
+    // document.getElementById("log").disabled = true;
+    document.getElementById("infoButton").disabled = true;
+    // default info
+    document.getElementById("firmware-version").innerText = "ND";
+    document.getElementById("uptime").innerText = "ND";
+    document.getElementById("dome-azimuth").innerText = "ND";
+    document.getElementById("target-azimuth").innerText = "ND";
+    document.getElementById("movement-status").innerText = "ND";
+    document.getElementById("in-park").innerText = "ND";
+    document.getElementById("finding-park").innerText = "ND";
+    document.getElementById("finding-zero").innerText = "ND";
+    document.getElementById("relay-list").innerText = "ND";
+    document.getElementById("cw-motor").innerText = "ND";
+    document.getElementById("ccw-motor").innerText = "ND";
+    document.getElementById("switchboard").innerText = "ND";
+    document.getElementById("optoin-list").innerText = "ND";
+    document.getElementById("auto").innerText = "ND";
+    document.getElementById("switchboard-status").innerText = "ND";
+    document.getElementById("ac-presence").innerText = "ND";
+    document.getElementById("manual-cw-button").innerText = "ND";
+    document.getElementById("manual-ccw-button").innerText = "ND";
+    document.getElementById("manual-ignition").innerText = "ND";
+    document.getElementById("hostname").innerText = "ND";
+    document.getElementById("mac-address").innerText = "ND";
 }
 
 function command(command) {
@@ -69,17 +69,23 @@ SOFTWARE.
 #include <EEPROM.h>
 #include <ESPAsyncWebServer.h>
 #include <HTTPClient.h>
+#include <Preferences.h>
 #include <SPIFFS.h>
 #include <StreamUtils.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
+#include <mbedtls/md.h>
 #include <uptime.h>
 #include <uptime_formatter.h>
 
+#include <atomic>
+#include <memory>
 #include <vector>
 
 #include "CustomOptoIn.hpp"
 #include "KMPCommon.h"
+#include "RS485Frame.hpp"
+#include "api_registry.hpp"
 
 ////////////////////////////////////////////////////////////////////////////////
 // VARIABLES
@@ -106,9 +112,123 @@ extern bool blink_led_loop;
  * during critical operations such as the final stages of the motion. */
 extern SemaphoreHandle_t xSemaphore;
 
-/* RS485 semaphore: one reading per time */
-extern SemaphoreHandle_t xSemaphore_rs485;
-#define SEMAPHORE_RS485_TIMEOUT pdMS_TO_TICKS(250)
+/* Input changes (expander INT output for optoin 1-4, J14 pins for optoin 5-8)
+ * are delivered by interrupts as notifications to the loop task, so the loop
+ * reacts within a few milliseconds instead of polling the inputs. */
+// loop task handle, notified at each input change
+extern TaskHandle_t loop_task_handle;
+// max time between two loop passes without input changes (periodic work keeps its own timers)
+#define LOOP_INTERVAL pdMS_TO_TICKS(100)
+
+struct InputLatencyStats {
+    uint32_t last_us; // last input-to-relay reaction time, in microseconds
+    uint32_t max_us;  // max reaction time since start up
+    uint32_t count;   // number of measured reactions
+};
+
+#define RS485_BAUD_RATE 19200
+// max time to wait for the first byte of an encoder response (the encoder board is slow to answer)
+#define RS485_RESPONSE_TIMEOUT pdMS_TO_TICKS(300)
+// max time to wait between two bytes of the same encoder response
+#define RS485_INTER_BYTE_TIMEOUT pdMS_TO_TICKS(30)
+
+/* RS485 transaction scheduler: the RS485 bus is owned by the encoder task, the
+ * other tasks submit transactions and wait for their results. Transactions are
+ * served by priority class (lower value first) and in submission order inside
+ * the same class. */
+enum class RS485Priority {
+    Emergency = 0,       // commands that can not wait (e.g. last position reading before power off)
+    MotionFeedback = 1,  // position readings and find-zero, never delayed by config and siren
+    Config = 2,          // encoder configuration commands
+    Siren = 3,           // siren commands
+};
+#define RS485_PRIORITY_COUNT 4
+
+enum class RS485Result {
+    Done,       // command sent and, if expected, complete response received
+    NoData,     // command sent but no (or incomplete) response received
+    Expired,    // deadline reached before the transaction was executed
+    QueueFull,  // no free transaction slot
+};
+
+// max number of pending transactions (of all the priority classes)
+#define RS485_QUEUE_SIZE 8
+// max length of a transaction request
+#define RS485_MAX_REQUEST_SIZE 9
+// default max time a transaction can wait in queue before being executed
+#define RS485_DEFAULT_DEADLINE pdMS_TO_TICKS(1000)
+// max time to execute a transaction once started (write, then wait the whole response frame)
+#define RS485_EXECUTION_TIMEOUT (RS485_RESPONSE_TIMEOUT + 8 * RS485_INTER_BYTE_TIMEOUT + pdMS_TO_TICKS(50))
+
+// RS485 link statistics: number of buckets of the round-trip latency histograms, and their upper bounds in
+// microseconds (the last bucket has no upper bound)
+#define RS485_STATS_BUCKETS 9
+const uint32_t rs485_stats_bucket_bounds[RS485_STATS_BUCKETS - 1]{1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000};
+// number of encoder commands with their own latency histogram (0x23, 0x42, 0x44, 0x52, 0x57, 0x5A, 0xC0, 0xC1)
+#define RS485_STATS_COMMANDS 8
+
+enum class RS485StatsCounter {
+    Timeout,          // no response at all
+    ShortFrame,       // incomplete response
+    ChecksumError,    // response with a wrong checksum
+    QueueFull,        // transaction refused, no free slot
+    DeadlineExpired,  // transaction not executed within its deadline
+};
+
+struct RS485CommandStats {
+    byte command;
+    uint32_t count;                           // completed transactions
+    uint32_t histogram[RS485_STATS_BUCKETS];  // round-trip latency of the completed transactions
+    uint32_t max_us;
+    uint64_t total_us;
+};
+
+struct RS485Stats {
+    RS485CommandStats commands[RS485_STATS_COMMANDS];
+    uint32_t timeouts;
+    uint32_t short_frames;
+    uint32_t checksum_errors;
+    uint32_t queue_full;
+    uint32_t deadline_expired;
+    unsigned long reset_time;  // millis() of the last reset
+};
+
+// handle to the result of a submitted RS485 transaction
+class RS485Future {
+   public:
+    RS485Future() : slot{-1} {}
+    explicit RS485Future(const int _slot) : slot{_slot} {}
+    RS485Future(RS485Future &&_other) : slot{_other.slot} { _other.slot = -1; }
+    RS485Future &operator=(RS485Future &&_other);
+    RS485Future(const RS485Future &) = delete;
+    RS485Future &operator=(const RS485Future &) = delete;
+    // a future dropped without waiting abandons its transaction (if not yet executed, it is skipped)
+    ~RS485Future();
+
+    /**
+     * @brief Wait for the transaction to be executed. The wait is bounded by the transaction deadline plus
+     * RS485_EXECUTION_TIMEOUT, after that the transaction is abandoned.
+     * @param _response where to store the response, can be nullptr
+     * @return The transaction result.
+     */
+    RS485Result wait(std::vector<byte> *_response = nullptr);
+
+    /**
+     * @brief Check, without waiting, if the transaction is executed (or abandoned, after the same bound of wait).
+     * @param _result where to store the transaction result, if available
+     * @param _response where to store the response, can be nullptr
+     * @return True if the result is available.
+     */
+    bool poll(RS485Result &_result, std::vector<byte> *_response = nullptr);
+
+   private:
+    // try to abandon the transaction, it fails if the transaction is already done
+    bool abandon();
+    // take the result of a done transaction, and free its slot
+    RS485Result collect(std::vector<byte> *_response);
+
+    int slot;  // index of the transaction slot, -1 if none
+};
 
 //////////
 
@@ -124,6 +244,10 @@ extern SemaphoreHandle_t xSemaphore_rs485;
 // indicate if the dome is moving, aka if any relays is on
 #define MOVEMENT_STATUS (IS_MOVING_CW || IS_MOVING_CCW)
 
+/* The optoins are read once per control tick (one SPI transaction for the
+ * expander, one register read for J14) into the optoin image, and the macros
+ * below are served from that snapshot. */
+
 // CW manual rotation button
 #define MAN_CW_O OptoInC::OptoInC1
 #define MAN_CW customOptoIn.getState(MAN_CW_O)
@@ -148,14 +272,278 @@ enum class DomeDirection {
     CCW
 };
 
+// manual rotation, advanced once per control tick by the loop: the motor runs while the button is held
+enum class ManualRotation {
+    Idle,
+    CW,
+    CCW
+};
+
+/* Debounced input engine: advanced once per control tick, it filters each
+ * optoin with its own time and keeps the timestamps of the edges. */
+// filter time of each optoin (by number, from OptoInC1 to OptoInC8), in milliseconds:
+// short for the buttons, longer for the switches and the AC presence
+const unsigned long input_filter_time[8]{30, 50, 100, 30, 30, 50, 200, 50};
+// control tick interval while an input is settling or a gesture is in progress
+#define INPUT_TICK_INTERVAL pdMS_TO_TICKS(10)
+
+struct DebouncedInput {
+    bool raw;                // state in the optoin image
+    bool state;              // debounced state
+    bool rose;               // debounced rising edge in the last tick
+    bool fell;               // debounced falling edge in the last tick
+    unsigned long raw_time;  // millis() of the last raw change
+    unsigned long rise_time; // millis() of the last debounced rising edge (0 if none since start up)
+    unsigned long fall_time; // millis() of the last debounced falling edge (0 if none since start up)
+};
+
+/* Manual button gesture: a pression longer than GESTURE_SIREN_DELAY starts the
+ * pre-rotation siren, and the gesture is completed when the button has been
+ * held for the required time after that. Advanced at each control tick, it
+ * never blocks the loop. */
+// pression time before the siren, in milliseconds
+#define GESTURE_SIREN_DELAY 250
+
+enum class GestureState {
+    Idle,
+    Pressed,  // button pressed, waiting GESTURE_SIREN_DELAY
+    Siren,    // siren playing, waiting the required pression time
+};
+
+struct ButtonGesture {
+    OptoInC button;
+    unsigned long hold_time;  // pression time required after the siren start, in milliseconds
+    GestureState state;
+    unsigned long press_time; // rise_time of the pression being handled, so each pression is handled once
+    RS485Future siren;        // siren transaction, not waited
+};
+
 #define PARK_POSITION 90
 #define ZERO_POSITION 248
 
-// current dome azimuth
+// current dome azimuth (last valid encoder reading)
 extern int current_az;
 // current dome target azimuth
 extern int target_az;
 
+// encoder reading errors (the values are the ones returned by domePosition)
+enum class EncoderError {
+    None = 0,
+    Generic = -1,
+    NoData = -3,
+    Outlier = -4,
+};
+
+// dome position published by the encoder task
+struct EncoderSample {
+    int azimuth;              // last valid dome azimuth, never an error code
+    unsigned long timestamp;  // millis() of the last valid reading
+    uint32_t sequence;        // incremented at each reading attempt
+    EncoderError error;       // result of the last reading attempt
+};
+
+/* Dead-reckoning azimuth estimator: between two encoder readings the azimuth is
+ * extrapolated from the last valid reading, the motion direction (given by the
+ * motor relays commands) and the rotation speed learned for that direction. The
+ * readings too far from the estimate are rejected as glitches. */
+// min motion time before measuring the rotation speed (motor spin-up), in milliseconds
+#define ESTIMATOR_SPIN_UP_TIME 1000
+// min time between two rotation speed measurements, in milliseconds
+#define ESTIMATOR_VELOCITY_BASELINE 1000
+// weight of a new rotation speed measurement in its exponential moving average
+#define ESTIMATOR_VELOCITY_ALPHA 0.2f
+// max plausible rotation speed, in degrees per second
+#define ESTIMATOR_MAX_VELOCITY 20.0f
+// max time the azimuth is extrapolated after the last valid reading, in milliseconds
+#define ESTIMATOR_MAX_EXTRAPOLATION 1000
+// weight of a reading in the correction of the estimate during the motion
+#define ESTIMATOR_READING_GAIN 0.3f
+// readings farther than this from the estimate are rejected, in degrees
+#define ESTIMATOR_OUTLIER_THRESHOLD 5.0f
+// consecutive rejected readings after which the next one is accepted anyway (real position jump)
+#define ESTIMATOR_OUTLIER_LIMIT 3
+
+struct EstimatorStatus {
+    float velocity_cw;          // learned clockwise rotation speed, in degrees per second (0 if not learned yet)
+    float velocity_ccw;         // learned counterclockwise rotation speed, in degrees per second (0 if not learned yet)
+    uint32_t outliers;          // number of rejected readings
+    int direction;              // current motion direction: 1 CW, -1 CCW, 0 stopped
+    unsigned long motion_time;  // millis() of the last motion direction change
+};
+
+/* Coast model: the dome keeps rotating after the motor relays are switched off.
+ * For each direction, the coast (settled azimuth minus cut-off azimuth) is
+ * learned at every stop from steady motion, and the slews cut the relays off
+ * early by the predicted coast so the dome settles on the target. */
+// the slew is stopped when the remaining path is less than the predicted coast plus this tolerance, in degrees
+#define COAST_CUTOFF_TOLERANCE 1.0f
+// max plausible coast, in degrees
+#define COAST_MAX 10.0f
+// weight of a new coast measurement in its exponential moving average
+#define COAST_ALPHA 0.3f
+// the dome is settled when the position does not change for this time, in milliseconds
+#define COAST_SETTLE_TIME 400
+// max time to wait for the dome to settle, in milliseconds
+#define COAST_SETTLE_TIMEOUT 2000
+// within this path (plus the predicted coast) from the target, the encoder is read faster, in degrees
+#define COAST_APPROACH_DISTANCE 10.0f
+// time between two encoder readings when approaching the target
+#define ENCODER_APPROACH_POLL_INTERVAL pdMS_TO_TICKS(25)
+
+// final error of the slews in one direction (settled azimuth minus target)
+struct SlewResidualStats {
+    uint32_t count;
+    float sum;      // sum of the errors, in degrees
+    float sum_abs;  // sum of the absolute errors, in degrees
+    float max_abs;  // max absolute error, in degrees
+};
+
+struct CoastStatus {
+    float coast[2];                    // learned coast, CW and CCW, in degrees
+    uint32_t samples[2];               // coast measurements, CW and CCW
+    SlewResidualStats residual[2];     // slew final errors, CW and CCW
+    unsigned long residual_reset_time; // millis() of the last reset of the final errors
+};
+
+// encoder task handle, used to request immediate readings and to signal new RS485 transactions
+extern TaskHandle_t encoder_task_handle;
+// periodic position reading enabled (after the initial position has been written to the encoder)
+extern std::atomic<bool> encoder_polling_enabled;
+// immediate position reading requested by requestEncoderSample
+extern std::atomic<bool> encoder_poll_requested;
+// siren playing, the position reading is suspended since any command stops the siren
+extern std::atomic<bool> siren_playing;
+// time between two encoder readings of the encoder task
+#define ENCODER_POLL_INTERVAL pdMS_TO_TICKS(100)
+// max time to wait for a new encoder reading when explicitly requested
+#define ENCODER_REQUEST_TIMEOUT pdMS_TO_TICKS(1000)
+
+/* Trajectory recorder: while the dome is moving, every encoder reading is
+ * stored in a preallocated ring buffer (no heap allocation during motion),
+ * tagged with the slew it belongs to, for offline tuning of the coast model. */
+// recorded samples (~20 bytes each): at 10 readings per second, more than 1.5 minutes of motion
+#define TRAJECTORY_BUFFER_SIZE 1024
+// slews remembered in the index (older slews are overwritten anyway by newer samples)
+#define TRAJECTORY_SLEWS 16
+
+enum class TrajectoryType : uint8_t {
+    Slew,
+    Park,
+    FindZero,
+    Manual,
+};
+
+struct TrajectorySample {
+    uint32_t timestamp;  // millis() of the reading
+    uint32_t latency_us; // RS485 round trip of the reading, in microseconds (0 if not read by the encoder task)
+    uint16_t slew;       // slew id
+    int16_t azimuth;     // encoder reading, or EncoderError
+    int16_t estimate;    // estimated azimuth, in tenths of degree (-10 if not available)
+    int16_t target;      // target azimuth, -1 if none
+    uint8_t relays;      // bit 0 CW relay, bit 1 CCW relay
+    TrajectoryType type; // type of the slew
+    uint16_t reserved;
+};
+
+/* Find-zero procedure: the dome rotates clockwise until the encoder finds the
+ * zero switch and answers the Z command. It is advanced once per control tick
+ * by the loop, while the encoder task keeps reading the position and picks the
+ * late Z response out of the position responses. */
+// max time to find the zero (more than a full revolution), in milliseconds
+#define FIND_ZERO_TIMEOUT 300000
+
+struct FindZeroStatus {
+    bool searching;            // procedure in progress
+    unsigned long start_time;  // millis() of the start
+    float travelled;           // clockwise path since the start, in degrees
+    float eta;                 // estimated time to the zero switch at the learned speed, in seconds (-1 if unknown)
+    bool found;                // zero switch reached by the last procedure
+};
+
+/* Command queue: the motion and power API commands are validated and queued by
+ * the web server, that answers immediately with the operation id, and executed
+ * by the loop (the control task) in submission order. The last operations are
+ * kept for the op-status command. A batch of operations (the /api/batch
+ * endpoint) is queued all or none, and aborted at the first failure; a
+ * find-zero or park of a batch runs until the end of its procedure, and holds
+ * the rest of the queue (aborts excluded) meanwhile. */
+// max number of queued operations
+#define OPERATION_QUEUE_SIZE 8
+// operations kept for op-status (queued ones included)
+#define OPERATION_HISTORY_SIZE 16
+
+enum class OperationType : uint8_t {
+    Abort,
+    SlewToAz,
+    Park,
+    FindZero,
+    IgniteSwitchboard,
+    Restart,
+    TurnOff,
+};
+
+enum class OperationState : uint8_t {
+    Queued,
+    Running,
+    Done,
+    Failed,
+};
+
+struct DomeOperation {
+    uint32_t id;                // operation id, from 1 (0 if empty)
+    OperationType type;
+    OperationState state;
+    uint16_t collapsed;         // slew-to-az commands merged into this operation while queued
+    int target;                 // slew-to-az target azimuth
+    const char *error;          // failure reason, nullptr if none
+    unsigned long submit_time;  // millis() of the submission
+    unsigned long start_time;   // millis() of the execution start (0 if not started)
+    unsigned long end_time;     // millis() of the execution end (0 if not ended)
+    uint32_t batch;             // id of the first operation of its batch (0 if submitted alone)
+};
+
+/* Status snapshot: at the end of each tick the loop (the control task) copies
+ * the status into a plain record, and bumps its version only if a value
+ * changed (or after STATUS_REFRESH_INTERVAL, to refresh uptime and ages). The
+ * web server serializes the record once per version and serves the same
+ * buffer to every status request, tagged with the version as weak ETag. */
+// max time between two versions, in milliseconds
+#define STATUS_REFRESH_INTERVAL 5000
+// status-wait command: default and max wait, in milliseconds, and max pending requests
+#define STATUS_WAIT_DEFAULT 30000
+#define STATUS_WAIT_MAX 60000
+#define STATUS_WAIT_REQUESTS 4
+
+struct StatusValues {
+    int dome_azimuth;         // tenths of degree
+    int target_azimuth;
+    bool in_park;
+    bool finding_park;
+    bool finding_zero;
+    int find_zero_travelled;  // tenths of degree
+    int find_zero_eta;        // seconds (-1 if not searching or unknown)
+    uint8_t relays;           // bit i - relay i
+    uint8_t optoins;          // bit i - optoin i (debounced image)
+    EncoderError encoder_error;
+    int velocity_cw;          // hundredths of degree/s
+    int velocity_ccw;         // hundredths of degree/s
+    uint32_t outliers;
+    uint32_t spi_per_tick;
+    uint32_t spi_per_tick_max;
+    uint32_t latency_last_us;
+    uint32_t latency_max_us;
+    uint32_t reactions;
+};
+
+struct StatusRecord {
+    uint32_t version;            // from 1, bumped at each change (0 if not published yet)
+    uint32_t change_version;     // last version with changed values (the others only refresh uptime and ages)
+    unsigned long time;          // millis() of the version
+    unsigned long encoder_time;  // millis() of the encoder reading
+    unsigned long image_time;    // millis() of the optoin image
+    StatusValues values;         // compared to detect the changes (timestamps excluded)
+};
+
 extern bool status_park;
 extern bool status_finding_park;
 extern bool status_finding_zero;
@@ -182,8 +570,48 @@ enum class ShutterStatus {
 
 extern AsyncWebServer WebServer;
 extern AsyncEventSource SSELogger;
+/* Status stream: a "snapshot" event with the whole status at the connection,
+ * then a "delta" event with only the changed fields at each new status
+ * version, and a "heartbeat" event if nothing changed for a while. The events
+ * are pushed by the status task, woken by the loop at each new version. */
+extern AsyncEventSource StatusSSE;
+// status task handle, notified at each new status version
+extern TaskHandle_t status_task_handle;
+// max time without status events, in milliseconds
+#define STATUS_SSE_HEARTBEAT 2000
 #define WEBPAGE_LOGIN_USER "admin"     /* TODO put your webpage user */
 #define WEBPAGE_LOGIN_PASSWORD "admin" /* TODO put your webpage password */
+/* Web assets: the build step (web_assets.py) gzips the files of data/,
+ * renames the ones referenced by the pages with their content hash, and packs
+ * them in flash, in a table indexed by a perfect hash of the url
+ * (web_assets_bundle.h, generated in the build directory). */
+struct WebAsset {
+    const char *url;  // nullptr if empty slot
+    const char *type;
+    const char *etag;
+    bool immutable;       // hashed name, cached by the browsers without revalidation
+    const uint8_t *data;  // gzipped, in flash
+    size_t length;
+};
+// Cache-Control of the hashed assets (the pages are revalidated with their ETag)
+#define WEB_ASSETS_CACHE_CONTROL "public, max-age=31536000, immutable"
+/* Web authentication: the clients in the allowlist (IPv4 CIDR ranges, set
+ * with the auth-allowlist-set command and saved in NVS) are always
+ * authorized; the others log in once with Basic auth, then use a session
+ * token (cookie, HMAC of expiry and client address, key drawn at boot). */
+#define WEB_ALLOWLIST_SIZE 8
+#define WEB_ALLOWLIST_DEFAULT {"authorized_ip_1/32", "authorized_ip_2/32"} /* TODO put your authorized IP ranges here, used until set via API */
+#define WEB_SESSION_COOKIE "session"
+#define WEB_SESSION_DURATION 900  // in seconds
+#define WEB_SESSION_SET_COOKIE_SIZE 128
+/* Admission control: each client (by address, the least recently seen is
+ * replaced when the table is full) has a token bucket per request class;
+ * a request with no tokens left is answered 429, any request over the cap of
+ * requests in flight 503, at once and without taking any mutex. */
+#define WEB_REQUESTS_IN_FLIGHT 12
+#define WEB_RATE_CLIENTS 16
+// bucket of each class: refill (tokens per second, at least 1) and size
+#define WEB_RATE_LIMITS {{5, 30}, {10, 20}, {2, 5}}
 
 #define HTTP_REQUEST_TIMEOUT 5000
 struct httpResponseSummary {
@@ -204,17 +632,36 @@ struct httpResponseSummary {
 // park state
 #define EEPROM_PARK_STATE_ADDRESS (EEPROM_DOME_POSITION_ADDRESS + EEPROM_DOME_POSITION_SIZE)
 #define EEPROM_PARK_STATE_SIZE sizeof(bool)
+// learned coast, CW and CCW
+#define EEPROM_COAST_ADDRESS (EEPROM_PARK_STATE_ADDRESS + EEPROM_PARK_STATE_SIZE)
+#define EEPROM_COAST_SIZE (2 * sizeof(float))
 
 ////////////////////////////////////////////////////////////////////////////////
 // FUNCTIONS
 
+/**
+ * @brief Encoder task: it owns the RS485 bus. It executes the submitted RS485 transactions by priority, and the
+ * periodic dome position reading (published with publishEncoderSample) as a motion-feedback transaction.
+ */
+void encoder_task(void *_parameter);
+
 /**
  * @brief Network management task.
  */
 void net_task(void *_parameter);
 
+/**
+ * @brief Status task: it pushes the status events to the StatusSSE clients.
+ */
+void status_task(void *_parameter);
+
 //////////
 
+/**
+ * @brief Stop waiting for the find-zero response, discarding it if already received.
+ */
+void cancelZeroSerial485();
+
 /**
  * @brief Setup and connect to Wi-Fi.
  */
@@ -264,6 +711,27 @@ bool httpRequest(JsonDocument &_json, const JsonDocument &_filter, const String
  */
 bool httpRequest(JsonDocument &_json, const JsonDocument &_filter, const char *_host, const char *_uri, const uint16_t &_port = 80, const WebRequestMethod &_method = HTTP_GET, const char *_payload = "", const bool &_log = true);
 
+/**
+ * @brief Increment a RS485 link error counter.
+ * @param counter the counter to be incremented
+ */
+void incrementStatsSerial485(const RS485StatsCounter counter);
+
+/**
+ * @brief Get the input-to-relay reaction time statistics.
+ * @return A copy of the InputLatencyStats.
+ */
+InputLatencyStats inputLatencyStats();
+
+/**
+ * @brief Wait for a response of the encoder without sending any command (e.g. a late response). The transaction is executed by the encoder task as any other transaction.
+ * @param command the encoder command the response refers to, used to know the frame length
+ * @param priority transaction priority class
+ * @param deadline max time the transaction can wait in queue before being executed
+ * @return The RS485Future of the transaction.
+ */
+RS485Future listenSerial485(const byte command, const RS485Priority priority, const TickType_t deadline = RS485_DEFAULT_DEADLINE);
+
 /**
  * @brief Log on serial and using SSELogger, formatted as "[_identifier] _msg".
  * @param _identifier calling task identifier, e.g. "setup", "loop", ...
@@ -353,23 +821,182 @@ template <typename T, typename V, LOGMESSAGE_ENABLEIF(T), LOGMESSAGE_ENABLEIF(V)
 void logMessage(const char *_identifier1, const T &_identifier2, const V &_msg);
 
 /**
- * @brief Read from RS485 port until the end of the message.
+ * @brief Latency probe: record the time elapsed from the input change that woke the loop, to be called just after the
+ * relays are switched in reaction to it. Only the first reaction to each change is recorded.
+ */
+void probeInputLatency();
+
+/**
+ * @brief LOW LEVEL FUNCTION. Execute the oldest pending transaction of a priority class. Called only by the encoder
+ * task, the owner of the RS485 bus.
+ * @param priority priority class to be served
+ * @return true if a transaction has been dequeued, otherwise false.
+ */
+bool processSerial485(const RS485Priority priority);
+
+/**
+ * @brief LOW LEVEL FUNCTION. Read the find-zero response if it is waiting in the RS485 port, called by the encoder
+ * task when idle and before each writing. Stale bytes before the command echo 0x5A are discarded without waiting.
+ * @return true if data has been read, otherwise false.
+ */
+bool processZeroSerial485();
+
+/**
+ * @brief Push the status events to the StatusSSE clients: the changed fields if there is a new status version, else
+ * the heartbeat if it is due. Called only by the status task.
+ */
+void pushStatusEvents();
+
+/**
+ * @brief LOW LEVEL FUNCTION. Read from RS485 port until the end of the message. The reading is event-driven: it ends as soon as
+ * the response frame of the command is complete, or after RS485_RESPONSE_TIMEOUT (first byte) or
+ * RS485_INTER_BYTE_TIMEOUT (following bytes) without new data.
+ * @param command the encoder command the response refers to, used to know the frame length
+ * @param _log enable logging
  * @return A std::vector<byte> containing the readed values.
  */
-std::vector<byte> readFromSerial485();
+std::vector<byte> readFromSerial485(const byte command, const bool &_log = true);
+
+/**
+ * @brief Record a completed RS485 transaction into the link statistics: its round-trip latency, or the timeout
+ * and short frame counters if the response is not complete.
+ * @param command encoder command
+ * @param elapsed_us time from the beginning of the writing to the end of the response, in microseconds
+ * @param response_size number of bytes received
+ * @return true if the response is complete, otherwise false.
+ */
+bool recordStatsSerial485(const byte command, const unsigned long elapsed_us, const size_t response_size);
+
+/**
+ * @brief Send the find-zero command to the encoder (waiting only for the writing): the response, given when the zero
+ * switch is reached, is picked out of the following position responses and returned by zeroFrameSerial485.
+ * @return true if the command has been sent, otherwise false.
+ */
+bool requestZeroSerial485();
+
+/**
+ * @brief Reset the RS485 link statistics.
+ */
+void resetStatsSerial485();
+
+/**
+ * @brief Human readable description of a RS485 transaction result, e.g. for API responses.
+ * @param result the transaction result
+ * @return The description.
+ */
+const char *resultDescriptionSerial485(const RS485Result result);
+
+/**
+ * @brief Attach the interrupts of the optoins, that notify the loop task at each change. Must be called by the loop
+ * task (i.e. in setup).
+ */
+void startInputInterrupts();
 
 /**
  * @brief Setup and start OTA.
  */
 void startOTA();
 
+/**
+ * @brief Setup RS485 port and start the event-driven receiver.
+ */
+void startSerial485();
+
 /**
  * @brief Setup and start web server.
  */
 void startWebServer();
 
+/**
+ * @brief Get the RS485 link statistics.
+ * @return A copy of the statistics.
+ */
+RS485Stats statsSerial485();
+
+/**
+ * @brief Submit a RS485 transaction (a command and, if any, its response) to the encoder task.
+ * @param data bytes to be sent, the first one is the command
+ * @param size number of bytes to be sent (max RS485_MAX_REQUEST_SIZE)
+ * @param priority transaction priority class
+ * @param deadline max time the transaction can wait in queue before being executed
+ * @return The RS485Future of the transaction, to wait for its result.
+ */
+RS485Future submitSerial485(const byte *data, const size_t size, const RS485Priority priority, const TickType_t deadline = RS485_DEFAULT_DEADLINE);
+/**
+ * @brief Submit a single byte RS485 transaction (a command and, if any, its response) to the encoder task.
+ * @param command command to be sent
+ * @param priority transaction priority class
+ * @param deadline max time the transaction can wait in queue before being executed
+ * @return The RS485Future of the transaction, to wait for its result.
+ */
+RS485Future submitSerial485(const byte command, const RS485Priority priority, const TickType_t deadline = RS485_DEFAULT_DEADLINE);
+
+/**
+ * @brief Wait for an input change, or for the timeout. Called only by the loop task, in place of delay.
+ * @param _timeout max time to wait
+ * @return true if an input changed, false if the timeout expired.
+ */
+bool waitInputChange(const TickType_t _timeout);
+
+/**
+ * @brief LOW LEVEL FUNCTION. Write to RS485 port, discarding stale received data so that it can not be mixed with the response.
+ * @param data bytes to be sent
+ * @param size number of bytes to be sent
+ */
+void writeToSerial485(const byte *data, const size_t size);
+/**
+ * @brief LOW LEVEL FUNCTION. Write to RS485 port, discarding stale received data so that it can not be mixed with the response.
+ * @param data byte to be sent
+ */
+void writeToSerial485(const byte data);
+
+/**
+ * @brief Check if the find-zero response is expected (config transactions wait, since their responses could be
+ * confused with it).
+ * @return true if expected, otherwise false.
+ */
+bool zeroExpectedSerial485();
+
+/**
+ * @brief Take the find-zero response, if received.
+ * @param _azimuth where to store the zero position given by the encoder
+ * @return true if received, otherwise false.
+ */
+bool zeroFrameSerial485(int &_azimuth);
+
 //////////
 
+/**
+ * @brief Advance the find-zero procedure by one control tick: update the progress and, when the zero response is
+ * received, the procedure is aborted (abort command or manual mode) or FIND_ZERO_TIMEOUT is reached, stop the dome
+ * and end the procedure. Called only by the loop task.
+ * @return true in the tick the procedure ends, otherwise false.
+ */
+bool advanceFindZero();
+
+/**
+ * @brief Advance the settling after stopSlewing by one control tick, looking at the last encoder reading: when the
+ * position has not changed for COAST_SETTLE_TIME, or COAST_SETTLE_TIMEOUT is reached, update the coast model (only
+ * if settled), save the dome position and stop the trajectory. A new motion ends the settling. Called only by the
+ * loop task.
+ */
+void advanceSettle();
+
+/**
+ * @brief Check if the dome is settling after a stop (see advanceSettle). Called only by the loop task.
+ * @return true if settling.
+ */
+bool settlingDome();
+
+/**
+ * @brief Advance a manual button gesture by one control tick: start the siren after GESTURE_SIREN_DELAY, stop it
+ * when the button is released or when the gesture is completed. Called only by the loop task.
+ * @param _gesture the gesture
+ * @param _enabled false to ignore the button (e.g. the switchboard is off), aborting the gesture in progress
+ * @return true in the tick the gesture is completed, otherwise false.
+ */
+bool advanceGesture(ButtonGesture &_gesture, const bool _enabled);
+
 /**
  * @brief Disable automatic services for manual mode.
  * @return true if every request is ok, else false.
@@ -377,24 +1004,99 @@ void startWebServer();
 bool autoToManual();
 
 /**
- * @brief Block the execution and check if a button pression duration is above a certain time threshold.
- * @param button the button to be checked
- * @param ms time threshold (in milliseconds)
- * @return true when the button pression duration is above the threshold, false if released before.
+ * @brief Difference between two azimuths, along the shortest path.
+ * @param _az1 first azimuth
+ * @param _az2 second azimuth
+ * @return _az1 - _az2, in the range [-180, 180).
+ */
+float azimuthDifference(const float _az1, const float _az2);
+
+
+/**
+ * @brief Get the coast model status and the final errors of the slews.
+ * @return A copy of the CoastStatus.
+ */
+CoastStatus coastStatus();
+
+/**
+ * @brief Get the debounced state of an optoin.
+ * @param _input the optoin
+ * @return The DebouncedInput of the optoin, updated at the last control tick.
  */
-bool buttonPressed(const OptoInC &button, const unsigned long &ms);
+const DebouncedInput &debouncedInput(const OptoInC _input);
 
 /**
- * @brief Encoder command to retrive the dome position.
+ * @brief Get the continuous dome azimuth, estimated by dead reckoning from the last valid encoder reading.
+ * @return The estimated azimuth in the range [0, 360), -1 if no valid reading is available yet.
+ */
+float domeAzimuth();
+
+/**
+ * @brief LOW LEVEL FUNCTION. Encoder command to retrive the dome position, called only by the encoder task. Use
+ * encoderSample to get the position published by the encoder task instead.
+ * @param _log enable logging
  * @return If communication is successful, return the dome azimuth. Otherwise:
- * -1 (general error), -2 (mutex error), -3 (empty data).
+ * -1 (general error), -3 (empty data).
+ */
+int domePosition(const bool &_log = true);
+
+/**
+ * @brief Start the periodic dome position reading of the encoder task.
+ * @param _position initial dome position, published until the first reading
+ */
+void enableEncoderPolling(const int _position);
+
+/**
+ * @brief Time between two encoder readings: shorter when a slew is approaching its target.
+ * @return The polling interval, in ticks.
+ */
+TickType_t encoderPollInterval();
+
+/**
+ * @brief Get the last dome position published by the encoder task. It never blocks (seqlock reading).
+ * @return A copy of the last EncoderSample.
+ */
+EncoderSample encoderSample();
+
+/**
+ * @brief Get the status of the dead-reckoning estimator.
+ * @return A copy of the EstimatorStatus.
+ */
+EstimatorStatus estimatorStatus();
+
+/**
+ * @brief Get the status of the find-zero procedure.
+ * @return A copy of the FindZeroStatus.
+ */
+FindZeroStatus findZeroStatus();
+
+/**
+ * @brief Check if an optoin is pressed since a certain time (debounced state).
+ * @param _input the optoin
+ * @param _ms time threshold (in milliseconds), from the rising edge
+ * @return true if the optoin is held for the time threshold, otherwise false (also if held since start up).
+ */
+bool inputHeld(const OptoInC _input, const unsigned long _ms);
+
+/**
+ * @brief Check if any optoin changed but its debounced state is not updated yet.
+ * @return true if an input is settling, otherwise false.
  */
-int domePosition();
+bool inputsSettling();
 
 /**
- * @brief Send to the encoder the command to find the dome zero, and then move the dome until the encoder response.
+ * @brief Update the coast model with a stop from steady motion, and the slew final error statistics.
+ * @param _direction motion direction before the stop: 1 CW, -1 CCW
+ * @param _cutoff_az estimated azimuth when the relays were switched off
+ * @param _settled_az azimuth after the dome settled
+ * @param _target slew target, -1 if the stop is not the end of a slew
  */
-void findZero();
+void learnCoast(const int _direction, const float _cutoff_az, const int _settled_az, const int _target);
+
+/**
+ * @brief Load the learned coast from EEPROM.
+ */
+void loadCoast();
 
 /**
  * @brief Enable automatic services for manual mode.
@@ -402,16 +1104,90 @@ void findZero();
  */
 bool manualToAuto();
 
+/**
+ * @brief Get an operation of the command queue.
+ * @param _id operation id
+ * @param _operation where to store the operation
+ * @return true if the operation is known, false if never submitted or too old.
+ */
+bool operationStatus(const uint32_t _id, DomeOperation &_operation);
+
+/**
+ * @brief Get the name of an operation type, as the API command.
+ * @param _type operation type
+ * @return The command name.
+ */
+const char *operationName(const OperationType _type);
+
 /**
  * @brief Park the dome.
  */
 void park();
 
+/**
+ * @brief Predicted coast of the dome in a direction.
+ * @param _direction motion direction: 1 CW, -1 CCW
+ * @return The predicted coast, in degrees.
+ */
+float predictedCoast(const int _direction);
+
+/**
+ * @brief Execute the queued operations of the command queue, in submission order, and end the find-zero or park
+ * operation of a batch when its procedure ends. Called only by the loop task, with the global mutex taken.
+ */
+void processOperations();
+
+/**
+ * @brief Publish a new encoder reading. The previous valid azimuth is kept if the reading failed, or if the
+ * estimator rejects it as outlier.
+ * @param _position the value returned by domePosition
+ * @param _resync accept the reading even if far from the estimate (e.g. after a calibration)
+ */
+void publishEncoderSample(const int _position, const bool _resync = false);
+
+/**
+ * @brief Copy the status into the status snapshot, bumping its version if something changed. Called only by the
+ * loop task, at the end of each tick.
+ */
+void publishStatusRecord();
+
+/**
+ * @brief Store an encoder reading in the trajectory buffer, if a slew is being recorded.
+ * @param _position the value returned by domePosition
+ * @param _latency_us time taken by the reading, in microseconds
+ */
+void recordTrajectorySample(const int _position, const unsigned long _latency_us);
+
+/**
+ * @brief Reset the slew final error statistics (the learned coast is kept).
+ */
+void resetSlewStatistics();
+
+/**
+ * @brief Ask the encoder task for an immediate reading and wait until it is published.
+ * @param _sample where to store the new sample
+ * @param _timeout max time to wait for the new sample
+ * @return true if a new sample has been published within the timeout, otherwise false.
+ */
+bool requestEncoderSample(EncoderSample &_sample, const TickType_t _timeout = ENCODER_REQUEST_TIMEOUT);
+
+/**
+ * @brief Notify the estimator of a motion direction change, when the motor relays are switched.
+ * @param _direction 1 clockwise, -1 counterclockwise, 0 stopped
+ */
+void setEstimatorMotion(const int _direction);
+
 /**
  * @brief Save env vars, relays off, and other stuffs.
  */
 void shutDown();
 
+/**
+ * @brief Start the find-zero procedure: send to the encoder the command to find the dome zero and move the dome
+ * clockwise, without waiting for the encoder response (see advanceFindZero).
+ */
+void startFindZero();
+
 /**
  * @brief LOW LEVEL FUNCTION. Move the dome in the specified direction. If it's already moving, stop it and then
  * start the new movement.
@@ -420,9 +1196,11 @@ void shutDown();
 void startMotion(const DomeDirection &direction);
 
 /**
- * @brief Encoder command to start the siren.
+ * @brief Encoder command to start the siren, without waiting for it. The periodic dome position reading is
+ * suspended (any command would stop the siren) until stopSiren is called.
+ * @return The RS485Future of the siren transaction.
  */
-void startSiren();
+RS485Future startSiren();
 
 /**
  * @brief Move the dome to the specified target. This function contains all the high level logic to compute and
@@ -430,6 +1208,19 @@ void startSiren();
  */
 void startSlewing(const int az_target);
 
+/**
+ * @brief Start recording a new slew in the trajectory buffer. Nothing is done if a slew is already being recorded
+ * (e.g. the target of a slew is changed).
+ * @param _type type of the slew
+ */
+void startTrajectory(const TrajectoryType _type);
+
+/**
+ * @brief Get the status snapshot. It never blocks the loop (short critical section).
+ * @return A copy of the last StatusRecord.
+ */
+StatusRecord statusRecord();
+
 /**
  * @brief LOW LEVEL FUNCTION. Stop the dome movement.
  */
@@ -437,20 +1228,73 @@ void stopMotion();
 
 /**
  * @brief Encoder command to stop the siren. Note that the siren stops at the first new command given,
- * so this is only a convenience function.
+ * so this function resumes the dome position reading, that was suspended while the siren was playing, and asks
+ * for an immediate reading (without waiting for it).
  */
 void stopSiren();
 
 /**
- * @brief Stop movement, save dome position and other motion-ending stuffs.
+ * @brief Stop movement and other motion-ending stuffs, without waiting: the dome settling, the coast model update and
+ * the dome position saving are left to advanceSettle.
+ * @param _target_reached true if the slew is stopped because the dome is going to settle on the target
+ */
+void stopSlewing(const bool _target_reached = false);
+
+/**
+ * @brief Stop recording the current slew, storing a last sample with the final position.
  */
-void stopSlewing();
+void stopTrajectory();
+
+/**
+ * @brief Submit an operation to the command queue, without waiting for it. A slew-to-az submitted while another
+ * one is still queued replaces its target, and the queued operation id is returned. An abort fails the queued motion
+ * operations (slew-to-az, park, find-zero).
+ * @param _type operation type
+ * @param _target target azimuth, for slew-to-az
+ * @return The operation id, 0 if the queue is full.
+ */
+uint32_t submitOperation(const OperationType _type, const int _target = -1);
+
+/**
+ * @brief Submit a batch of operations to the command queue, all or none, without waiting for them. The operations
+ * are executed in order, and never merged; if one fails, the following ones of the batch fail too. An abort fails the
+ * queued motion operations submitted before the batch.
+ * @param _types operation types
+ * @param _targets target azimuths, for slew-to-az
+ * @param _count number of operations, at most OPERATION_QUEUE_SIZE
+ * @param _ids returns the operation ids
+ * @return False if there is no room in the queue for the whole batch, else true.
+ */
+bool submitOperationBatch(const OperationType *_types, const int *_targets, const int _count, uint32_t *_ids);
 
 /**
  * @brief Impulsive command to power on the switchboard.
  */
 void switchboardIgnition();
 
+/**
+ * @brief Range of the trajectory buffer holding the last slews. Samples are identified by a sequence number that
+ * always increases, so a range stays valid while the buffer is written (overwritten samples are just lost).
+ * @param _slews number of slews, from the newest one
+ * @param _begin where to store the sequence number of the first sample
+ * @param _end where to store the sequence number after the last sample
+ */
+void trajectoryRange(const int _slews, uint32_t &_begin, uint32_t &_end);
+
+/**
+ * @brief Copy a sample from the trajectory buffer.
+ * @param _sequence sequence number of the sample
+ * @param _sample where to store the sample
+ * @return true if the sample is still in the buffer, false if it has been overwritten.
+ */
+bool trajectorySample(const uint32_t _sequence, TrajectorySample &_sample);
+
+/**
+ * @brief LOW LEVEL FUNCTION. Advance the debounced input engine from the optoin image, called by waitInputChange
+ * at each control tick.
+ */
+void updateInputs();
+
 /**
  * @brief Encoder command to set the dome position into the encoder.
  * @param position range from 0 to 359
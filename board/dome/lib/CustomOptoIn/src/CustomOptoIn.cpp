@@ -31,6 +31,8 @@ SOFTWARE.
 
 #include "CustomOptoIn.hpp"
 
+#include <soc/gpio_struct.h>
+
 const OptoInC optoIn_number_list[]{OptoInC::OptoInC1,
                                    OptoInC::OptoInC2,
                                    OptoInC::OptoInC3,
@@ -47,12 +49,42 @@ void CustomOptoInClass::setup(const int input_type) {
     pinMode(OptoInC::OptoInC8, input_type);
 }
 
+void CustomOptoInClass::attachInterrupt(void (*handler)(void)) {
+    // optoin 1-4 through the expander INT output, 5-8 directly
+    KMPProDinoESP32.attachOptoInInterrupt(handler);
+    ::attachInterrupt(OptoInC::OptoInC5, handler, CHANGE);
+    ::attachInterrupt(OptoInC::OptoInC6, handler, CHANGE);
+    ::attachInterrupt(OptoInC::OptoInC7, handler, CHANGE);
+    ::attachInterrupt(OptoInC::OptoInC8, handler, CHANGE);
+}
+
+uint8_t CustomOptoInClass::update() {
+    uint8_t new_image{KMPProDinoESP32.updateOptoInImage()};
+    // J14 pins (all below GPIO32) are active low
+    const uint32_t gpio_in{GPIO.in};
+    for (int i{4}; i < 8; ++i)
+        if (!(gpio_in & (1ul << optoIn_number_list[i]))) new_image |= 1 << i;
+    image = new_image;
+    image_time = millis();
+    return new_image;
+}
+
 bool CustomOptoInClass::getState(const int optoIn_number) {
-    return getState(optoIn_number_list[optoIn_number]);
+    return (optoIn_number >= 0 && optoIn_number < 8) && (image & (1 << optoIn_number));
 }
 
 bool CustomOptoInClass::getState(const OptoInC optoIn) {
-    return (optoIn <= 4) ? KMPProDinoESP32.getOptoInState(optoIn) : !digitalRead(optoIn);
+    return getState(getNumber(optoIn));
+}
+
+int CustomOptoInClass::getNumber(const OptoInC optoIn) {
+    for (int i{}; i < 8; ++i)
+        if (optoIn_number_list[i] == optoIn) return i;
+    return -1;
+}
+
+unsigned long CustomOptoInClass::imageTime() {
+    return image_time;
 }
 
 CustomOptoInClass customOptoIn{};
@@ -55,18 +55,48 @@ class CustomOptoInClass {
     void setup(const int input_type);
 
     /**
-     * @brief Get OptoIn (optical input) status
+     * @brief Call handler (in interrupt context, so it must be in IRAM) at each change of any optoin
+     * @param handler The function to be called
+     */
+    void attachInterrupt(void (*handler)(void));
+
+    /**
+     * @brief Read all the optoins (one SPI transaction for the expander, one register read for J14) and store them
+     * in the optoin image, served by getState. To be called once per control tick
+     * @return The image, bit 0 for OptoInC1 ... bit 7 for OptoInC8
+     */
+    uint8_t update();
+
+    /**
+     * @brief Get OptoIn (optical input) status from the optoin image
      * @param number The input number to be readed
      * @return `true` if high, false if low
      */
     bool getState(const int optoIn_number);
 
     /**
-     * @brief Get OptoIn (optical input) status
+     * @brief Get OptoIn (optical input) status from the optoin image
      * @param optoIn The input to be readed
      * @return `true` if high, false if low
      */
     bool getState(const OptoInC optoIn);
+
+    /**
+     * @brief Get OptoIn number
+     * @param optoIn The input
+     * @return The number, from 0 (OptoInC1) to 7 (OptoInC8)
+     */
+    int getNumber(const OptoInC optoIn);
+
+    /**
+     * @brief Get the time of the last optoin image update
+     * @return millis() of the update
+     */
+    unsigned long imageTime();
+
+   private:
+    volatile uint8_t image{};
+    volatile unsigned long image_time{};
 };
 
 extern CustomOptoInClass customOptoIn;
@@ -414,10 +414,41 @@ void KMPProDinoESP32Class::setRelayState(Relay relay, bool state)
 
 void KMPProDinoESP32Class::setAllRelaysState(bool state)
 {
+	setRelayMask((1 << RELAY_COUNT) - 1, state ? 0xFF : 0x00);
+}
+
+void KMPProDinoESP32Class::setRelayMask(uint8_t mask, uint8_t values)
+{
+	uint8_t pinsMask = 0;
+	uint8_t pinsValues = 0;
 	for (uint8_t i = 0; i < RELAY_COUNT; i++)
 	{
-		setRelayState(i, state);
+		if (mask & (1 << i))
+		{
+			pinsMask |= 1 << RELAY_PINS[i];
+			if (values & (1 << i))
+			{
+				pinsValues |= 1 << RELAY_PINS[i];
+			}
+		}
 	}
+
+	MCP23S08.SetPinsState(pinsMask, pinsValues);
+}
+
+uint8_t KMPProDinoESP32Class::getRelayMask(void)
+{
+	uint8_t latch = MCP23S08.GetOutputLatch();
+	uint8_t tRet = 0;
+	for (uint8_t i = 0; i < RELAY_COUNT; i++)
+	{
+		if (latch & (1 << RELAY_PINS[i]))
+		{
+			tRet |= 1 << i;
+		}
+	}
+
+	return tRet;
 }
 
 void KMPProDinoESP32Class::setAllRelaysOn()
@@ -432,7 +463,8 @@ void KMPProDinoESP32Class::setAllRelaysOff()
 
 uint8_t KMPProDinoESP32Class::getRelayState(void)
 {
-	uint8_t tState = (MCP23S08.GetPinState() & 0xf0) >> 4;
+	// From the output latch shadow, without SPI transactions.
+	uint8_t tState = (MCP23S08.GetOutputLatch() & 0xf0) >> 4;
 	uint8_t tRet = 0;
 	if (tState & (1 << 0))tRet |= 1 << 3;
 	if (tState & (1 << 1))tRet |= 1 << 2;
@@ -449,7 +481,8 @@ bool KMPProDinoESP32Class::getRelayState(uint8_t relayNumber)
 		return false;
 	}
 
-	return MCP23S08.GetPinState(RELAY_PINS[relayNumber]);
+	// From the output latch shadow, without SPI transactions.
+	return getRelayMask() & (1 << relayNumber);
 }
 
 bool KMPProDinoESP32Class::getRelayState(Relay relay)
@@ -487,6 +520,79 @@ bool KMPProDinoESP32Class::getOptoInState(OptoIn optoIn)
 	return getOptoInState((uint8_t)optoIn);
 }
 
+// Opto in image, with its update time, and SPI transactions per tick.
+volatile uint8_t _optoInImage = 0;
+volatile unsigned long _optoInImageTime = 0;
+uint32_t _tickSpiLastCount = 0;
+volatile uint32_t _tickSpiTransactions = 0;
+volatile uint32_t _tickSpiTransactionsMax = 0;
+
+uint8_t KMPProDinoESP32Class::updateOptoInImage(void)
+{
+	// The tick includes its own image reading.
+	uint32_t count = MCP23S08.GetTransactionCount();
+	_tickSpiTransactions = count - _tickSpiLastCount;
+	_tickSpiLastCount = count;
+	if (_tickSpiTransactions > _tickSpiTransactionsMax)
+	{
+		_tickSpiTransactionsMax = _tickSpiTransactions;
+	}
+
+	uint8_t gpio = MCP23S08.GetPinState();
+	uint8_t image = 0;
+	for (uint8_t i = 0; i < OPTOIN_COUNT; i++)
+	{
+		if (!(gpio & (1 << OPTOIN_PINS[i])))
+		{
+			image |= 1 << i;
+		}
+	}
+	_optoInImage = image;
+	_optoInImageTime = millis();
+
+	return image;
+}
+
+bool KMPProDinoESP32Class::getOptoInImageState(uint8_t optoInNumber)
+{
+	// Check if optoInNumber is out of range - return false.
+	if (optoInNumber > OPTOIN_COUNT - 1)
+	{
+		return false;
+	}
+
+	return _optoInImage & (1 << optoInNumber);
+}
+
+bool KMPProDinoESP32Class::getOptoInImageState(OptoIn optoIn)
+{
+	return getOptoInImageState((uint8_t)optoIn);
+}
+
+unsigned long KMPProDinoESP32Class::getOptoInImageTime(void)
+{
+	return _optoInImageTime;
+}
+
+uint32_t KMPProDinoESP32Class::getTickSpiTransactions(bool maxValue)
+{
+	return maxValue ? _tickSpiTransactionsMax : _tickSpiTransactions;
+}
+
+void KMPProDinoESP32Class::attachOptoInInterrupt(void (*handler)(void))
+{
+	uint8_t mask = 0;
+	for (uint8_t i = 0; i < OPTOIN_COUNT; i++)
+	{
+		mask |= 1 << OPTOIN_PINS[i];
+	}
+
+	// IO36 is input only, without internal pull-up: the expander drives the line.
+	pinMode(MCP23S08IntetuptPin, INPUT);
+	attachInterrupt(MCP23S08IntetuptPin, handler, FALLING);
+	MCP23S08.EnableInterrupts(mask);
+}
+
 /* ----------------------------------------------------------------------- */
 /* RS485 methods. */
 /* ----------------------------------------------------------------------- */
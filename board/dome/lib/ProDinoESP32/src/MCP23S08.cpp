@@ -30,6 +30,14 @@
 
 int _cs;
 
+// SPI transactions since start up, for benchmarks.
+volatile uint32_t _transactionCount = 0;
+
+// Shadow of the OLAT register, so the outputs are changed with a single write transaction.
+// The mutex serializes the shadow updates (and their writes) of different tasks.
+uint8_t _olat = 0;
+SemaphoreHandle_t _olatMutex = NULL;
+
 uint8_t  _expTxData[16]  __attribute__((aligned(4)));
 uint8_t  _expRxData[16]  __attribute__((aligned(4)));
 
@@ -47,6 +55,9 @@ void MCP23S08Class::init(int cs)
 
 	pinMode(_cs, OUTPUT);
 	digitalWrite(_cs, HIGH);
+
+	_olatMutex = xSemaphoreCreateMutex();
+	_olat = ReadRegister(OLAT);
 }
 
 /**
@@ -64,18 +75,33 @@ void MCP23S08Class::SetPinState(uint8_t pinNumber, bool state)
 		return;
 	}
 
-	uint8_t registerData = ReadRegister(OLAT);
+	SetPinsState(1 << pinNumber, state ? 0xFF : 0x00);
+}
 
-	if (state)
-	{
-		registerData |= (1 << pinNumber);
-	}
-	else
-	{
-		registerData &= ~(1 << pinNumber);
-	}
+/**
+ * @brief Set the state of several pins with a single write transaction, using the OLAT shadow.
+ *
+ * @param mask Pins to be set, bit 0 - pin 0 ... bit 7 - pin 7.
+ * @param values The pins state, bit 0 - pin 0 ... bit 7 - pin 7. Bits not in mask are ignored.
+ *
+ * @return void
+ */
+void MCP23S08Class::SetPinsState(uint8_t mask, uint8_t values)
+{
+	xSemaphoreTake(_olatMutex, portMAX_DELAY);
+	_olat = (_olat & ~mask) | (values & mask);
+	WriteRegister(OLAT, _olat);
+	xSemaphoreGive(_olatMutex);
+}
 
-	WriteRegister(OLAT, registerData);
+/**
+ * @brief Get the output latch (the last written outputs state) from the OLAT shadow, without SPI transactions.
+ *
+ * @return OLAT Reg
+ */
+uint8_t MCP23S08Class::GetOutputLatch(void)
+{
+	return _olat;
 }
 
 /**
@@ -151,6 +177,17 @@ void MCP23S08Class::TransferBytes()
 	digitalWrite(_cs, LOW);
 	SPI.transferBytes(_expTxData, _expRxData, 3);
 	digitalWrite(_cs, HIGH);
+	_transactionCount++;
+}
+
+/**
+ * @brief Get the number of SPI transactions with the expander since start up.
+ *
+ * @return Transactions count.
+ */
+uint32_t MCP23S08Class::GetTransactionCount(void)
+{
+	return _transactionCount;
 }
 
 /**
@@ -182,5 +219,35 @@ void MCP23S08Class::SetPinDirection(uint8_t pinNumber, uint8_t mode)
 	WriteRegister(IODIR, registerData);
 }
 
+/**
+ * @brief Enable the interrupt-on-change of the expander pins. The INT output is configured
+ *        active-low push-pull, it is asserted at each change of an enabled pin and released
+ *        reading the GPIO or the INTCAP register.
+ *
+ * @param mask Pins to enable, bit 0 - pin 0 ... bit 7 - pin 7.
+ *
+ * @return void
+ */
+void MCP23S08Class::EnableInterrupts(uint8_t mask)
+{
+	// INT active-low, push-pull.
+	WriteRegister(IOCON, ReadRegister(IOCON) & ~((1 << 2) | (1 << 1)));
+	// Compare with the previous pin value.
+	WriteRegister(INTCON, 0x00);
+	WriteRegister(GPINTEN, mask);
+	// Release a pending interrupt.
+	ReadRegister(GPIO);
+}
+
+/**
+ * @brief Get the pins state captured at the last interrupt, releasing the INT output.
+ *
+ * @return INTCAP Reg
+ */
+uint8_t MCP23S08Class::GetInterruptCapture(void)
+{
+	return ReadRegister(INTCAP);
+}
+
 MCP23S08Class MCP23S08;
 
@@ -25,9 +25,14 @@ class MCP23S08Class
  public:
 	void init(int cs);
 	void SetPinState(uint8_t pinNumber, bool state);
+	void SetPinsState(uint8_t mask, uint8_t values);
+	uint8_t GetOutputLatch(void);
 	bool GetPinState(uint8_t pinNumber);
 	uint8_t GetPinState(void);
 	void SetPinDirection(uint8_t pinNumber, uint8_t mode);
+	void EnableInterrupts(uint8_t mask);
+	uint8_t GetInterruptCapture(void);
+	uint32_t GetTransactionCount(void);
 };
 
 extern MCP23S08Class MCP23S08;
@@ -0,0 +1,122 @@
+/*
+RS485 FRAME PARSER LIBRARY
+
+Remote REST dome controller
+https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+         Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* Frame logic of the encoder responses, kept apart from the UART and FreeRTOS
+ * code of auxiliary_functions.cpp so that it can be driven by host tests
+ * (tools/rs485_frame_test) with byte streams. The reader gives each received
+ * byte to feed(), and stops waiting as soon as the frame is complete. */
+
+#ifndef _RS485_FRAME_HPP_
+#define _RS485_FRAME_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Length of the encoder response to a command.
+ * @param command encoder command byte
+ * @return The number of bytes of the response frame, 0 if the response length is not known (or there is no response).
+ */
+inline size_t responseLengthSerial485(const uint8_t command) {
+    switch (command) {
+        case 0x52:  // R: two bytes of the dome position
+            return 2;
+        case 0x5A:  // Z: command echo and two bytes of the zero position
+            return 3;
+        case 0xC1:  // configuration: seven data bytes and checksum
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Return false if a byte cannot be the first one of the response to a command, i.e. it is stale data: only the
+ * zero response has a known first byte, the command echo 0x5A.
+ */
+inline bool frameStartSerial485(const uint8_t command, const uint8_t data) {
+    return command != 0x5A || data == 0x5A;
+}
+
+// what a received byte is, for the reader
+enum class RS485FrameEvent : uint8_t {
+    Response,      // byte of the response, frame not complete
+    Complete,      // last byte of the response frame
+    Zero,          // byte of a zero frame picked out of a position response
+    ZeroComplete,  // last byte of that zero frame, see zeroFrame()
+    Skipped        // stale byte before the response, discarded
+};
+
+class RS485FrameParser {
+   public:
+    /**
+     * @brief Start the parsing of the response to a command.
+     * @param _command encoder command
+     * @param _demux pick a zero frame out of the response, if it arrives before its first byte (position readings
+     * during the find-zero procedure: 0x5A is never the first byte of a position, below 360)
+     */
+    RS485FrameParser(const uint8_t _command, const bool _demux = false)
+        : command{_command}, frame_size{responseLengthSerial485(_command)}, demux{_demux && _command == 0x52} {}
+
+    /**
+     * @brief Parse a received byte.
+     */
+    RS485FrameEvent feed(const uint8_t data) {
+        if (response_size == 0) {
+            if (demux && (zero_size == 0 ? data == 0x5A : zero_size < 3)) {
+                zero_frame[zero_size++] = data;
+                return zero_size == 3 ? RS485FrameEvent::ZeroComplete : RS485FrameEvent::Zero;
+            }
+            if (!frameStartSerial485(command, data)) return RS485FrameEvent::Skipped;
+        }
+        ++response_size;
+        return complete() ? RS485FrameEvent::Complete : RS485FrameEvent::Response;
+    }
+
+    // the response frame is complete (never, if its length is not known: the reader ends at the timeout)
+    bool complete() const { return frame_size != 0 && response_size >= frame_size; }
+    // no byte of the response received yet, so the reader waits with the first byte timeout
+    bool waitingFirstByte() const { return response_size == 0; }
+    size_t responseSize() const { return response_size; }
+    size_t frameSize() const { return frame_size; }
+    // the zero frame picked out of the response, 3 bytes
+    const uint8_t *zeroFrame() const { return zero_frame; }
+
+   private:
+    const uint8_t command;
+    const size_t frame_size;
+    const bool demux;
+    size_t response_size{0};
+    uint8_t zero_frame[3]{};
+    size_t zero_size{0};
+};
+
+#endif  // _RS485_FRAME_HPP_
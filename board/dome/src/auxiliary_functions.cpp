@@ -220,31 +220,469 @@ void logMessage(const char *_identifier1, const T &_identifier2, const V &_msg)
 
 //////////
 
-std::vector<byte> readFromSerial485() {
-    logMessage("readFromSerial485", "Start reading data");
-    int value{KMPProDinoESP32.rs485Read()};
-    // since the encoder board is slow, try multiple readings before give up
-    for (int i{}; value == -1 && i < 10; ++i) {
-        delay(30);
-        value = KMPProDinoESP32.rs485Read();
-    }
-    logMessage("readFromSerial485", value == -1 ? "No data received" : "Receiving data...");
+// RS485 reception event, given by the UART driver as soon as new data is available
+SemaphoreHandle_t xSemaphore_rs485_rx{xSemaphoreCreateBinary()};
+
+// RS485 transaction slot states, see RS485Future for the ownership rules
+enum class RS485SlotState : uint8_t {
+    Free,       // available for a new transaction
+    Queued,     // waiting in the priority queue
+    Running,    // being executed by the encoder task
+    Done,       // executed, result available for the future
+    Abandoned,  // the future gave up, the encoder task frees the slot
+};
+
+// RS485 transaction, allocated in a static pool to avoid heap usage on submit
+struct RS485Slot {
+    std::atomic<RS485SlotState> state;
+    byte request[RS485_MAX_REQUEST_SIZE];
+    size_t request_size;
+    byte response_command;  // command the response refers to (it defines the response length)
+    TickType_t submit_time;
+    TickType_t deadline;  // relative to submit_time
+    RS485Result result;
+    std::vector<byte> response;
+    SemaphoreHandle_t done;  // given by the encoder task when the result is available
+};
+
+RS485Slot rs485_slots[RS485_QUEUE_SIZE]{};
+// one queue of slot indexes for each priority class
+QueueHandle_t rs485_queues[RS485_PRIORITY_COUNT]{};
+
+RS485Future enqueueSerial485(const byte *data, const size_t size, const byte response_command, const RS485Priority priority, const TickType_t deadline) {
+    if (size > RS485_MAX_REQUEST_SIZE) {
+        logMessage("enqueueSerial485", "Error: request too long");
+        return RS485Future{};
+    }
+    for (int i{}; i < RS485_QUEUE_SIZE; ++i) {
+        RS485SlotState state{RS485SlotState::Free};
+        if (!rs485_slots[i].state.compare_exchange_strong(state, RS485SlotState::Queued)) continue;
+        // the slot is not visible to the encoder task until its index is queued
+        RS485Slot &transaction{rs485_slots[i]};
+        if (size > 0) memcpy(transaction.request, data, size);
+        transaction.request_size = size;
+        transaction.response_command = response_command;
+        transaction.submit_time = xTaskGetTickCount();
+        transaction.deadline = deadline;
+        transaction.response.clear();
+        // never fails: the queues are as long as the slot pool
+        xQueueSend(rs485_queues[static_cast<int>(priority)], &i, 0);
+        if (encoder_task_handle != NULL) xTaskNotifyGive(encoder_task_handle);
+        return RS485Future{i};
+    }
+    logMessage("enqueueSerial485", "Error: RS485 queue full");
+    incrementStatsSerial485(RS485StatsCounter::QueueFull);
+    return RS485Future{};
+}
+
+RS485Future listenSerial485(const byte command, const RS485Priority priority, const TickType_t deadline) {
+    return enqueueSerial485(nullptr, 0, command, priority, deadline);
+}
+
+RS485Future submitSerial485(const byte *data, const size_t size, const RS485Priority priority, const TickType_t deadline) {
+    return enqueueSerial485(data, size, size > 0 ? data[0] : 0, priority, deadline);
+}
+
+RS485Future submitSerial485(const byte command, const RS485Priority priority, const TickType_t deadline) {
+    return submitSerial485(&command, 1, priority, deadline);
+}
+
+//////////
+
+RS485Future &RS485Future::operator=(RS485Future &&_other) {
+    if (this != &_other) {
+        if (slot >= 0 && !abandon()) wait();
+        slot = _other.slot;
+        _other.slot = -1;
+    }
+    return *this;
+}
+
+RS485Future::~RS485Future() {
+    // if the transaction is already done, free the slot
+    if (slot >= 0 && !abandon()) wait();
+}
+
+bool RS485Future::abandon() {
+    RS485SlotState state{rs485_slots[slot].state.load()};
+    while (state == RS485SlotState::Queued || state == RS485SlotState::Running)
+        if (rs485_slots[slot].state.compare_exchange_weak(state, RS485SlotState::Abandoned)) {
+            slot = -1;
+            return true;
+        }
+    return false;
+}
+
+RS485Result RS485Future::wait(std::vector<byte> *_response) {
+    if (slot < 0) return RS485Result::QueueFull;
+    RS485Slot &transaction{rs485_slots[slot]};
+    // wait for the remaining deadline, plus the execution time
+    const TickType_t elapsed{xTaskGetTickCount() - transaction.submit_time};
+    const TickType_t timeout{(elapsed < transaction.deadline ? transaction.deadline - elapsed : 0) + RS485_EXECUTION_TIMEOUT};
+    if (xSemaphoreTake(transaction.done, timeout) != pdTRUE) {
+        if (abandon()) {
+            incrementStatsSerial485(RS485StatsCounter::DeadlineExpired);
+            return RS485Result::Expired;
+        }
+        // completed just after the timeout, the semaphore is given right after the state change
+        xSemaphoreTake(transaction.done, portMAX_DELAY);
+    }
+    return collect(_response);
+}
+
+bool RS485Future::poll(RS485Result &_result, std::vector<byte> *_response) {
+    if (slot < 0) {
+        _result = RS485Result::QueueFull;
+        return true;
+    }
+    RS485Slot &transaction{rs485_slots[slot]};
+    if (xSemaphoreTake(transaction.done, 0) != pdTRUE) {
+        // same bound of wait: the deadline, plus the execution time
+        if (xTaskGetTickCount() - transaction.submit_time < transaction.deadline + RS485_EXECUTION_TIMEOUT) return false;
+        if (abandon()) {
+            incrementStatsSerial485(RS485StatsCounter::DeadlineExpired);
+            _result = RS485Result::Expired;
+            return true;
+        }
+        xSemaphoreTake(transaction.done, portMAX_DELAY);
+    }
+    _result = collect(_response);
+    return true;
+}
+
+RS485Result RS485Future::collect(std::vector<byte> *_response) {
+    RS485Slot &transaction{rs485_slots[slot]};
+    const RS485Result result{transaction.result};
+    if (_response != nullptr) *_response = transaction.response;
+    transaction.state.store(RS485SlotState::Free);
+    slot = -1;
+    return result;
+}
+
+//////////
+
+bool processSerial485(const RS485Priority priority) {
+    int i{};
+    if (xQueueReceive(rs485_queues[static_cast<int>(priority)], &i, 0) != pdTRUE) return false;
+    RS485Slot &transaction{rs485_slots[i]};
+    RS485SlotState state{RS485SlotState::Queued};
+    if (!transaction.state.compare_exchange_strong(state, RS485SlotState::Running)) {
+        // abandoned while in queue
+        transaction.state.store(RS485SlotState::Free);
+        return true;
+    }
+    // execute
+    if (xTaskGetTickCount() - transaction.submit_time > transaction.deadline) {
+        logMessage("processSerial485", String{"Error: deadline expired for command "} + transaction.response_command);
+        incrementStatsSerial485(RS485StatsCounter::DeadlineExpired);
+        transaction.result = RS485Result::Expired;
+    } else {
+        const unsigned long start_time{micros()};
+        if (transaction.request_size > 0) writeToSerial485(transaction.request, transaction.request_size);
+        const size_t frame_size{responseLengthSerial485(transaction.response_command)};
+        if (frame_size == 0) {
+            transaction.result = RS485Result::Done;
+        } else {
+            transaction.response = readFromSerial485(transaction.response_command);
+            transaction.result = transaction.response.size() == frame_size ? RS485Result::Done : RS485Result::NoData;
+        }
+        // the find-zero response arrives only when the zero is reached, so it is recorded when demultiplexed
+        if (transaction.request_size > 0 && transaction.response_command != 0)
+            recordStatsSerial485(transaction.response_command, micros() - start_time, transaction.response.size());
+    }
+    // publish the result, or free the slot if the future gave up in the meantime
+    state = RS485SlotState::Running;
+    if (transaction.state.compare_exchange_strong(state, RS485SlotState::Done))
+        xSemaphoreGive(transaction.done);
+    else
+        transaction.state.store(RS485SlotState::Free);
+    return true;
+}
+
+//////////
+
+/* The find-zero response (Z frame) arrives only when the zero switch is
+ * reached, while the position is read as usual: it is told apart from the
+ * position responses by its first byte, the command echo 0x5A, that is never
+ * the first byte of a position (below 360). */
+// zero frame expected, set by requestZeroSerial485
+std::atomic<bool> zero_frame_expected{false};
+// zero frame received and not yet taken by zeroFrameSerial485
+std::atomic<bool> zero_frame_received{false};
+// zero position of the received frame
+std::atomic<int> zero_frame_azimuth{-1};
+// micros() of the Z command, for the link statistics
+unsigned long zero_request_time{0};
+
+// store a zero frame read by the encoder task, and wake up the loop to stop the dome
+void storeZeroFrameSerial485(const std::vector<byte> &frame) {
+    recordStatsSerial485(static_cast<byte>(0x5A), micros() - zero_request_time, frame.size());
+    if (frame.size() != responseLengthSerial485(static_cast<byte>(0x5A)) || frame[0] != static_cast<byte>(0x5A)) {
+        logMessage("storeZeroFrameSerial485", "Error: wrong zero frame");
+        return;
+    }
+    zero_frame_azimuth = frame[2] | frame[1] << 8;
+    zero_frame_received = true;
+    zero_frame_expected = false;
+    if (loop_task_handle != NULL) xTaskNotifyGive(loop_task_handle);
+}
+
+bool requestZeroSerial485() {
+    zero_frame_received = false;
+    zero_request_time = micros();
+    zero_frame_expected = true;
+    // write only, the response is demultiplexed from the following readings
+    const byte command{0x5A};
+    const RS485Result result{enqueueSerial485(&command, 1, 0, RS485Priority::MotionFeedback, RS485_DEFAULT_DEADLINE).wait()};
+    if (result != RS485Result::Done) {
+        zero_frame_expected = false;
+        logMessage("requestZeroSerial485", resultDescriptionSerial485(result));
+    }
+    return result == RS485Result::Done;
+}
+
+void cancelZeroSerial485() {
+    zero_frame_expected = false;
+    zero_frame_received = false;
+}
+
+bool processZeroSerial485() {
+    if (!zero_frame_expected) return false;
+    // a stale byte is not the beginning of the zero frame, so it is not waited for
+    while (RS485Serial.available() && !frameStartSerial485(0x5A, RS485Serial.peek())) RS485Serial.read();
+    if (!RS485Serial.available()) return false;
+    storeZeroFrameSerial485(readFromSerial485(static_cast<byte>(0x5A)));
+    return true;
+}
+
+bool zeroExpectedSerial485() {
+    return zero_frame_expected;
+}
+
+bool zeroFrameSerial485(int &_azimuth) {
+    if (!zero_frame_received) return false;
+    _azimuth = zero_frame_azimuth;
+    zero_frame_received = false;
+    return true;
+}
+
+//////////
+
+std::vector<byte> readFromSerial485(const byte command, const bool &_log) {
+    // a zero frame can arrive just before a position response
+    RS485FrameParser parser{command, zero_frame_expected};
     std::vector<byte> buffer{};
-    if (value != -1) {
-        // read data from RS485
-        while (value != -1) {
-            delay(30);
-            buffer.push_back(static_cast<byte>(value));
-            value = KMPProDinoESP32.rs485Read();
+    buffer.reserve(parser.frameSize());
+    const unsigned long start_time{micros()};
+    // wait for data without polling: the UART event wakes up the reading, and the reading ends as soon as
+    // the frame is complete (if the frame length is unknown, it ends when the data stops arriving)
+    while (!parser.complete()) {
+        while (RS485Serial.available() && !parser.complete()) {
+            const byte data{static_cast<byte>(RS485Serial.read())};
+            switch (parser.feed(data)) {
+                case RS485FrameEvent::Response:
+                case RS485FrameEvent::Complete:
+                    buffer.push_back(data);
+                    break;
+                case RS485FrameEvent::ZeroComplete:
+                    storeZeroFrameSerial485(std::vector<byte>{parser.zeroFrame(), parser.zeroFrame() + 3});
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (parser.complete()) break;
+        const TickType_t timeout{parser.waitingFirstByte() ? RS485_RESPONSE_TIMEOUT : RS485_INTER_BYTE_TIMEOUT};
+        if (xSemaphoreTake(xSemaphore_rs485_rx, timeout) != pdTRUE && !RS485Serial.available()) break;
+    }
+    const unsigned long elapsed_time{micros() - start_time};
+    // response codification for logging
+    if (_log) {
+        if (buffer.empty()) {
+            logMessage("readFromSerial485", "No data received");
+        } else {
+            String strbuff{};
+            for (auto i : buffer) strbuff += String{i} + " ";
+            strbuff += String{"("} + elapsed_time + " us)";
+            if (parser.frameSize() != 0 && !parser.complete()) strbuff = String{"Error: incomplete frame "} + strbuff;
+            logMessage("readFromSerial485", strbuff);
         }
-        // response codification for logging
-        String strbuff{};
-        for (auto i : buffer) strbuff += String{i} + " ";
-        logMessage("readFromSerial485", strbuff);
     }
     return buffer;
 }
 
+const char *resultDescriptionSerial485(const RS485Result result) {
+    switch (result) {
+        case RS485Result::Done:
+            return "done";
+        case RS485Result::NoData:
+            return "Error: no data received";
+        case RS485Result::Expired:
+            return "Error: RS485 deadline expired";
+        case RS485Result::QueueFull:
+        default:
+            return "Error: RS485 queue full";
+    }
+}
+
+//////////
+
+// RS485 link statistics, updated mainly by the encoder task and read by the web server
+RS485Stats rs485_stats{};
+portMUX_TYPE rs485_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void incrementStatsSerial485(const RS485StatsCounter counter) {
+    portENTER_CRITICAL(&rs485_stats_mux);
+    switch (counter) {
+        case RS485StatsCounter::Timeout:
+            ++rs485_stats.timeouts;
+            break;
+        case RS485StatsCounter::ShortFrame:
+            ++rs485_stats.short_frames;
+            break;
+        case RS485StatsCounter::ChecksumError:
+            ++rs485_stats.checksum_errors;
+            break;
+        case RS485StatsCounter::QueueFull:
+            ++rs485_stats.queue_full;
+            break;
+        case RS485StatsCounter::DeadlineExpired:
+            ++rs485_stats.deadline_expired;
+            break;
+    }
+    portEXIT_CRITICAL(&rs485_stats_mux);
+}
+
+bool recordStatsSerial485(const byte command, const unsigned long elapsed_us, const size_t response_size) {
+    const size_t frame_size{responseLengthSerial485(command)};
+    if (response_size == 0 && frame_size != 0) {
+        incrementStatsSerial485(RS485StatsCounter::Timeout);
+        return false;
+    } else if (response_size != frame_size) {
+        incrementStatsSerial485(RS485StatsCounter::ShortFrame);
+        return false;
+    }
+    int bucket{};
+    while (bucket < RS485_STATS_BUCKETS - 1 && elapsed_us > rs485_stats_bucket_bounds[bucket]) ++bucket;
+    portENTER_CRITICAL(&rs485_stats_mux);
+    for (auto &command_stats : rs485_stats.commands) {
+        if (command_stats.command != command) continue;
+        ++command_stats.count;
+        ++command_stats.histogram[bucket];
+        command_stats.max_us = max(command_stats.max_us, static_cast<uint32_t>(elapsed_us));
+        command_stats.total_us += elapsed_us;
+        break;
+    }
+    portEXIT_CRITICAL(&rs485_stats_mux);
+    return true;
+}
+
+void resetStatsSerial485() {
+    const byte commands[RS485_STATS_COMMANDS]{0x23, 0x42, 0x44, 0x52, 0x57, 0x5A, 0xC0, 0xC1};
+    RS485Stats stats{};
+    for (int i{}; i < RS485_STATS_COMMANDS; ++i) stats.commands[i].command = commands[i];
+    stats.reset_time = millis();
+    portENTER_CRITICAL(&rs485_stats_mux);
+    rs485_stats = stats;
+    portEXIT_CRITICAL(&rs485_stats_mux);
+}
+
+RS485Stats statsSerial485() {
+    portENTER_CRITICAL(&rs485_stats_mux);
+    const RS485Stats stats{rs485_stats};
+    portEXIT_CRITICAL(&rs485_stats_mux);
+    return stats;
+}
+
+//////////
+
+void startSerial485() {
+    // transaction scheduler
+    for (auto &transaction : rs485_slots) transaction.done = xSemaphoreCreateBinary();
+    for (auto &queue : rs485_queues) queue = xQueueCreate(RS485_QUEUE_SIZE, sizeof(int));
+    resetStatsSerial485();
+    // port
+    KMPProDinoESP32.rs485Begin(RS485_BAUD_RATE);
+    /* The callback runs in the UART event task each time data is received (or the
+     * line goes idle), so the reader is notified without polling the buffer. */
+    RS485Serial.onReceive([]() {
+        xSemaphoreGive(xSemaphore_rs485_rx);
+        // the zero frame can arrive while the encoder task is idle
+        if (zero_frame_expected && encoder_task_handle != NULL) xTaskNotifyGive(encoder_task_handle);
+    });
+}
+
+//////////
+
+void writeToSerial485(const byte *data, const size_t size) {
+    // discard stale data (e.g. a late response of a previous command) and its pending event, but not a zero frame
+    processZeroSerial485();
+    while (RS485Serial.available()) RS485Serial.read();
+    xSemaphoreTake(xSemaphore_rs485_rx, 0);
+    KMPProDinoESP32.rs485Write(data, size);
+}
+
+void writeToSerial485(const byte data) {
+    writeToSerial485(&data, 1);
+}
+
+//////////
+
+// micros() of the first input change not yet seen by the loop, 0 if none (written by the interrupt handler)
+std::atomic<uint32_t> input_change_time{0};
+// micros() of the input change that woke the current loop pass, 0 if none or already probed
+uint32_t input_pass_time{0};
+// reaction time statistics, protected by input_latency_mux
+InputLatencyStats input_latency_stats{};
+portMUX_TYPE input_latency_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Interrupt handler of the optoin changes.
+ */
+void IRAM_ATTR inputChangeISR() {
+    // 0 means no change, so the (very unlikely) 0 timestamp is moved by 1 us
+    const uint32_t now{static_cast<uint32_t>(micros())};
+    uint32_t expected{0};
+    input_change_time.compare_exchange_strong(expected, now != 0 ? now : 1);
+    BaseType_t higher_priority_task_woken{pdFALSE};
+    vTaskNotifyGiveFromISR(loop_task_handle, &higher_priority_task_woken);
+    if (higher_priority_task_woken) portYIELD_FROM_ISR();
+}
+
+InputLatencyStats inputLatencyStats() {
+    portENTER_CRITICAL(&input_latency_mux);
+    const InputLatencyStats stats{input_latency_stats};
+    portEXIT_CRITICAL(&input_latency_mux);
+    return stats;
+}
+
+void probeInputLatency() {
+    if (input_pass_time == 0) return;
+    const uint32_t latency{static_cast<uint32_t>(micros()) - input_pass_time};
+    input_pass_time = 0;
+    portENTER_CRITICAL(&input_latency_mux);
+    input_latency_stats.last_us = latency;
+    input_latency_stats.max_us = max(input_latency_stats.max_us, latency);
+    ++input_latency_stats.count;
+    portEXIT_CRITICAL(&input_latency_mux);
+}
+
+void startInputInterrupts() {
+    loop_task_handle = xTaskGetCurrentTaskHandle();
+    customOptoIn.attachInterrupt(inputChangeISR);
+    customOptoIn.update();
+}
+
+bool waitInputChange(const TickType_t _timeout) {
+    // the changes happened while the loop was busy are pending notifications, so they are returned immediately
+    const bool changed{ulTaskNotifyTake(pdTRUE, _timeout) > 0};
+    input_pass_time = input_change_time.exchange(0);
+    // new control tick: every input macro is served from this snapshot
+    customOptoIn.update();
+    updateInputs();
+    return changed;
+}
+
 //////////
 
 void startOTA() {
@@ -301,40 +739,89 @@ void startOTA() {
 //////////////
 // LOW LEVEL
 
-bool buttonPressed(const OptoInC &button, const unsigned long &ms) {
-    if (customOptoIn.getState(button)) {
-        unsigned long time{};
-        // check short pression
-        time = millis() + 250;
-        if (customOptoIn.getState(button)) {
-            logMessage("buttonPressed", static_cast<int>(button), "Button pressed");
-            while (customOptoIn.getState(button) && millis() < time) delay(50);
+// debounced state of each optoin (by number), only used by the loop task
+DebouncedInput inputs[8]{};
+bool inputs_initialized{false};
+
+void updateInputs() {
+    const unsigned long now{millis()};
+    for (int i{}; i < 8; ++i) {
+        DebouncedInput &input{inputs[i]};
+        const bool raw{customOptoIn.getState(i)};
+        input.rose = input.fell = false;
+        // first tick: the inputs start settled, no edge at start up
+        if (!inputs_initialized) {
+            input.raw = input.state = raw;
+            input.raw_time = now;
+            continue;
         }
-        // long pression
-        if (customOptoIn.getState(button)) {
-            logMessage("buttonPressed", static_cast<int>(button), "Long pression detected");
-            if (xSemaphoreTake(xSemaphore_rs485, SEMAPHORE_RS485_TIMEOUT) != pdTRUE) {
-                logMessage("buttonPressed", static_cast<int>(button), "Error while acquiring semaphore");
+        if (raw != input.raw) {
+            input.raw = raw;
+            input.raw_time = now;
+        }
+        // the new state is accepted when stable for the filter time, and the edge is dated at the raw change
+        if (input.state != input.raw && now - input.raw_time >= input_filter_time[i]) {
+            input.state = input.raw;
+            if (input.state) {
+                input.rose = true;
+                input.rise_time = max(input.raw_time, 1ul);
             } else {
-                startSiren();
-                // check that the pressure lasts as long as required
-                time = millis() + ms;
-                while (customOptoIn.getState(button)) {
-                    delay(50);
-                    if (millis() > time) {
-                        // the user has pressed the button for more than a specific time
-                        xSemaphoreGive(xSemaphore_rs485);
-                        stopSiren();
-                        logMessage("buttonPressed", static_cast<int>(button), "Button pression completed");
-                        return true;
-                    }
-                }
-                xSemaphoreGive(xSemaphore_rs485);
-                stopSiren();
+                input.fell = true;
+                input.fall_time = max(input.raw_time, 1ul);
             }
         }
-        // early release
-        logMessage("buttonPressed", static_cast<int>(button), "Button released before completion");
+    }
+    inputs_initialized = true;
+}
+
+const DebouncedInput &debouncedInput(const OptoInC _input) {
+    return inputs[customOptoIn.getNumber(_input)];
+}
+
+bool inputHeld(const OptoInC _input, const unsigned long _ms) {
+    const DebouncedInput &input{debouncedInput(_input)};
+    return input.state && input.rise_time != 0 && millis() - input.rise_time >= _ms;
+}
+
+bool inputsSettling() {
+    for (const DebouncedInput &input : inputs)
+        if (input.raw != input.state) return true;
+    return false;
+}
+
+bool advanceGesture(ButtonGesture &_gesture, const bool _enabled) {
+    const DebouncedInput &button{debouncedInput(_gesture.button)};
+    const int number{customOptoIn.getNumber(_gesture.button) + 1};
+    switch (_gesture.state) {
+        case GestureState::Idle:
+            // each pression is handled once, so a button still pressed after the gesture doesn't restart it
+            if (_enabled && button.state && button.rise_time != _gesture.press_time) {
+                _gesture.press_time = button.rise_time;
+                _gesture.state = GestureState::Pressed;
+                logMessage("advanceGesture", number, "Button pressed");
+            }
+            break;
+        case GestureState::Pressed:
+            if (!_enabled || !button.state) {
+                _gesture.state = GestureState::Idle;
+                logMessage("advanceGesture", number, "Button released before completion");
+            } else if (inputHeld(_gesture.button, GESTURE_SIREN_DELAY)) {
+                logMessage("advanceGesture", number, "Long pression detected");
+                _gesture.siren = startSiren();
+                _gesture.state = GestureState::Siren;
+            }
+            break;
+        case GestureState::Siren:
+            if (!_enabled || !button.state || inputHeld(_gesture.button, GESTURE_SIREN_DELAY + _gesture.hold_time)) {
+                const bool completed{_enabled && button.state};
+                // a siren transaction still queued is dropped
+                _gesture.siren = RS485Future{};
+                stopSiren();
+                _gesture.state = GestureState::Idle;
+                logMessage("advanceGesture", number, completed ? "Button pression completed" : "Button released before completion");
+                return completed;
+            }
+            break;
     }
     return false;
 }
@@ -362,29 +849,41 @@ void startMotion(const DomeDirection &direction) {
         case DomeDirection::CW:
             logMessage("move", "Start CW motion");
             KMPProDinoESP32.setRelayState(CW_MOTOR, true);
+            setEstimatorMotion(1);
             break;
         case DomeDirection::CCW:
             logMessage("move", "Start CCW motion");
             KMPProDinoESP32.setRelayState(CCW_MOTOR, true);
+            setEstimatorMotion(-1);
             break;
     }
 }
 
 void stopMotion() {
-    KMPProDinoESP32.setRelayState(CCW_MOTOR, false);
-    KMPProDinoESP32.setRelayState(CW_MOTOR, false);
-    logMessage("stopMotion", "Motion stopped");
+    // both motor relays drop in the same SPI write, timed as benchmark
+    const uint32_t spi_start{MCP23S08.GetTransactionCount()};
+    const unsigned long start_time{micros()};
+    KMPProDinoESP32.setRelayMask(1 << CW_MOTOR | 1 << CCW_MOTOR, 0);
+    const unsigned long elapsed_us{micros() - start_time};
+    const uint32_t spi_transactions{MCP23S08.GetTransactionCount() - spi_start};
+    setEstimatorMotion(0);
+    logMessage("stopMotion", String{"Motion stopped ("} + spi_transactions + " SPI transactions, " + elapsed_us + " us)");
 }
 
 //////////
 
-void startSiren() {
-    KMPProDinoESP32.rs485Write(static_cast<byte>(0x42));
-    logMessage("startSiren", "Siren playing...");
+RS485Future startSiren() {
+    // suspend the position reading, otherwise the siren would stop at the next reading
+    siren_playing = true;
+    logMessage("startSiren", "Siren requested");
+    return submitSerial485(static_cast<byte>(0x42), RS485Priority::Siren);
 }
 
 void stopSiren() {
-    domePosition();  // siren stops at the first new command given, so the dome position request is ok
+    // siren stops at the first new command given, so the dome position request is ok
+    siren_playing = false;
+    encoder_poll_requested = true;
+    xTaskNotifyGive(encoder_task_handle);
     logMessage("stopSiren", "Siren stopped");
 }
 
@@ -402,13 +901,12 @@ bool writePositionToEncoder(const int position) {
     snprintf(log_buf, sizeof(log_buf), "Writing: %d, 0x%s", position, hex_string);
     logMessage("writePositionToEncoder", log_buf);
     // send position
-    if (xSemaphoreTake(xSemaphore_rs485, SEMAPHORE_RS485_TIMEOUT) != pdTRUE) {
-        logMessage("writePositionToEncoder", "Error: mutex acquired");
+    const byte command[]{static_cast<byte>(0x57), buf[0], buf[1]};
+    const RS485Result result{submitSerial485(command, sizeof(command), RS485Priority::Config).wait()};
+    if (result != RS485Result::Done) {
+        logMessage("writePositionToEncoder", resultDescriptionSerial485(result));
         return false;
     }
-    KMPProDinoESP32.rs485Write(static_cast<byte>(0x57));
-    KMPProDinoESP32.rs485Write(buf, sizeof(buf));
-    xSemaphoreGive(xSemaphore_rs485);
     logMessage("writePositionToEncoder", "Done");
     return true;
 }
@@ -416,77 +914,729 @@ bool writePositionToEncoder(const int position) {
 ///////////////
 // HIGH LEVEL
 
-int domePosition() {
-    logMessage("domePosition", "Request dome position...");
-    // acquire semaphore
-    if (xSemaphoreTake(xSemaphore_rs485, SEMAPHORE_RS485_TIMEOUT) != pdTRUE) {
-        logMessage("domePosition", "Error: mutex acquired");
-        return -2;
-    }
-    // request position
-    KMPProDinoESP32.rs485Write(static_cast<byte>(0x52));
-    const std::vector<byte> response{readFromSerial485()};
-    // give semaphore
-    xSemaphoreGive(xSemaphore_rs485);
+int domePosition(const bool &_log) {
+    if (_log) logMessage("domePosition", "Request dome position...");
+    // request position (the caller is the owner of the RS485 bus)
+    const unsigned long start_time{micros()};
+    writeToSerial485(static_cast<byte>(0x52));
+    const std::vector<byte> response{readFromSerial485(static_cast<byte>(0x52), _log)};
     // check response
-    if (response.empty()) {
-        logMessage("domePosition", "Error: no data recived");
+    if (!recordStatsSerial485(static_cast<byte>(0x52), micros() - start_time, response.size())) {
+        if (_log) logMessage("domePosition", "Error: no data recived");
         return -3;
     }
     // convert position to integer
     const int position{response[1] | response[0] << 8};
-    logMessage("domePosition", position);
+    if (position < 0 || position >= 360) {
+        if (_log) logMessage("domePosition", String{"Error: position out of range "} + position);
+        return -1;
+    }
+    if (_log) logMessage("domePosition", position);
     return position;
 }
 
 //////////
 
-void findZero() {
-    logMessage("findZero", "Start find-zero procedure");
-    std::vector<byte> response{};
+// dead-reckoning estimator state, protected by estimator_mux
+struct EstimatorState {
+    int direction;                  // motion direction: 1 CW, -1 CCW, 0 stopped
+    unsigned long motion_time;      // millis() of the last motion direction change
+    bool valid;                     // true after the first accepted reading
+    float azimuth;                  // base of the extrapolation: last accepted reading, or estimate at the last direction change
+    unsigned long timestamp;        // millis() of the extrapolation base
+    float anchor_azimuth;           // first reading of the rotation speed measurement
+    unsigned long anchor_time;      // millis() of anchor_azimuth, 0 if no measurement in progress
+    float velocity[2];              // learned rotation speed, CW and CCW
+    int consecutive_outliers;
+    uint32_t outliers;
+};
+EstimatorState estimator_state{};
+portMUX_TYPE estimator_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// estimate at a given time, to be called inside estimator_mux
+float extrapolateAzimuth(const EstimatorState &_state, const unsigned long _now) {
+    if (_state.direction == 0) return _state.azimuth;
+    const unsigned long elapsed{min(_now - _state.timestamp, static_cast<unsigned long>(ESTIMATOR_MAX_EXTRAPOLATION))};
+    const float azimuth{_state.azimuth + _state.direction * _state.velocity[_state.direction > 0 ? 0 : 1] * elapsed / 1000.0f};
+    return fmodf(azimuth + 360.0f, 360.0f);
+}
 
-    if (xSemaphoreTake(xSemaphore_rs485, SEMAPHORE_RS485_TIMEOUT) != pdTRUE) {
-        logMessage("findZero", "Error: mutex acquired");
-        return;
+// feed a valid reading to the estimator, to be called by publishEncoderSample; return false if rejected
+bool updateEstimator(const int _position, const unsigned long _now, const bool _resync) {
+    bool accepted{true};
+    portENTER_CRITICAL(&estimator_mux);
+    EstimatorState &state{estimator_state};
+    if (!state.valid || _resync) {
+        state.valid = true;
+        state.anchor_time = 0;
+        state.consecutive_outliers = 0;
+    } else if (fabsf(azimuthDifference(_position, extrapolateAzimuth(state, _now))) > ESTIMATOR_OUTLIER_THRESHOLD &&
+               ++state.consecutive_outliers <= ESTIMATOR_OUTLIER_LIMIT) {
+        ++state.outliers;
+        accepted = false;
+    } else {
+        state.consecutive_outliers = 0;
+        // learn the rotation speed in steady motion, measuring over a long enough baseline (the readings are integers)
+        if (state.direction != 0 && _now - state.motion_time >= ESTIMATOR_SPIN_UP_TIME) {
+            if (state.anchor_time == 0) {
+                state.anchor_azimuth = _position;
+                state.anchor_time = _now;
+            } else if (_now - state.anchor_time >= ESTIMATOR_VELOCITY_BASELINE) {
+                const float measured{state.direction * azimuthDifference(_position, state.anchor_azimuth) * 1000.0f / (_now - state.anchor_time)};
+                float &velocity{state.velocity[state.direction > 0 ? 0 : 1]};
+                if (measured > 0 && measured < ESTIMATOR_MAX_VELOCITY)
+                    velocity = velocity == 0 ? measured : velocity + ESTIMATOR_VELOCITY_ALPHA * (measured - velocity);
+                state.anchor_azimuth = _position;
+                state.anchor_time = _now;
+            }
+        }
     }
+    if (accepted) {
+        // in motion with a learned speed the reading corrects the estimate, so the integer readings do not make it
+        // jump back and forth; otherwise the reading is the new estimate
+        const float predicted{extrapolateAzimuth(state, _now)};
+        const float difference{azimuthDifference(_position, predicted)};
+        const bool filter{!_resync && state.direction != 0 && state.velocity[state.direction > 0 ? 0 : 1] > 0 && fabsf(difference) < ESTIMATOR_OUTLIER_THRESHOLD};
+        state.azimuth = filter ? fmodf(predicted + ESTIMATOR_READING_GAIN * difference + 360.0f, 360.0f) : _position;
+        state.timestamp = _now;
+    }
+    portEXIT_CRITICAL(&estimator_mux);
+    return accepted;
+}
 
-    // find zero
-    startMotion(DomeDirection::CW);
-    KMPProDinoESP32.rs485Write(static_cast<byte>(0x5A));
-    logMessage("findZero", "Searching zero...");
+float azimuthDifference(const float _az1, const float _az2) {
+    float difference{fmodf(_az1 - _az2, 360.0f)};
+    if (difference < -180.0f) difference += 360.0f;
+    if (difference >= 180.0f) difference -= 360.0f;
+    return difference;
+}
+
+float domeAzimuth() {
+    const unsigned long now{millis()};
+    portENTER_CRITICAL(&estimator_mux);
+    const float azimuth{estimator_state.valid ? extrapolateAzimuth(estimator_state, now) : -1.0f};
+    portEXIT_CRITICAL(&estimator_mux);
+    return azimuth;
+}
+
+EstimatorStatus estimatorStatus() {
+    portENTER_CRITICAL(&estimator_mux);
+    const EstimatorStatus status{estimator_state.velocity[0], estimator_state.velocity[1], estimator_state.outliers, estimator_state.direction, estimator_state.motion_time};
+    portEXIT_CRITICAL(&estimator_mux);
+    return status;
+}
+
+void setEstimatorMotion(const int _direction) {
+    const unsigned long now{millis()};
+    portENTER_CRITICAL(&estimator_mux);
+    EstimatorState &state{estimator_state};
+    if (_direction != state.direction) {
+        // rebase the extrapolation on the current estimate, then restart the speed measurement
+        state.azimuth = extrapolateAzimuth(state, now);
+        state.timestamp = now;
+        state.direction = _direction;
+        state.motion_time = now;
+        state.anchor_time = 0;
+    }
+    portEXIT_CRITICAL(&estimator_mux);
+}
+
+//////////
+
+// coast model and slew final errors, protected by coast_mux
+CoastStatus coast_status{};
+portMUX_TYPE coast_mux = portMUX_INITIALIZER_UNLOCKED;
+
+CoastStatus coastStatus() {
+    portENTER_CRITICAL(&coast_mux);
+    const CoastStatus status{coast_status};
+    portEXIT_CRITICAL(&coast_mux);
+    return status;
+}
+
+TickType_t encoderPollInterval() {
+    const EstimatorStatus status{estimatorStatus()};
+    const int target{target_az};
+    if (status.direction == 0 || target < 0) return ENCODER_POLL_INTERVAL;
+    const float remaining{status.direction * azimuthDifference(target, domeAzimuth())};
+    return remaining < COAST_APPROACH_DISTANCE + predictedCoast(status.direction) ? ENCODER_APPROACH_POLL_INTERVAL : ENCODER_POLL_INTERVAL;
+}
+
+void learnCoast(const int _direction, const float _cutoff_az, const int _settled_az, const int _target) {
+    const int index{_direction > 0 ? 0 : 1};
+    const float coast{_direction * azimuthDifference(_settled_az, _cutoff_az)};
+    portENTER_CRITICAL(&coast_mux);
+    // discard implausible measurements (e.g. a missed reading)
+    if (coast > -1.0f && coast < COAST_MAX) {
+        float &learned{coast_status.coast[index]};
+        learned = coast_status.samples[index] == 0 ? coast : learned + COAST_ALPHA * (coast - learned);
+        learned = max(learned, 0.0f);
+        ++coast_status.samples[index];
+    }
+    if (_target >= 0) {
+        const float error{azimuthDifference(_settled_az, _target)};
+        SlewResidualStats &residual{coast_status.residual[index]};
+        ++residual.count;
+        residual.sum += error;
+        residual.sum_abs += fabsf(error);
+        residual.max_abs = max(residual.max_abs, fabsf(error));
+    }
+    const float coast_cw{coast_status.coast[0]}, coast_ccw{coast_status.coast[1]};
+    portEXIT_CRITICAL(&coast_mux);
+    logMessage("learnCoast", String{"Coast "} + (_direction > 0 ? "CW " : "CCW ") + String{coast, 1} + ", model CW " + String{coast_cw, 2} + " CCW " + String{coast_ccw, 2});
+    // saved with the next EEPROM commit (the dome position is saved at each stop)
+    EEPROM.writeFloat(EEPROM_COAST_ADDRESS, coast_cw);
+    EEPROM.writeFloat(EEPROM_COAST_ADDRESS + sizeof(float), coast_ccw);
+}
+
+void loadCoast() {
+    for (int i{}; i < 2; ++i) {
+        const float coast{EEPROM.readFloat(EEPROM_COAST_ADDRESS + i * sizeof(float))};
+        // the EEPROM area can be uninitialized (e.g. after a firmware update)
+        coast_status.coast[i] = (std::isfinite(coast) && coast >= 0 && coast < COAST_MAX) ? coast : 0;
+    }
+    coast_status.residual_reset_time = millis();
+}
+
+float predictedCoast(const int _direction) {
+    portENTER_CRITICAL(&coast_mux);
+    const float coast{coast_status.coast[_direction > 0 ? 0 : 1]};
+    portEXIT_CRITICAL(&coast_mux);
+    return coast;
+}
+
+void resetSlewStatistics() {
+    const unsigned long now{millis()};
+    portENTER_CRITICAL(&coast_mux);
+    for (auto &residual : coast_status.residual) residual = SlewResidualStats{};
+    coast_status.residual_reset_time = now;
+    portEXIT_CRITICAL(&coast_mux);
+}
+
+//////////
+
+// seqlock protecting encoder_sample: odd while a new sample is being written
+std::atomic<uint32_t> encoder_seqlock{0};
+// encoder sample fields, written only inside encoder_seqlock odd periods
+std::atomic<int> encoder_sample_azimuth{-1};
+std::atomic<unsigned long> encoder_sample_timestamp{0};
+std::atomic<uint32_t> encoder_sample_sequence{0};
+std::atomic<int> encoder_sample_error{static_cast<int>(EncoderError::None)};
+// serialize writers and prevent their preemption while the seqlock is odd
+portMUX_TYPE encoder_sample_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void enableEncoderPolling(const int _position) {
+    publishEncoderSample(_position);
+    encoder_polling_enabled = true;
+    xTaskNotifyGive(encoder_task_handle);
+}
+
+EncoderSample encoderSample() {
+    EncoderSample sample{};
+    uint32_t seq_begin{}, seq_end{};
     do {
-        // no delay here since it is in the readFromSerial485 function
-        response = readFromSerial485();
-        logMessage("findZero", String{response.empty()} + status_finding_zero);
-    } while (response.empty() && status_finding_zero && AUTO);
-    stopMotion();
-    xSemaphoreGive(xSemaphore_rs485);
+        seq_begin = encoder_seqlock.load(std::memory_order_acquire);
+        sample.azimuth = encoder_sample_azimuth.load(std::memory_order_relaxed);
+        sample.timestamp = encoder_sample_timestamp.load(std::memory_order_relaxed);
+        sample.sequence = encoder_sample_sequence.load(std::memory_order_relaxed);
+        sample.error = static_cast<EncoderError>(encoder_sample_error.load(std::memory_order_relaxed));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        seq_end = encoder_seqlock.load(std::memory_order_relaxed);
+    } while ((seq_begin & 1) || seq_begin != seq_end);
+    return sample;
+}
+
+void publishEncoderSample(const int _position, const bool _resync) {
+    const unsigned long now{millis()};
+    int position{_position};
+    if (position >= 0 && position < 360 && !updateEstimator(position, now, _resync)) position = static_cast<int>(EncoderError::Outlier);
+    const bool valid{position >= 0 && position < 360};
+    portENTER_CRITICAL(&encoder_sample_mux);
+    encoder_seqlock.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if (valid) {
+        encoder_sample_azimuth.store(position, std::memory_order_relaxed);
+        encoder_sample_timestamp.store(now, std::memory_order_relaxed);
+    }
+    encoder_sample_error.store(valid ? static_cast<int>(EncoderError::None) : position, std::memory_order_relaxed);
+    encoder_sample_sequence.fetch_add(1, std::memory_order_relaxed);
+    encoder_seqlock.fetch_add(1, std::memory_order_release);
+    portEXIT_CRITICAL(&encoder_sample_mux);
+}
+
+bool requestEncoderSample(EncoderSample &_sample, const TickType_t _timeout) {
+    const uint32_t sequence{encoderSample().sequence};
+    const TickType_t start{xTaskGetTickCount()};
+    encoder_poll_requested = true;
+    xTaskNotifyGive(encoder_task_handle);
+    do {
+        delay(10);
+        _sample = encoderSample();
+        if (_sample.sequence != sequence) return true;
+    } while (xTaskGetTickCount() - start < _timeout);
+    return false;
+}
+
+//////////
+
+// trajectory buffer and slew index, protected by trajectory_mux
+TrajectorySample trajectory_buffer[TRAJECTORY_BUFFER_SIZE]{};
+// sequence number of the next sample (the buffer index is the sequence number modulo the buffer size)
+uint32_t trajectory_sequence{0};
+// sequence number of the first sample of the last slews, indexed by slew id modulo TRAJECTORY_SLEWS
+uint32_t trajectory_slew_begin[TRAJECTORY_SLEWS]{};
+// id of the last slew (0 if none)
+uint32_t trajectory_slew{0};
+bool trajectory_recording{false};
+TrajectoryType trajectory_type{TrajectoryType::Slew};
+portMUX_TYPE trajectory_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void recordTrajectorySample(const int _position, const unsigned long _latency_us) {
+    // everything but the slew is computed outside the critical section
+    const float estimate{domeAzimuth()};
+    const int direction{estimatorStatus().direction};
+    TrajectorySample sample{};
+    sample.timestamp = millis();
+    sample.latency_us = _latency_us;
+    sample.azimuth = _position;
+    sample.estimate = estimate < 0 ? -10 : lroundf(estimate * 10);
+    sample.target = target_az;
+    sample.relays = direction > 0 ? 1 : (direction < 0 ? 2 : 0);
+    portENTER_CRITICAL(&trajectory_mux);
+    if (trajectory_recording) {
+        sample.slew = trajectory_slew;
+        sample.type = trajectory_type;
+        trajectory_buffer[trajectory_sequence++ % TRAJECTORY_BUFFER_SIZE] = sample;
+    }
+    portEXIT_CRITICAL(&trajectory_mux);
+}
+
+/**
+ * @brief Last published position, or its error, for the samples not taken by the encoder task.
+ */
+int lastTrajectoryPosition() {
+    const EncoderSample sample{encoderSample()};
+    return sample.error == EncoderError::None ? sample.azimuth : static_cast<int>(sample.error);
+}
+
+void startTrajectory(const TrajectoryType _type) {
+    portENTER_CRITICAL(&trajectory_mux);
+    const bool already_recording{trajectory_recording};
+    if (!already_recording) {
+        ++trajectory_slew;
+        trajectory_slew_begin[trajectory_slew % TRAJECTORY_SLEWS] = trajectory_sequence;
+        trajectory_type = _type;
+        trajectory_recording = true;
+    }
+    portEXIT_CRITICAL(&trajectory_mux);
+    // starting point
+    if (!already_recording) recordTrajectorySample(lastTrajectoryPosition(), 0);
+}
+
+void stopTrajectory() {
+    // final point, then stop
+    recordTrajectorySample(lastTrajectoryPosition(), 0);
+    portENTER_CRITICAL(&trajectory_mux);
+    trajectory_recording = false;
+    portEXIT_CRITICAL(&trajectory_mux);
+}
+
+void trajectoryRange(const int _slews, uint32_t &_begin, uint32_t &_end) {
+    portENTER_CRITICAL(&trajectory_mux);
+    _end = trajectory_sequence;
+    const uint32_t slews{min(static_cast<uint32_t>(max(_slews, 0)), min(trajectory_slew, static_cast<uint32_t>(TRAJECTORY_SLEWS)))};
+    _begin = slews == 0 ? _end : trajectory_slew_begin[(trajectory_slew - slews + 1) % TRAJECTORY_SLEWS];
+    portEXIT_CRITICAL(&trajectory_mux);
+    // the oldest samples may have been overwritten
+    if (_end - _begin > TRAJECTORY_BUFFER_SIZE) _begin = _end - TRAJECTORY_BUFFER_SIZE;
+}
+
+bool trajectorySample(const uint32_t _sequence, TrajectorySample &_sample) {
+    portENTER_CRITICAL(&trajectory_mux);
+    const uint32_t age{trajectory_sequence - _sequence};
+    const bool available{age > 0 && age <= TRAJECTORY_BUFFER_SIZE};
+    if (available) _sample = trajectory_buffer[_sequence % TRAJECTORY_BUFFER_SIZE];
+    portEXIT_CRITICAL(&trajectory_mux);
+    return available;
+}
+
+//////////
 
-    // handle errors
-    if (!AUTO) {
-        xSemaphoreTake(xSemaphore, portMAX_DELAY);
+// find-zero procedure status, written by the loop and protected by find_zero_mux
+FindZeroStatus find_zero_status{false, 0, 0, -1, false};
+portMUX_TYPE find_zero_mux = portMUX_INITIALIZER_UNLOCKED;
+// last encoder reading seen by the procedure, for the travelled degrees
+int find_zero_last_az{-1};
+
+void startFindZero() {
+    logMessage("findZero", "Start find-zero procedure");
+    startTrajectory(TrajectoryType::FindZero);
+    startMotion(DomeDirection::CW);
+    // the zero response arrives only when the zero switch is reached, meanwhile the position is read as usual
+    const bool requested{requestZeroSerial485()};
+    find_zero_last_az = encoderSample().azimuth;
+    portENTER_CRITICAL(&find_zero_mux);
+    find_zero_status = FindZeroStatus{requested, millis(), 0, -1, false};
+    portEXIT_CRITICAL(&find_zero_mux);
+    if (requested) {
+        logMessage("findZero", "Searching zero...");
+    } else {
+        stopMotion();
+        stopTrajectory();
         status_finding_zero = false;
-        logMessage("findZero", "Manual mode, aborting.");
-        xSemaphoreGive(xSemaphore);
-        return;
-    } else if (!status_finding_zero) {
-        logMessage("findZero", "Zero aborted");
-        return;
-    } else if (response[0] != static_cast<byte>(0x5A) || response.size() != 3) {
-        logMessage("findZero", "Wrong encoder response");
-        return;
+        logMessage("findZero", "Error: zero request not sent");
     }
+}
 
-    // find zero ok
-    xSemaphoreTake(xSemaphore, portMAX_DELAY);
-    logMessage("findZero", "Zero found");
+bool advanceFindZero() {
+    // progress: clockwise path from the readings, and remaining path to the zero switch at the learned speed
+    const int azimuth{encoderSample().azimuth};
+    float travelled{findZeroStatus().travelled};
+    if (find_zero_last_az >= 0 && azimuth >= 0) travelled += max(azimuthDifference(azimuth, find_zero_last_az), 0.0f);
+    find_zero_last_az = azimuth;
+    const float velocity{estimatorStatus().velocity_cw};
+    const float dome_az{domeAzimuth()};
+    const float eta{velocity > 0 && dome_az >= 0 ? fmodf(ZERO_POSITION - dome_az + 360.0f, 360.0f) / velocity : -1.0f};
+    portENTER_CRITICAL(&find_zero_mux);
+    find_zero_status.travelled = travelled;
+    find_zero_status.eta = eta;
+    const unsigned long start_time{find_zero_status.start_time};
+    portEXIT_CRITICAL(&find_zero_mux);
+
+    // end conditions, checked at each tick
+    int zero_az{-1};
+    const bool found{zeroFrameSerial485(zero_az)};
+    if (!found && AUTO && status_finding_zero && millis() - start_time < FIND_ZERO_TIMEOUT) return false;
+    stopMotion();
+    cancelZeroSerial485();
+    if (!found) {
+        if (!AUTO)
+            logMessage("findZero", "Manual mode, aborting.");
+        else if (!status_finding_zero)
+            logMessage("findZero", "Zero aborted");
+        else
+            logMessage("findZero", "Error: zero not found before timeout");
+    } else {
+        logMessage("findZero", String{"Zero found: "} + zero_az + " (" + travelled + " degrees travelled)");
+        publishEncoderSample(zero_az, true);
+        if (zero_az >= 0 && zero_az < 360) {
+            current_az = zero_az;
+            EEPROM.writeInt(EEPROM_DOME_POSITION_ADDRESS, current_az);
+            EEPROM.commit();
+        }
+    }
+    stopTrajectory();
     status_finding_zero = false;
-    current_az = response[2] | response[1] << 8;
-    if (current_az >= 0 && current_az < 360) {
-        EEPROM.writeInt(EEPROM_DOME_POSITION_ADDRESS, current_az);
-        EEPROM.commit();
+    portENTER_CRITICAL(&find_zero_mux);
+    find_zero_status.searching = false;
+    find_zero_status.found = found;
+    portEXIT_CRITICAL(&find_zero_mux);
+    return true;
+}
+
+FindZeroStatus findZeroStatus() {
+    portENTER_CRITICAL(&find_zero_mux);
+    const FindZeroStatus status{find_zero_status};
+    portEXIT_CRITICAL(&find_zero_mux);
+    return status;
+}
+
+//////////
+
+// operations of the command queue (indexed by id), protected by operation_mux
+DomeOperation operations[OPERATION_HISTORY_SIZE]{};
+uint32_t operation_last_id{0};
+portMUX_TYPE operation_mux = portMUX_INITIALIZER_UNLOCKED;
+
+uint32_t submitOperation(const OperationType _type, const int _target) {
+    const unsigned long now{max(millis(), 1ul)};
+    uint32_t id{0};
+    bool collapsed{false};
+    portENTER_CRITICAL(&operation_mux);
+    int queued{};
+    for (auto &operation : operations) {
+        if (operation.id == 0 || operation.state != OperationState::Queued) continue;
+        // repeated slews collapse into the queued one, that takes the latest target
+        if (_type == OperationType::SlewToAz && operation.type == OperationType::SlewToAz) {
+            operation.target = _target;
+            ++operation.collapsed;
+            id = operation.id;
+            collapsed = true;
+            break;
+        }
+        // an abort cancels the queued motions
+        if (_type == OperationType::Abort && (operation.type == OperationType::SlewToAz || operation.type == OperationType::Park || operation.type == OperationType::FindZero)) {
+            operation.state = OperationState::Failed;
+            operation.error = "Error: aborted";
+            operation.end_time = now;
+            continue;
+        }
+        ++queued;
+    }
+    // new operation, if there is room in the queue (the queued operations are never overwritten, since they are at
+    // most OPERATION_QUEUE_SIZE and the newest ones)
+    if (!collapsed && queued < OPERATION_QUEUE_SIZE) {
+        id = ++operation_last_id;
+        operations[id % OPERATION_HISTORY_SIZE] = DomeOperation{id, _type, OperationState::Queued, 0, _target, nullptr, now, 0, 0};
+    }
+    portEXIT_CRITICAL(&operation_mux);
+    if (id == 0) {
+        logMessage("submitOperation", operationName(_type), "Error: command queue full");
+        return 0;
+    }
+    logMessage("submitOperation", operationName(_type), String{collapsed ? "Merged into operation " : "Queued operation "} + id);
+    // wake up the loop, it executes the operation at once
+    if (loop_task_handle != NULL) xTaskNotifyGive(loop_task_handle);
+    return id;
+}
+
+bool submitOperationBatch(const OperationType *_types, const int *_targets, const int _count, uint32_t *_ids) {
+    const unsigned long now{max(millis(), 1ul)};
+    bool abort{false};
+    for (int i{}; i < _count; ++i)
+        if (_types[i] == OperationType::Abort) abort = true;
+    portENTER_CRITICAL(&operation_mux);
+    int queued{};
+    for (auto &operation : operations) {
+        if (operation.id == 0 || operation.state != OperationState::Queued) continue;
+        // an abort cancels the queued motions
+        if (abort && (operation.type == OperationType::SlewToAz || operation.type == OperationType::Park || operation.type == OperationType::FindZero)) {
+            operation.state = OperationState::Failed;
+            operation.error = "Error: aborted";
+            operation.end_time = now;
+            continue;
+        }
+        ++queued;
+    }
+    // all the operations, with consecutive ids, or none
+    const bool room{queued + _count <= OPERATION_QUEUE_SIZE};
+    if (room) {
+        const uint32_t batch{operation_last_id + 1};
+        for (int i{}; i < _count; ++i) {
+            _ids[i] = ++operation_last_id;
+            operations[_ids[i] % OPERATION_HISTORY_SIZE] = DomeOperation{_ids[i], _types[i], OperationState::Queued, 0, _targets[i], nullptr, now, 0, 0, batch};
+        }
+    }
+    portEXIT_CRITICAL(&operation_mux);
+    if (!room) {
+        logMessage("submitOperationBatch", String{_count} + " operations", "Error: command queue full");
+        return false;
+    }
+    logMessage("submitOperationBatch", String{_count} + " operations", String{"Queued operations "} + _ids[0] + "-" + _ids[_count - 1]);
+    // wake up the loop, it executes the operations at once
+    if (loop_task_handle != NULL) xTaskNotifyGive(loop_task_handle);
+    return true;
+}
+
+// execute an operation of the command queue, return the failure reason or nullptr on success
+const char *executeOperation(const DomeOperation &_operation) {
+    switch (_operation.type) {
+        case OperationType::Abort:
+            if (!AUTO) return "Error: dome in manual mode";
+            if (!SWITCHBOARD_STATUS) return "Error: switchboard off";
+            status_finding_zero = status_finding_park = false;
+            if (MOVEMENT_STATUS) stopSlewing();
+            return nullptr;
+        case OperationType::SlewToAz:
+            if (!AUTO) return "Error: dome in manual mode";
+            if (!AC_PRESENCE) return "Error: no AC";
+            if (!SWITCHBOARD_STATUS) return "Error: switchboard off";
+            if (status_finding_zero) return "Error: finding zero";
+            if (status_finding_park) return "Error: parking";
+            startSlewing(_operation.target);
+            return nullptr;
+        case OperationType::Park:
+            if (!AUTO) return "Error: dome in manual mode";
+            if (!SWITCHBOARD_STATUS) return "Error: switchboard off";
+            if (status_finding_zero) return "Error: finding zero";
+            if (status_finding_park || status_park) return nullptr;
+            if (!MOVEMENT_STATUS && abs(encoderSample().azimuth - PARK_POSITION) < 2) {
+                status_park = true;
+                EEPROM.writeBool(EEPROM_PARK_STATE_ADDRESS, status_park);
+                EEPROM.commit();
+            } else {
+                park();
+            }
+            return nullptr;
+        case OperationType::FindZero:
+            if (!AUTO) return "Error: dome in manual mode";
+            if (!AC_PRESENCE) return "Error: no AC";
+            if (!SWITCHBOARD_STATUS) return "Error: switchboard off";
+            if (MOVEMENT_STATUS) return "Error: dome moving";
+            // the procedure is started by the loop
+            status_finding_zero = true;
+            return nullptr;
+        case OperationType::IgniteSwitchboard:
+            if (!status_switchboard_ignited) {
+                switchboardIgnition();
+                status_switchboard_ignited = true;
+            }
+            return nullptr;
+        case OperationType::Restart:
+            if (MOVEMENT_STATUS) return "Error: dome is moving";
+            if (!AC_PRESENCE) return "Error: no AC";
+            shutDown();
+            SSELogger.close();
+            ESP.restart();
+            return nullptr;
+        case OperationType::TurnOff:
+            if (!AUTO) return "Error: dome in manual mode";
+            if (!AC_PRESENCE) return "Error: no AC";
+            shutDown();
+            return nullptr;
+    }
+    return "Error: unknown operation";
+}
+
+// batch operation (find-zero or park) waiting for the end of its procedure (id 0 if none)
+DomeOperation operation_procedure{};
+
+// publish the result of an operation, a failed operation of a batch fails the following ones
+void endOperation(const DomeOperation &_operation, const char *_error) {
+    portENTER_CRITICAL(&operation_mux);
+    DomeOperation &slot{operations[_operation.id % OPERATION_HISTORY_SIZE]};
+    if (slot.id == _operation.id) {
+        slot.state = _error == nullptr ? OperationState::Done : OperationState::Failed;
+        slot.error = _error;
+        slot.end_time = max(millis(), 1ul);
+    }
+    if (_error != nullptr && _operation.batch != 0) {
+        for (auto &i : operations) {
+            if (i.batch != _operation.batch || i.state != OperationState::Queued) continue;
+            i.state = OperationState::Failed;
+            i.error = "Error: previous batch operation failed";
+            i.end_time = max(millis(), 1ul);
+        }
+    }
+    portEXIT_CRITICAL(&operation_mux);
+    logMessage("processOperations", operationName(_operation.type), String{"Operation "} + _operation.id + ": " + (_error == nullptr ? "done" : _error));
+}
+
+void processOperations() {
+    for (;;) {
+        // end of the procedure of a batch operation (an abort or the manual mode end it too)
+        if (operation_procedure.id != 0 && !status_finding_zero && !status_finding_park) {
+            const bool find_zero{operation_procedure.type == OperationType::FindZero};
+            const bool reached{find_zero ? findZeroStatus().found : status_park};
+            endOperation(operation_procedure, reached ? nullptr : find_zero ? "Error: zero not found" : "Error: park not reached");
+            operation_procedure.id = 0;
+        }
+
+        // oldest queued operation (only the aborts of other batches while a procedure holds the queue)
+        DomeOperation operation{};
+        portENTER_CRITICAL(&operation_mux);
+        DomeOperation *next{nullptr};
+        for (auto &i : operations)
+            if (i.id != 0 && i.state == OperationState::Queued && (operation_procedure.id == 0 || (i.type == OperationType::Abort && i.batch != operation_procedure.batch)) &&
+                (next == nullptr || i.id < next->id))
+                next = &i;
+        if (next != nullptr) {
+            next->state = OperationState::Running;
+            next->start_time = max(millis(), 1ul);
+            operation = *next;
+        }
+        portEXIT_CRITICAL(&operation_mux);
+        if (next == nullptr) return;
+
+        // execute and publish the result
+        logMessage("processOperations", operationName(operation.type), String{"Running operation "} + operation.id);
+        const char *error{executeOperation(operation)};
+        // a find-zero or park of a batch ends with its procedure, the rest of the batch waits for it
+        if (error == nullptr && operation.batch != 0 &&
+            ((operation.type == OperationType::FindZero && status_finding_zero) || (operation.type == OperationType::Park && status_finding_park))) {
+            operation_procedure = operation;
+            logMessage("processOperations", operationName(operation.type), String{"Operation "} + operation.id + ": waiting for the procedure");
+            continue;
+        }
+        endOperation(operation, error);
+        // the next operations run at the next tick, with the inputs refreshed after the ignition
+        if (error == nullptr && operation.type == OperationType::IgniteSwitchboard) return;
+    }
+}
+
+bool operationStatus(const uint32_t _id, DomeOperation &_operation) {
+    portENTER_CRITICAL(&operation_mux);
+    const DomeOperation &operation{operations[_id % OPERATION_HISTORY_SIZE]};
+    const bool known{_id != 0 && operation.id == _id};
+    if (known) _operation = operation;
+    portEXIT_CRITICAL(&operation_mux);
+    return known;
+}
+
+const char *operationName(const OperationType _type) {
+    switch (_type) {
+        case OperationType::Abort:
+            return "abort";
+        case OperationType::SlewToAz:
+            return "slew-to-az";
+        case OperationType::Park:
+            return "park";
+        case OperationType::FindZero:
+            return "find-zero";
+        case OperationType::IgniteSwitchboard:
+            return "ignite-switchboard";
+        case OperationType::Restart:
+            return "restart";
+        case OperationType::TurnOff:
+        default:
+            return "turn-off";
     }
-    xSemaphoreGive(xSemaphore);
+}
+
+//////////
+
+// status snapshot, written only by the loop and protected by status_record_mux
+StatusRecord status_record{};
+portMUX_TYPE status_record_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void publishStatusRecord() {
+    // zero the padding too, since the values are compared as raw bytes
+    StatusValues values;
+    memset(&values, 0, sizeof(values));
+    values.dome_azimuth = static_cast<int>(roundf(domeAzimuth() * 10));
+    values.target_azimuth = target_az;
+    values.in_park = status_park;
+    values.finding_park = status_finding_park;
+    values.finding_zero = status_finding_zero;
+    const FindZeroStatus find_zero{findZeroStatus()};
+    values.find_zero_travelled = static_cast<int>(roundf(find_zero.travelled * 10));
+    values.find_zero_eta = find_zero.searching && find_zero.eta >= 0 ? static_cast<int>(roundf(find_zero.eta)) : -1;
+    values.relays = KMPProDinoESP32.getRelayMask();
+    for (int i{}; i < 8; ++i)
+        if (customOptoIn.getState(i)) values.optoins |= 1 << i;
+    const EncoderSample encoder{encoderSample()};
+    values.encoder_error = encoder.error;
+    const EstimatorStatus estimator{estimatorStatus()};
+    values.velocity_cw = static_cast<int>(roundf(estimator.velocity_cw * 100));
+    values.velocity_ccw = static_cast<int>(roundf(estimator.velocity_ccw * 100));
+    values.outliers = estimator.outliers;
+    values.spi_per_tick = KMPProDinoESP32.getTickSpiTransactions();
+    values.spi_per_tick_max = KMPProDinoESP32.getTickSpiTransactions(true);
+    const InputLatencyStats input_latency{inputLatencyStats()};
+    values.latency_last_us = input_latency.last_us;
+    values.latency_max_us = input_latency.max_us;
+    values.reactions = input_latency.count;
+
+    // new version only if something changed, or to refresh uptime and ages (only the loop writes the record)
+    const unsigned long now{millis()};
+    const bool changed{status_record.version == 0 || memcmp(&values, &status_record.values, sizeof(values)) != 0};
+    if (!changed && now - status_record.time < STATUS_REFRESH_INTERVAL) return;
+    portENTER_CRITICAL(&status_record_mux);
+    ++status_record.version;
+    if (changed) status_record.change_version = status_record.version;
+    status_record.time = now;
+    status_record.encoder_time = encoder.timestamp;
+    status_record.image_time = customOptoIn.imageTime();
+    status_record.values = values;
+    portEXIT_CRITICAL(&status_record_mux);
+    if (status_task_handle != NULL) xTaskNotifyGive(status_task_handle);
+}
+
+StatusRecord statusRecord() {
+    portENTER_CRITICAL(&status_record_mux);
+    const StatusRecord record{status_record};
+    portEXIT_CRITICAL(&status_record_mux);
+    return record;
 }
 
 //////////
@@ -495,17 +1645,30 @@ void shutDown() {
     logMessage("shutDown", "Shutting down...");
 
     // turn off relays
+    const uint32_t spi_start{MCP23S08.GetTransactionCount()};
     KMPProDinoESP32.setAllRelaysOff();
-    logMessage("shutDown", "All relays off");
+    const uint32_t spi_transactions{MCP23S08.GetTransactionCount() - spi_start};
+    setEstimatorMotion(0);
+    logMessage("shutDown", String{"All relays off ("} + spi_transactions + " SPI transactions)");
     delay(500);
 
-    // save status
-    current_az = domePosition();
-    if (current_az >= 0 && current_az < 360) {
+    // save status, reading the position as emergency transaction since the power is going to be lost
+    std::vector<byte> response{};
+    int position{static_cast<int>(EncoderError::NoData)};
+    if (submitSerial485(static_cast<byte>(0x52), RS485Priority::Emergency).wait(&response) == RS485Result::Done) {
+        position = response[1] | response[0] << 8;
+        if (position < 0 || position >= 360) position = static_cast<int>(EncoderError::Generic);
+    }
+    publishEncoderSample(position);
+    const EncoderSample sample{encoderSample()};
+    if (sample.error == EncoderError::None) {
+        current_az = sample.azimuth;
         EEPROM.writeInt(EEPROM_DOME_POSITION_ADDRESS, current_az);
         EEPROM.commit();
+        logMessage("shutDown", "Dome position saved");
+    } else {
+        logMessage("shutDown", "Error: dome position not available, not saved");
     }
-    logMessage("shutDown", "Dome position saved");
 }
 
 //////////
@@ -515,6 +1678,7 @@ void startSlewing(const int new_target_az) {
         return;
 
     target_az = new_target_az % 360;
+    current_az = encoderSample().azimuth;
 
     logMessage("startSlewing", String{"Start slewing to "} + target_az);
     if (status_park) {
@@ -536,6 +1700,7 @@ void startSlewing(const int new_target_az) {
     } else*/
     if (!MOVEMENT_STATUS || (IS_MOVING_CW && direction == DomeDirection::CCW) || (IS_MOVING_CCW && direction == DomeDirection::CW)) {
         logMessage("startSlewing", "Start slew needed");
+        startTrajectory(status_finding_park ? TrajectoryType::Park : TrajectoryType::Slew);
         startMotion(direction);
     } else {
         logMessage("startSlewing", "Start slew not needed");
@@ -544,12 +1709,29 @@ void startSlewing(const int new_target_az) {
 
 //////////
 
-void stopSlewing() {
-    logMessage("stopSlewing", "Stop slewing and saving state...");
-
-    // stop and wait for dome drift stabilization
+// settling after a stop, written and read only by the loop task
+struct SettleState {
+    bool active;
+    int direction;                  // direction of the steady motion stopped, 0 if the coast is not to be learned
+    float cutoff_az;                // estimated azimuth at the relay cut-off
+    int target;                     // slew target reached, -1 if none
+    unsigned long start_time;       // millis() of the relay cut-off
+    unsigned long stable_time;      // millis() of the last position change
+    int last_azimuth;               // last valid reading after the cut-off, -1 if none
+    uint32_t sequence;              // sequence number of the last encoder reading seen
+};
+SettleState settle_state{};
+
+void stopSlewing(const bool _target_reached) {
+    logMessage("stopSlewing", "Stop slewing, waiting for the dome to settle...");
+
+    // stop, remembering the cut-off point for the coast model
+    const EstimatorStatus estimator{estimatorStatus()};
+    const bool steady_motion{estimator.direction != 0 && millis() - estimator.motion_time >= ESTIMATOR_SPIN_UP_TIME};
+    const float cutoff_az{domeAzimuth()};
+    const int target{target_az};
     stopMotion();
-    delay(500);
+    probeInputLatency();
 
     if (AUTO) {
         status_finding_zero = false;
@@ -561,14 +1743,56 @@ void stopSlewing() {
         status_finding_park = false;
     }
 
-    // save state
-    target_az = current_az = domePosition();
-    if (current_az >= 0 && current_az < 360) {
+    // the drift is followed by advanceSettle at each tick, that saves the position when the dome is settled
+    const unsigned long now{millis()};
+    target_az = current_az;
+    settle_state = SettleState{true, steady_motion ? estimator.direction : 0, cutoff_az, _target_reached ? target : -1, now, now, -1,
+                               encoderSample().sequence};
+}
+
+//////////
+
+void advanceSettle() {
+    if (!settle_state.active) return;
+
+    // a new motion takes over: its trajectory is already started, and its stop saves the position
+    if (MOVEMENT_STATUS) {
+        settle_state.active = false;
+        logMessage("advanceSettle", "Settling interrupted by a new motion");
+        return;
+    }
+
+    // one encoder reading per tick at most: the position must not change for COAST_SETTLE_TIME
+    const EncoderSample sample{encoderSample()};
+    if (sample.sequence != settle_state.sequence) {
+        settle_state.sequence = sample.sequence;
+        if (sample.error == EncoderError::None && sample.azimuth != settle_state.last_azimuth) {
+            settle_state.last_azimuth = sample.azimuth;
+            settle_state.stable_time = millis();
+        }
+    }
+    const bool settled{settle_state.last_azimuth >= 0 && millis() - settle_state.stable_time >= COAST_SETTLE_TIME};
+    if (!settled && millis() - settle_state.start_time < COAST_SETTLE_TIMEOUT) return;
+    settle_state.active = false;
+
+    if (settled && settle_state.direction != 0)
+        learnCoast(settle_state.direction, settle_state.cutoff_az, settle_state.last_azimuth, settle_state.target);
+
+    // save state, with the last valid reading after the cut-off (settled or not)
+    if (settle_state.last_azimuth >= 0) {
+        target_az = current_az = settle_state.last_azimuth;
         EEPROM.writeInt(EEPROM_DOME_POSITION_ADDRESS, current_az);
         EEPROM.commit();
+    } else {
+        logMessage("advanceSettle", "Error: dome position not updated");
     }
+    stopTrajectory();
+
+    logMessage("advanceSettle", settled ? "Done" : "Done, dome not settled within the timeout");
+}
 
-    logMessage("stopSlewing", "Done");
+bool settlingDome() {
+    return settle_state.active;
 }
 
 //////////
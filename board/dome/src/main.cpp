@@ -33,21 +33,35 @@ SOFTWARE.
 
 #define TIME_SIREN 3000
 #define TIME_BUTTON 2000
+// AC loss is handled after this time, in milliseconds
+#define AC_LOSS_TIME 1000
 
 bool manual_reset_needed{};
+// manual gestures: rotation buttons and switchboard ignition button
+ButtonGesture gesture_cw{MAN_CW_O, TIME_BUTTON};
+ButtonGesture gesture_ccw{MAN_CCW_O, TIME_BUTTON};
+ButtonGesture gesture_ignition{MAN_IGNITION_O, TIME_SIREN};
+ManualRotation manual_rotation{ManualRotation::Idle};
 bool error_AC_flag{false};
-unsigned int error_AC_counter{0};
+// millis() of the AC loss, 0 if AC present
+unsigned long error_AC_time{0};
 
 ////////// global vars (init vars in "global_definitions.hpp")
 
 bool blink_led_loop{true};
 
 SemaphoreHandle_t xSemaphore{xSemaphoreCreateMutex()};
-SemaphoreHandle_t xSemaphore_rs485{xSemaphoreCreateMutex()};
 
 int current_az{-1};
 int target_az{-1};
 
+TaskHandle_t loop_task_handle{NULL};
+
+TaskHandle_t encoder_task_handle{NULL};
+std::atomic<bool> encoder_polling_enabled{false};
+std::atomic<bool> encoder_poll_requested{false};
+std::atomic<bool> siren_playing{false};
+
 bool status_park{false};
 bool status_finding_park{false};
 bool status_finding_zero{false};
@@ -55,6 +69,9 @@ bool status_switchboard_ignited{false};
 
 AsyncWebServer WebServer{80};
 AsyncEventSource SSELogger{"/log_sse"};
+AsyncEventSource StatusSSE{"/status_sse"};
+
+TaskHandle_t status_task_handle{NULL};
 
 //////////
 
@@ -68,8 +85,11 @@ void setup() {
     logMessage("setup", "Setup board");
     KMPProDinoESP32.begin(ProDino_ESP32_Ethernet, false, false);
     KMPProDinoESP32.setStatusLed(yellow);
-    KMPProDinoESP32.rs485Begin(19200);
+    startSerial485();
+    // start encoder task, the owner of the RS485 bus
+    xTaskCreateUniversal(encoder_task, "encoder_task", 4096, NULL, 2, &encoder_task_handle, -1);
     customOptoIn.setup(INPUT_PULLUP);
+    startInputInterrupts();
 
     // EEPROM
     logMessage("setup", "Reading EEPROM");
@@ -79,10 +99,13 @@ void setup() {
         EEPROM.writeBool(EEPROM_INITIALIZED_ADDRESS, true);
         EEPROM.writeInt(EEPROM_DOME_POSITION_ADDRESS, PARK_POSITION);
         EEPROM.writeBool(EEPROM_PARK_STATE_ADDRESS, false);
+        EEPROM.writeFloat(EEPROM_COAST_ADDRESS, 0);
+        EEPROM.writeFloat(EEPROM_COAST_ADDRESS + sizeof(float), 0);
         EEPROM.commit();
     }
     status_park = EEPROM.readBool(EEPROM_PARK_STATE_ADDRESS);
     target_az = current_az = EEPROM.readInt(EEPROM_DOME_POSITION_ADDRESS);
+    loadCoast();
 
     // SPIFFS
     SPIFFS.begin();
@@ -95,13 +118,19 @@ void setup() {
     startOTA();
     // start network task
     xTaskCreateUniversal(net_task, "net_task", 4096, NULL, 2, NULL, -1);
+    // start status task, that pushes the status events
+    xTaskCreateUniversal(status_task, "status_task", 4096, NULL, 1, &status_task_handle, -1);
 
     // write current position to encoder
     while (!writePositionToEncoder(current_az)) delay(500);
+    // from now on the encoder task reads the position periodically
+    enableEncoderPolling(current_az);
     // fix status_switchboard_ignited if reboot with switchboard on
     status_switchboard_ignited = SWITCHBOARD_STATUS;
     // set the manual reset flag to the current status
     manual_reset_needed = !AUTO;
+    // first status snapshot, then refreshed by the loop
+    publishStatusRecord();
 
     // end
     logMessage("setup", "End SETUP, starting LOOP");
@@ -110,7 +139,11 @@ void setup() {
 //////////
 
 void loop() {
-    delay(100);
+    // next pass at the first input change, or after LOOP_INTERVAL (INPUT_TICK_INTERVAL while filtering inputs
+    // or following a gesture)
+    const bool gesture_active{gesture_cw.state != GestureState::Idle || gesture_ccw.state != GestureState::Idle ||
+                              gesture_ignition.state != GestureState::Idle};
+    waitInputChange(inputsSettling() || gesture_active ? INPUT_TICK_INTERVAL : LOOP_INTERVAL);
     // blink led on/off every two seconds
     if (blink_led_loop) KMPProDinoESP32.processStatusLed(blue, 1000);
 
@@ -118,16 +151,45 @@ void loop() {
     // motion handle
 
     if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(50)) == pdTRUE) {
+        // update dome position from the last encoder reading (it never contains error codes)
+        current_az = encoderSample().azimuth;
+
+        // API commands, queued by the web server
+        processOperations();
+
+        // manual rotation: stop at the button release, or if the auto mode or the switchboard off take over
+        if (manual_rotation != ManualRotation::Idle) {
+            const bool cw{manual_rotation == ManualRotation::CW};
+            if (AUTO || !SWITCHBOARD_STATUS || !(cw ? MAN_CW : MAN_CCW)) {
+                stopSlewing();  // stopMotion only stops relays, so use stopSlewing to also save states
+                manual_rotation = ManualRotation::Idle;
+                logMessage("loop", cw ? "End clockwise motion" : "End counterclockwise motion");
+            }
+        }
+
+        // settling after a stop, advanced at each tick (the loop is not held while the dome drifts)
+        if (settlingDome()) advanceSettle();
+
+        // find-zero procedure, advanced at each tick (the abort command or the manual mode end it within a tick)
+        if (findZeroStatus().searching) advanceFindZero();
+
+        // manual gestures, advanced at each tick so that the auto mode or the switchboard aborts them
+        // (one rotation gesture at a time, none while rotating)
+        const bool rotation_enabled{!AUTO && SWITCHBOARD_STATUS && manual_rotation == ManualRotation::Idle};
+        const bool start_cw{advanceGesture(gesture_cw, rotation_enabled && gesture_ccw.state == GestureState::Idle)};
+        const bool start_ccw{advanceGesture(gesture_ccw, rotation_enabled && gesture_cw.state == GestureState::Idle)};
+        const bool ignite{advanceGesture(gesture_ignition, !AUTO && !SWITCHBOARD_STATUS)};
+
         // AUTO
         if (AUTO) {
             // enable automatic services
             if (!manual_reset_needed) manual_reset_needed = manualToAuto();
 
-            // AC handle, if dome has no electricity from the main grid, after ~1sec (error_AC_counter >= 10),
-            // close the shutter and shutdown. If not, reset the counter and stop the procedure, if needed
+            // AC handle, if dome has no electricity from the main grid, after AC_LOSS_TIME,
+            // close the shutter and shutdown. If not, reset the timer and stop the procedure, if needed
             if (!AC_PRESENCE) {
-                ++error_AC_counter;
-                if (!error_AC_flag && error_AC_counter >= 10) {
+                if (error_AC_time == 0) error_AC_time = max(millis(), 1ul);
+                if (!error_AC_flag && millis() - error_AC_time >= AC_LOSS_TIME) {
                     // TODO put your AC emergency start procedure, example:
                     /* error_AC_flag = httpRequest(BABELE_IP_ADDRESS, R"(/api?json={"cmd":"shutdown"})", 8002).code == 200; */
                     error_AC_flag = true;
@@ -138,19 +200,21 @@ void loop() {
                     /* error_AC_flag = !httpRequest(BABELE_IP_ADDRESS, R"(/api?json={"cmd":"abort"})", 8002).code == 200; */
                     error_AC_flag = false;
                 }
-                if (error_AC_counter > 0) error_AC_counter = 0;
+                error_AC_time = 0;
             }
 
-            // handle motion
-            if (MOVEMENT_STATUS) {
-                logMessage("loop", "Update dome position");
-                current_az = domePosition();
-                int delta_position{abs(current_az - target_az)};
-                delta_position = delta_position < 180 ? delta_position : abs(360 - delta_position);
-                if (delta_position < 2) stopSlewing();
+            // handle motion (the find-zero motion is handled above)
+            const bool searching_zero{findZeroStatus().searching};
+            if (MOVEMENT_STATUS && !searching_zero) {
+                /* Cut the relays off in advance by the predicted coast, so the dome
+                 * settles on the target. The estimated azimuth is continuous between
+                 * two encoder readings; a negative remaining path means overshoot. */
+                const int direction{IS_MOVING_CW ? 1 : -1};
+                const float remaining{direction * azimuthDifference(target_az, domeAzimuth())};
+                if (remaining < predictedCoast(direction) + COAST_CUTOFF_TOLERANCE) stopSlewing(true);
             }
-            // handle status_finding_zero
-            else if (status_finding_zero) {
+            // handle status_finding_zero, starting the procedure
+            else if (status_finding_zero && !searching_zero) {
                 logMessage("loop", "Finding zero");
                 status_finding_park = false;
                 target_az = -1;
@@ -159,9 +223,7 @@ void loop() {
                     EEPROM.writeBool(EEPROM_PARK_STATE_ADDRESS, status_park);
                     EEPROM.commit();
                 }
-                xSemaphoreGive(xSemaphore);
-                findZero();
-                xSemaphoreTake(xSemaphore, portMAX_DELAY);
+                startFindZero();
             }
         }
 
@@ -170,9 +232,8 @@ void loop() {
             // disable automatic services
             if (manual_reset_needed) manual_reset_needed = !autoToManual();
 
-            // reset motion
-            /* since motion is blocking, here it's ok */
-            if (MOVEMENT_STATUS) {
+            // reset motion, except the manual rotation
+            if (MOVEMENT_STATUS && manual_rotation == ManualRotation::Idle) {
                 logMessage("loop", "Dome moving in manual mode, turning off relays");
                 stopSlewing();
             }
@@ -198,32 +259,24 @@ void loop() {
                 status_finding_zero = false;
             }
 
-            // move clockwise
-            if (SWITCHBOARD_STATUS && buttonPressed(MAN_CW_O, TIME_BUTTON)) {
+            // move clockwise, until the button release (handled at each tick above)
+            if (start_cw) {
                 logMessage("loop", "Start clockwise motion");
+                startTrajectory(TrajectoryType::Manual);
                 startMotion(DomeDirection::CW);  // startSlewing requires target azimuth, so use startMotion
-                do {
-                    delay(100);
-                    current_az = domePosition();
-                } while (MAN_CW && SWITCHBOARD_STATUS);
-                stopSlewing();  // stopMotion only stops relays, so use stopSlewing to also save states
-                logMessage("loop", "End clockwise motion");
+                manual_rotation = ManualRotation::CW;
             }
 
-            // move anticlockwise
-            else if (SWITCHBOARD_STATUS && buttonPressed(MAN_CCW_O, TIME_BUTTON)) {
+            // move anticlockwise, until the button release (handled at each tick above)
+            else if (start_ccw) {
                 logMessage("loop", "Start counterclockwise motion");
+                startTrajectory(TrajectoryType::Manual);
                 startMotion(DomeDirection::CCW);  // startSlewing requires target azimuth, so use startMotion
-                do {
-                    delay(100);
-                    current_az = domePosition();
-                } while (MAN_CCW && SWITCHBOARD_STATUS);
-                stopSlewing();  // stopMotion only stops relays, so use stopSlewing to also save states
-                logMessage("loop", "End counterclockwise motion");
+                manual_rotation = ManualRotation::CCW;
             }
 
             // ignite switchboard
-            else if (!SWITCHBOARD_STATUS && buttonPressed(MAN_IGNITION_O, TIME_SIREN)) {
+            else if (ignite) {
                 logMessage("loop", "Ignite switchboard");
                 switchboardIgnition();
                 status_switchboard_ignited = true;
@@ -240,12 +293,69 @@ void loop() {
             status_switchboard_ignited = false;
         }
 
+        // status snapshot for the web server, with the values of this tick
+        publishStatusRecord();
+
         xSemaphoreGive(xSemaphore);
     }
 }
 
 //////////
 
+void encoder_task(void* _parameter) {
+    EncoderError last_error{EncoderError::None};
+    int last_azimuth{encoderSample().azimuth};
+    TickType_t last_poll{xTaskGetTickCount()};
+
+    for (;;) {
+        // emergency transactions first
+        if (processSerial485(RS485Priority::Emergency)) continue;
+
+        // find-zero response arrived while idle
+        if (processZeroSerial485()) continue;
+
+        /* Periodic (or requested) position reading, executed as motion-feedback
+         * transaction so it is never delayed by config and siren transactions. It
+         * is suspended until the initial position is written to the encoder and
+         * while the siren is playing; during the find-zero procedure it goes on,
+         * and the late find-zero response is picked out of the position ones. */
+        const bool polling{encoder_polling_enabled && !siren_playing};
+        // faster readings when a slew is approaching its target
+        const TickType_t poll_interval{encoderPollInterval()};
+        if (!polling || (!encoder_poll_requested && xTaskGetTickCount() - last_poll < poll_interval)) {
+            // other transactions, by priority; during the find-zero procedure the config ones wait, since their
+            // responses could be confused with the zero response
+            if (processSerial485(RS485Priority::MotionFeedback)) continue;
+            if (!zeroExpectedSerial485() && processSerial485(RS485Priority::Config)) continue;
+            if (processSerial485(RS485Priority::Siren)) continue;
+            // nothing to do: wait for the next reading, or for new transactions and reading requests
+            const TickType_t elapsed{xTaskGetTickCount() - last_poll};
+            ulTaskNotifyTake(pdTRUE, (polling && elapsed < poll_interval) ? poll_interval - elapsed : ENCODER_POLL_INTERVAL);
+            continue;
+        }
+        encoder_poll_requested = false;
+        last_poll = xTaskGetTickCount();
+
+        // read and publish, logging only changes to avoid flooding the log
+        const unsigned long start_time{micros()};
+        const int position{domePosition(false)};
+        const unsigned long latency_us{micros() - start_time};
+        publishEncoderSample(position);
+        recordTrajectorySample(position, latency_us);
+        const EncoderSample sample{encoderSample()};
+        if (sample.error != last_error) {
+            logMessage("encoder_task", sample.error == EncoderError::None ? String{"Encoder reading restored"} : (String{"Encoder reading error "} + static_cast<int>(sample.error)));
+            last_error = sample.error;
+        }
+        if (sample.azimuth != last_azimuth) {
+            logMessage("encoder_task", String{"Dome position: "} + sample.azimuth);
+            last_azimuth = sample.azimuth;
+        }
+    }
+}
+
+//////////
+
 void net_task(void* _parameter) {
     for (;;) {
         delay(100);
@@ -267,3 +377,13 @@ void net_task(void* _parameter) {
         }
     }
 }
+
+//////////
+
+void status_task(void* _parameter) {
+    for (;;) {
+        // woken by the loop at each new status version, or at the heartbeat interval
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STATUS_SSE_HEARTBEAT));
+        pushStatusEvents();
+    }
+}
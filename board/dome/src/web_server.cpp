@@ -28,82 +28,1024 @@ SOFTWARE.
 */
 
 #include "global_definitions.hpp"
+// generated by web_assets.py in the build directory
+#include "web_assets_bundle.h"
 
 //////////
 
 /**
- * @brief Return true if unknown client IP, else false; used for web auth.
+ * @brief Submit an operation to the command queue, and set the API response: "done" and the operation id, or the
+ * error if the queue is full.
  */
-bool unknown_IP(const String &clientIP) {
-    return clientIP != "authorized_ip_1" &&  // TODO put your authorized IP address here
-           clientIP != "authorized_ip_2";    // TODO put your authorized IP address here
+void queueOperation(JsonDocument &_json, const OperationType _type, const int _target = -1) {
+    const uint32_t id{submitOperation(_type, _target)};
+    if (id == 0) {
+        _json["rsp"] = "Error: command queue full";
+    } else {
+        _json["rsp"] = "done";
+        _json["op-id"] = id;
+    }
 }
 
 //////////
 
-#define JSON_S_SIZE 1024
+/**
+ * @brief Return the web asset of an url, or nullptr if not found.
+ */
+const WebAsset *findWebAsset(const char *_url) {
+    const WebAsset &asset{web_assets[fnv1aHash(_url, WEB_ASSETS_SEED) >> (32 - WEB_ASSETS_SLOT_BITS)]};
+    return asset.url != nullptr && strcmp(asset.url, _url) == 0 ? &asset : nullptr;
+}
+
+/**
+ * @brief Send a web asset, gzipped, straight from flash: the immutable ones are cached for a year, the others are
+ * revalidated with their ETag (304 if not modified). A not empty _set_cookie is added as Set-Cookie header.
+ */
+void sendWebAsset(AsyncWebServerRequest *request, const WebAsset &_asset, const char *_set_cookie = "") {
+    if (!_asset.immutable && request->hasHeader("If-None-Match") && request->header("If-None-Match") == _asset.etag) {
+        AsyncWebServerResponse *response{request->beginResponse(304)};
+        response->addHeader("ETag", _asset.etag);
+        if (*_set_cookie != 0) response->addHeader("Set-Cookie", _set_cookie);
+        request->send(response);
+    } else {
+        AsyncWebServerResponse *response{request->beginResponse_P(200, _asset.type, _asset.data, _asset.length)};
+        response->addHeader("Content-Encoding", "gzip");
+        if (_asset.immutable) {
+            response->addHeader("Cache-Control", WEB_ASSETS_CACHE_CONTROL);
+        } else {
+            response->addHeader("Cache-Control", "no-cache");
+            response->addHeader("ETag", _asset.etag);
+        }
+        if (*_set_cookie != 0) response->addHeader("Set-Cookie", _set_cookie);
+        request->send(response);
+    }
+    logMessage("ESPAsyncWebServer", request->url(), "");
+}
+
+//////////
+
+// trusted address ranges, network and mask in the IPAddress representation (set only by the async tcp task)
+struct WebAllowlistEntry {
+    uint32_t network;
+    uint32_t mask;
+};
+WebAllowlistEntry web_allowlist[WEB_ALLOWLIST_SIZE]{};
+int web_allowlist_size{};
+// key of the session tokens, drawn at boot (the tokens do not survive a restart)
+uint8_t web_session_key[32]{};
+
+/**
+ * @brief Parse an IPv4 CIDR range ("a.b.c.d/n", or "a.b.c.d" for a single address), return false if not valid (/0,
+ * every address, is not valid).
+ */
+bool parseCIDR(const char *_cidr, WebAllowlistEntry &_entry) {
+    const char *slash{strchr(_cidr, '/')};
+    const int prefix{slash == nullptr ? 32 : atoi(slash + 1)};
+    IPAddress address{};
+    if (!address.fromString(slash == nullptr ? String{_cidr} : String{_cidr}.substring(0, slash - _cidr)) || prefix < 1 || prefix > 32) return false;
+    const uint32_t mask{0xFFFFFFFFu << (32 - prefix)};
+    _entry.mask = static_cast<uint32_t>(IPAddress(mask >> 24, mask >> 16 & 0xFF, mask >> 8 & 0xFF, mask & 0xFF));
+    _entry.network = static_cast<uint32_t>(address) & _entry.mask;
+    return true;
+}
+
+/**
+ * @brief Write a CIDR range in _cidr (at least 19 characters).
+ */
+void formatCIDR(const WebAllowlistEntry &_entry, char *_cidr) {
+    const IPAddress address{_entry.network}, mask{_entry.mask};
+    int prefix{};
+    for (int i{}; i < 4; ++i) prefix += __builtin_popcount(mask[i]);
+    snprintf(_cidr, 19, "%u.%u.%u.%u/%d", address[0], address[1], address[2], address[3], prefix);
+}
+
+/**
+ * @brief Load the allowlist from NVS, or the default one if never set.
+ */
+void loadWebAllowlist() {
+    Preferences preferences{};
+    preferences.begin("web-auth", true);
+    const size_t length{preferences.getBytesLength("allowlist")};
+    if (length != 0 && length <= sizeof(web_allowlist) && length % sizeof(WebAllowlistEntry) == 0) {
+        web_allowlist_size = preferences.getBytes("allowlist", web_allowlist, length) / sizeof(WebAllowlistEntry);
+    } else {
+        web_allowlist_size = 0;
+        for (const char *cidr : WEB_ALLOWLIST_DEFAULT)
+            if (web_allowlist_size < WEB_ALLOWLIST_SIZE && parseCIDR(cidr, web_allowlist[web_allowlist_size])) ++web_allowlist_size;
+    }
+    preferences.end();
+    logMessage("loadWebAllowlist", String{web_allowlist_size} + " address ranges");
+}
+
+/**
+ * @brief Save the allowlist in NVS.
+ */
+void saveWebAllowlist() {
+    Preferences preferences{};
+    preferences.begin("web-auth", false);
+    preferences.putBytes("allowlist", web_allowlist, web_allowlist_size * sizeof(WebAllowlistEntry));
+    preferences.end();
+}
+
+/**
+ * @brief HMAC-SHA256 of a session token (expiry time and client address).
+ */
+void webSessionMAC(const uint32_t _expiry, const uint32_t _address, uint8_t (&_mac)[32]) {
+    const uint32_t message[2]{_expiry, _address};
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), web_session_key, sizeof(web_session_key), reinterpret_cast<const uint8_t *>(message), sizeof(message), _mac);
+}
+
+/**
+ * @brief Return true if the request has a valid session token for its client address, in the session cookie
+ * ("<expiry, 8 hex digits><first 16 bytes of the MAC, 32 hex digits>").
+ */
+bool validWebSession(AsyncWebServerRequest *request, const uint32_t _address) {
+    if (!request->hasHeader("Cookie")) return false;
+    // the cookie name only at the start of the header or after "; " (not e.g. in "xsession=")
+    const char *token{request->getHeader("Cookie")->value().c_str()};
+    while (token != nullptr && strncmp(token, WEB_SESSION_COOKIE "=", sizeof(WEB_SESSION_COOKIE)) != 0) {
+        token = strstr(token, "; ");
+        if (token != nullptr) token += 2;
+    }
+    if (token == nullptr) return false;
+    token += sizeof(WEB_SESSION_COOKIE);
+    uint8_t bytes[20]{};
+    for (int i{}; i < 40; ++i) {
+        const char c{token[i]};
+        const int nibble{c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1};
+        if (nibble < 0) return false;
+        bytes[i / 2] = bytes[i / 2] << 4 | nibble;
+    }
+    const uint32_t expiry{static_cast<uint32_t>(bytes[0]) << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3]};
+    if (static_cast<uint32_t>(esp_timer_get_time() / 1000000) >= expiry) return false;
+    uint8_t mac[32]{};
+    webSessionMAC(expiry, _address, mac);
+    // constant time comparison
+    uint8_t difference{};
+    for (int i{}; i < 16; ++i) difference |= mac[i] ^ bytes[4 + i];
+    return difference == 0;
+}
+
+/**
+ * @brief Authenticate a web page request: the client address is in the allowlist, or the request has a valid session
+ * token, or valid Basic auth credentials, that start a new session (its Set-Cookie header is written in _set_cookie,
+ * else left empty). Return false if the client must authenticate.
+ */
+bool authenticateWebRequest(AsyncWebServerRequest *request, char (&_set_cookie)[WEB_SESSION_SET_COOKIE_SIZE]) {
+    const uint32_t address{static_cast<uint32_t>(request->client()->remoteIP())};
+    for (int i{}; i < web_allowlist_size; ++i)
+        if ((address & web_allowlist[i].mask) == web_allowlist[i].network) return true;
+    if (validWebSession(request, address)) return true;
+    if (!request->authenticate(WEBPAGE_LOGIN_USER, WEBPAGE_LOGIN_PASSWORD)) return false;
+
+    const uint32_t expiry{static_cast<uint32_t>(esp_timer_get_time() / 1000000) + WEB_SESSION_DURATION};
+    uint8_t mac[32]{};
+    webSessionMAC(expiry, address, mac);
+    int length{snprintf(_set_cookie, WEB_SESSION_SET_COOKIE_SIZE, WEB_SESSION_COOKIE "=%08x", static_cast<unsigned>(expiry))};
+    for (int i{}; i < 16; ++i) length += snprintf(_set_cookie + length, WEB_SESSION_SET_COOKIE_SIZE - length, "%02x", mac[i]);
+    snprintf(_set_cookie + length, WEB_SESSION_SET_COOKIE_SIZE - length, "; Max-Age=%d; Path=/; HttpOnly; SameSite=Strict", WEB_SESSION_DURATION);
+    return true;
+}
+
+//////////
+
+// request buckets of the clients, in thousandths of token (used only by the async tcp task, so no mutex)
+struct WebRateClient {
+    uint32_t address;  // 0 if empty slot
+    uint32_t time;     // last refill, in milliseconds
+    uint32_t tokens[WEB_RATE_CONTROL + 1];
+    uint32_t rejected;
+};
+struct WebRateLimit {
+    uint32_t rate;
+    uint32_t burst;
+};
+constexpr WebRateLimit web_rate_limits[] WEB_RATE_LIMITS;
+static_assert(sizeof(web_rate_limits) / sizeof(web_rate_limits[0]) == WEB_RATE_CONTROL + 1, "WEB_RATE_LIMITS needs a bucket per class");
+WebRateClient web_rate_clients[WEB_RATE_CLIENTS]{};
+// admission counters, see the server-limits command
+int web_requests_in_flight{};
+int web_requests_in_flight_max{};
+uint32_t web_requests_busy{};
+uint32_t web_requests_limited[WEB_RATE_CONTROL + 1]{};
+// bodies of the rejections, in flash (read after admitWebRequest returns)
+static const char web_response_busy[] PROGMEM{R"({"rsp":"Error: server busy"})"};
+static const char web_response_limited[] PROGMEM{R"({"rsp":"Error: too many requests"})"};
+
+/**
+ * @brief Admission control of a request: answer 503 if too many requests are in flight, or 429 if the client has no
+ * tokens left for the class of the request, and return false; else count the request in flight until its
+ * disconnection, and return true.
+ */
+bool admitWebRequest(AsyncWebServerRequest *request, const WebRateClass _class) {
+    /* The rejections are not logged, under a flood the log would cost more
+     * than the answer: they are only counted (server-limits command). */
+    if (web_requests_in_flight >= WEB_REQUESTS_IN_FLIGHT) {
+        ++web_requests_busy;
+        AsyncWebServerResponse *response_busy{request->beginResponse_P(503, "application/json", web_response_busy)};
+        response_busy->addHeader("Retry-After", "1");
+        request->send(response_busy);
+        return false;
+    }
+
+    // bucket of the client, or the least recently used one
+    const uint32_t address{static_cast<uint32_t>(request->client()->remoteIP())};
+    const uint32_t now{static_cast<uint32_t>(millis())};
+    WebRateClient *client{&web_rate_clients[0]};
+    for (WebRateClient &i : web_rate_clients) {
+        if (i.address == address) {
+            client = &i;
+            break;
+        }
+        if (now - i.time > now - client->time) client = &i;
+    }
+    if (client->address != address) {
+        *client = WebRateClient{address, now};
+        for (int i{}; i <= WEB_RATE_CONTROL; ++i) client->tokens[i] = web_rate_limits[i].burst * 1000;
+    } else {
+        // one minute is enough to fill any bucket, and avoids overflows
+        const uint32_t elapsed{std::min(now - client->time, static_cast<uint32_t>(60000))};
+        for (int i{}; i <= WEB_RATE_CONTROL; ++i) client->tokens[i] = std::min(client->tokens[i] + elapsed * web_rate_limits[i].rate, web_rate_limits[i].burst * 1000);
+        client->time = now;
+    }
+
+    if (client->tokens[_class] < 1000) {
+        ++client->rejected;
+        ++web_requests_limited[_class];
+        AsyncWebServerResponse *response_limited{request->beginResponse_P(429, "application/json", web_response_limited)};
+        response_limited->addHeader("Retry-After", "1");  // refill of at least one token per second
+        request->send(response_limited);
+        return false;
+    }
+    client->tokens[_class] -= 1000;
+    web_requests_in_flight_max = std::max(++web_requests_in_flight, web_requests_in_flight_max);
+    request->onDisconnect([]() { --web_requests_in_flight; });
+    return true;
+}
+
+//////////
+
+#define JSON_S_SIZE 1696
 // status json, allocated in global stack
 StaticJsonDocument<JSON_S_SIZE> json_status{};
-// status string for json_status serialization
-String response_status{};
-// semaphore for status json, to avoid too much allocations
+/* Serialized status of the last StatusRecord version. It is never modified,
+ * but replaced at the next version: the responses still being sent keep their
+ * own reference. */
+std::shared_ptr<const String> status_buffer{};
+uint32_t status_buffer_version{};
+// random number drawn at boot, so an ETag is never reused after a restart
+uint32_t status_boot_id{};
+// last status sent to the StatusSSE clients (nullptr if no client), and its json to compute the deltas
+std::shared_ptr<const String> status_sse_buffer{};
+uint32_t status_sse_version{};
+StaticJsonDocument<JSON_S_SIZE> json_status_sse{};
+unsigned long status_sse_time{};
+// delta json, allocated in global stack
+StaticJsonDocument<JSON_S_SIZE> json_status_delta{};
+// semaphore for the status buffers and jsons, shared by the web server and the status task
 SemaphoreHandle_t xSemaphore_status{xSemaphoreCreateMutex()};
 
+// pending status-wait requests, counted by a StatusWaiter held by their response (deleted also at disconnection)
+int status_waiters{};
+struct StatusWaiter {
+    StatusWaiter() { ++status_waiters; }
+    ~StatusWaiter() { --status_waiters; }
+};
+
+/**
+ * @brief Get the serialized status, serializing the StatusRecord only if its version changed. To be called with
+ * xSemaphore_status taken.
+ */
+std::shared_ptr<const String> statusBuffer(uint32_t &_version) {
+    const StatusRecord record{statusRecord()};
+    _version = record.version;
+    if (status_buffer && status_buffer_version == record.version) return status_buffer;
+
+    const StatusValues &values{record.values};
+    const auto relay{[&values](const Relay _relay) { return (values.relays >> static_cast<int>(_relay) & 1) == 1; }};
+    const auto optoin{[&values](const OptoInC _optoin) { return (values.optoins >> customOptoIn.getNumber(_optoin) & 1) == 1; }};
+    json_status.clear();
+    json_status["rsp"]["firmware-version"] = FIRMWARE_VERSION;
+    json_status["rsp"]["uptime"] = uptime_formatter::getUptime();
+    json_status["rsp"]["dome-azimuth"] = serialized(String{values.dome_azimuth / 10.0f, 1});
+    json_status["rsp"]["target-azimuth"] = values.target_azimuth;
+    json_status["rsp"]["movement-status"] = relay(CW_MOTOR) || relay(CCW_MOTOR);
+    json_status["rsp"]["in-park"] = values.in_park;
+    json_status["rsp"]["finding-park"] = values.finding_park;
+    json_status["rsp"]["finding-zero"] = values.finding_zero;
+    json_status["rsp"]["find-zero"]["travelled"] = serialized(String{values.find_zero_travelled / 10.0f, 1});
+    json_status["rsp"]["find-zero"]["eta"] = values.find_zero_eta;
+    for (int i{}; i < 4; ++i) json_status["rsp"]["relay"]["list"][i] = (values.relays >> i & 1) == 1;
+    json_status["rsp"]["relay"]["cw-motor"] = relay(CW_MOTOR);
+    json_status["rsp"]["relay"]["ccw-motor"] = relay(CCW_MOTOR);
+    json_status["rsp"]["relay"]["switchboard"] = relay(SWITCHBOARD);
+    for (int i{}; i < 8; ++i) json_status["rsp"]["optoin"]["list"][i] = (values.optoins >> i & 1) == 1;
+    json_status["rsp"]["optoin"]["auto"] = optoin(AUTO_O);
+    json_status["rsp"]["optoin"]["switchboard-status"] = optoin(SWITCHBOARD_STATUS_O);
+    json_status["rsp"]["optoin"]["ac-presence"] = optoin(AC_PRESENCE_O);
+    json_status["rsp"]["optoin"]["manual-cw-button"] = optoin(MAN_CW_O);
+    json_status["rsp"]["optoin"]["manual-ccw-button"] = optoin(MAN_CCW_O);
+    json_status["rsp"]["optoin"]["manual-ignition"] = optoin(MAN_IGNITION_O);
+    json_status["rsp"]["encoder"]["error"] = static_cast<int>(values.encoder_error);
+    json_status["rsp"]["encoder"]["age"] = record.time - record.encoder_time;
+    json_status["rsp"]["encoder"]["velocity-cw"] = serialized(String{values.velocity_cw / 100.0f, 2});
+    json_status["rsp"]["encoder"]["velocity-ccw"] = serialized(String{values.velocity_ccw / 100.0f, 2});
+    json_status["rsp"]["encoder"]["outliers"] = values.outliers;
+    json_status["rsp"]["io-image"]["age"] = record.time - record.image_time;
+    json_status["rsp"]["io-image"]["spi-per-tick"] = values.spi_per_tick;
+    json_status["rsp"]["io-image"]["spi-per-tick-max"] = values.spi_per_tick_max;
+    json_status["rsp"]["input-latency"]["last-us"] = values.latency_last_us;
+    json_status["rsp"]["input-latency"]["max-us"] = values.latency_max_us;
+    json_status["rsp"]["input-latency"]["reactions"] = values.reactions;
+    json_status["rsp"]["wifi"]["hostname"] = HOSTNAME;
+    json_status["rsp"]["wifi"]["mac-address"] = WiFi.macAddress();
+    json_status["rsp"]["version"] = record.version;
+
+    String buffer{};
+    buffer.reserve(JSON_S_SIZE);
+    serializeJson(json_status, buffer);
+    status_buffer = std::make_shared<const String>(std::move(buffer));
+    status_buffer_version = record.version;
+    return status_buffer;
+}
+
+/**
+ * @brief Weak ETag of a status version.
+ */
+String statusETag(const uint32_t _version) {
+    char etag[24];
+    snprintf(etag, sizeof(etag), "W/\"%08x-%u\"", status_boot_id, _version);
+    return etag;
+}
+
+/**
+ * @brief Add to _delta the fields of _current that differ from _previous, with the same nesting (the arrays are
+ * added whole). The keys are linked, not copied: all the status keys are string literals.
+ */
+void statusDelta(JsonObjectConst _previous, JsonObjectConst _current, JsonObject _delta) {
+    for (JsonPairConst field : _current) {
+        const char *key{field.key().c_str()};
+        const JsonVariantConst previous{_previous[key]};
+        if (field.value().is<JsonObjectConst>() && previous.is<JsonObjectConst>()) {
+            JsonObject nested{_delta.createNestedObject(key)};
+            statusDelta(previous.as<JsonObjectConst>(), field.value().as<JsonObjectConst>(), nested);
+            if (nested.size() == 0) _delta.remove(key);
+        } else if (field.value() != previous) {
+            _delta[key] = field.value();
+        }
+    }
+}
+
+void pushStatusEvents() {
+    if (xSemaphoreTake(xSemaphore_status, pdMS_TO_TICKS(50)) != pdTRUE) return;
+    if (StatusSSE.count() == 0) {
+        // nothing to serialize without clients, the next one starts from a new snapshot
+        status_sse_buffer.reset();
+    } else if (status_sse_buffer) {
+        uint32_t version{};
+        const std::shared_ptr<const String> buffer{statusBuffer(version)};
+        if (version != status_sse_version) {
+            json_status_delta.clear();
+            statusDelta(json_status_sse.as<JsonObjectConst>(), json_status.as<JsonObjectConst>(), json_status_delta.to<JsonObject>());
+            String delta{};
+            serializeJson(json_status_delta, delta);
+            StatusSSE.send(delta.c_str(), "delta", version);
+            status_sse_buffer = buffer;
+            status_sse_version = version;
+            json_status_sse = json_status;
+            status_sse_time = millis();
+        } else if (millis() - status_sse_time >= STATUS_SSE_HEARTBEAT) {
+            StatusSSE.send(String{version}.c_str(), "heartbeat", version);
+            status_sse_time = millis();
+        }
+    }
+    xSemaphoreGive(xSemaphore_status);
+}
+
 // variable for disabling webserver logging
 bool webserver_logging{false};
 
 //////////
 
-void startWebServer() {
-    /////////////
-    // WEBPAGES
+// dispatch statistics of a command, only accessed by the async tcp task
+struct ApiCommandStats {
+    uint32_t calls;
+    uint64_t total_us;
+    uint32_t max_us;
+};
 
-    WebServer.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (unknown_IP(request->client()->remoteIP().toString()) && !request->authenticate(WEBPAGE_LOGIN_USER, WEBPAGE_LOGIN_PASSWORD))
-            return request->requestAuthentication();
-        request->send(SPIFFS, "/dashboard.html", "text/html");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+/* dome-related functions */
 
-    WebServer.on("/log", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (unknown_IP(request->client()->remoteIP().toString()) && !request->authenticate(WEBPAGE_LOGIN_USER, WEBPAGE_LOGIN_PASSWORD))
-            return request->requestAuthentication();
-        request->send(SPIFFS, "/log.html", "text/html");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiAbort(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    queueOperation(json, OperationType::Abort);
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    // css
+void apiSlewToAz(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    const int new_target_az{json["az-target"].as<int>()};
+    json.clear();
+    if (new_target_az < 0 || new_target_az > 360) {
+        json["rsp"] = "Error: target out of bound";
+    } else {
+        queueOperation(json, OperationType::SlewToAz, new_target_az);
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    WebServer.on("/css/style.css", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/css/style.css", "text/css");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiPark(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    queueOperation(json, OperationType::Park);
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    WebServer.on("/css/sa2.min.css", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/css/sa2.min.css", "text/css");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiFindZero(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    queueOperation(json, OperationType::FindZero);
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    // js
+void apiSlewStats(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    DynamicJsonDocument json_stats{768};
+    const CoastStatus status{coastStatus()};
+    const char *directions[]{"cw", "ccw"};
+    for (int i{}; i < 2; ++i) {
+        JsonObject json_direction{json_stats["rsp"].createNestedObject(directions[i])};
+        json_direction["coast"] = serialized(String{status.coast[i], 2});
+        json_direction["coast-samples"] = status.samples[i];
+        const SlewResidualStats &residual{status.residual[i]};
+        json_direction["slews"] = residual.count;
+        json_direction["mean-error"] = serialized(String{residual.count == 0 ? 0.0f : residual.sum / residual.count, 2});
+        json_direction["mean-abs-error"] = serialized(String{residual.count == 0 ? 0.0f : residual.sum_abs / residual.count, 2});
+        json_direction["max-abs-error"] = serialized(String{residual.max_abs, 2});
+    }
+    json_stats["rsp"]["since-reset"] = millis() - status.residual_reset_time;
+    serializeJson(json_stats, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    WebServer.on("/js/dashboard.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/js/dashboard.js", "text/javascript");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiSlewStatsReset(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    resetSlewStatistics();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    WebServer.on("/js/log.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/js/log.js", "text/javascript");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiOpStatus(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    const uint32_t id{json["op-id"].as<uint32_t>()};
+    StaticJsonDocument<320> json_op{};
+    DomeOperation operation{};
+    if (!operationStatus(id, operation)) {
+        json_op["rsp"] = "Error: unknown operation";
+    } else {
+        const char *states[]{"queued", "running", "done", "failed"};
+        const unsigned long now{millis()};
+        json_op["rsp"]["op-id"] = operation.id;
+        json_op["rsp"]["cmd"] = operationName(operation.type);
+        json_op["rsp"]["state"] = states[static_cast<int>(operation.state)];
+        if (operation.type == OperationType::SlewToAz) {
+            json_op["rsp"]["az-target"] = operation.target;
+            json_op["rsp"]["collapsed"] = operation.collapsed;
+        }
+        if (operation.error != nullptr) json_op["rsp"]["error"] = operation.error;
+        // timings, in milliseconds
+        json_op["rsp"]["queued-ms"] = (operation.start_time != 0 ? operation.start_time : operation.end_time != 0 ? operation.end_time : now) - operation.submit_time;
+        json_op["rsp"]["running-ms"] = operation.start_time == 0 ? 0 : (operation.end_time != 0 ? operation.end_time : now) - operation.start_time;
+        json_op["rsp"]["age-ms"] = now - operation.submit_time;
+    }
+    serializeJson(json_op, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+/* encoder-related functions */
+
+/**
+ * @brief Answer with the result of an RS485 transaction, without blocking the async tcp task: as in status-wait, the
+ * response is a chunked one whose filler answers RESPONSE_TRY_AGAIN until the transaction is executed, then sends
+ * the json given by _format.
+ */
+void sendSerial485Response(AsyncWebServerRequest *request, const String &command, RS485Future &&_future, String (*_format)(const RS485Result, std::vector<byte> &)) {
+    const std::shared_ptr<RS485Future> future{std::make_shared<RS485Future>(std::move(_future))};
+    const String url{request->url()};
+    std::shared_ptr<const String> buffer{};
+    AsyncWebServerResponse *response{request->beginChunkedResponse("application/json", [future, _format, url, command, buffer](uint8_t *_data, size_t _max_len, size_t _index) mutable -> size_t {
+        if (!buffer) {
+            RS485Result result{};
+            std::vector<byte> frame{};
+            if (!future->poll(result, &frame)) return RESPONSE_TRY_AGAIN;
+            buffer = std::make_shared<const String>(_format(result, frame));
+            logMessage("ESPAsyncWebServer", url, command + ": " + *buffer);
+        }
+        const size_t length{std::min(_max_len, buffer->length() - _index)};
+        memcpy(_data, buffer->c_str() + _index, length);
+        return length;
+    })};
+    response->addHeader("Cache-Control", "no-store");
+    request->send(response);
+}
+
+// json of a transaction without response data
+String formatSerial485Result(const RS485Result _result, std::vector<byte> &_frame) {
+    String response{};
+    StaticJsonDocument<64> json{};
+    json["rsp"] = resultDescriptionSerial485(_result);
+    serializeJson(json, response);
+    return response;
+}
+
+// json of the encoder configuration, decoded and validated
+String formatEncoderConfig(const RS485Result _result, std::vector<byte> &_config) {
+    if (_result != RS485Result::Done) return formatSerial485Result(_result, _config);
+    String response{};
+    StaticJsonDocument<384> json_conf{};
+    for (int i{}; i < _config.size(); ++i) json_conf["bytes"][i] = _config[i];
+    json_conf["decoded data"]["steps / degree"] = static_cast<int>(_config[0]);
+    json_conf["decoded data"]["steps / dome revolution"] = static_cast<int>(_config[2] | _config[1] << 8);
+    json_conf["decoded data"]["zero azimuth"] = static_cast<int>(_config[4] | _config[3] << 8);
+    json_conf["decoded data"]["zero offset steps"] = static_cast<int>(_config[6] | _config[5] << 8);
+    json_conf["decoded data"]["checksum"] = static_cast<int>(_config[7]);
+    const byte received_checksum{_config.back()};
+    _config.pop_back();
+    byte checksum{};
+    for (auto i : _config) checksum += i;
+    checksum = ~checksum + 1;
+    json_conf["validation"] = received_checksum == checksum;
+    if (received_checksum != checksum) incrementStatsSerial485(RS485StatsCounter::ChecksumError);
+    serializeJson(json_conf, response);
+    return response;
+}
+
+void apiEncoderReadconf(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    sendSerial485Response(request, command, submitSerial485(static_cast<byte>(0xC1), RS485Priority::Config), formatEncoderConfig);
+}
+
+void apiEncoderWriteconf(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    // check
+    const DynamicJsonDocument json_writeconf{json};
+    const JsonArrayConst encoder_config{json_writeconf["config"].as<JsonArrayConst>()};
+    json.clear();
+    bool config_type_error{false};
+    for (auto i : encoder_config)
+        if (!i.is<byte>()) config_type_error = true;
+    if (config_type_error) {
+        json["rsp"] = "Error: type must be byte (uint8_t)";
+    } else if (encoder_config.size() != 7) {
+        json["rsp"] = "Error: config must be of 7 bytes";
+    } else {
+        byte config[]{
+            static_cast<byte>(0xC0),
+            encoder_config[0].as<byte>(),
+            encoder_config[1].as<byte>(),
+            encoder_config[2].as<byte>(),
+            encoder_config[3].as<byte>(),
+            encoder_config[4].as<byte>(),
+            encoder_config[5].as<byte>(),
+            encoder_config[6].as<byte>(),
+            static_cast<byte>(0)};
+        byte checksum{};
+        for (auto i : config) checksum += i;
+        checksum = ~checksum + 1;
+        config[8] = checksum;
+        return sendSerial485Response(request, command, submitSerial485(config, sizeof(config), RS485Priority::Config), formatSerial485Result);
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiEncoderResetconf(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    sendSerial485Response(request, command, submitSerial485(static_cast<byte>(0x44), RS485Priority::Config), formatSerial485Result);
+}
+
+void apiEncoderDisablezero(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    sendSerial485Response(request, command, submitSerial485(static_cast<byte>(0x23), RS485Priority::Config), formatSerial485Result);
+}
+
+void apiEncoderStats(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    DynamicJsonDocument json_stats{3072};
+    const RS485Stats stats{statsSerial485()};
+    for (auto bound : rs485_stats_bucket_bounds) json_stats["rsp"]["buckets-us"].add(bound);
+    for (auto &command_stats : stats.commands) {
+        char key[5]{};
+        snprintf(key, sizeof(key), "0x%02X", command_stats.command);
+        JsonObject json_command{json_stats["rsp"]["commands"].createNestedObject(key)};
+        json_command["count"] = command_stats.count;
+        json_command["mean-us"] = command_stats.count == 0 ? 0 : static_cast<uint32_t>(command_stats.total_us / command_stats.count);
+        json_command["max-us"] = command_stats.max_us;
+        for (auto i : command_stats.histogram) json_command["histogram"].add(i);
+    }
+    json_stats["rsp"]["timeouts"] = stats.timeouts;
+    json_stats["rsp"]["short-frames"] = stats.short_frames;
+    json_stats["rsp"]["checksum-errors"] = stats.checksum_errors;
+    json_stats["rsp"]["queue-full"] = stats.queue_full;
+    json_stats["rsp"]["deadline-expired"] = stats.deadline_expired;
+    json_stats["rsp"]["since-reset"] = millis() - stats.reset_time;
+    serializeJson(json_stats, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiEncoderStatsReset(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    resetStatsSerial485();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+/* system management */
+
+void apiIgniteSwitchboard(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    queueOperation(json, OperationType::IgniteSwitchboard);
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiResetEEPROM(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    EEPROM.writeBool(EEPROM_INITIALIZED_ADDRESS, false);
+    EEPROM.commit();
+    // the loop semaphore is held until the reboot
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+    SSELogger.close();
+    ESP.restart();
+}
 
-    WebServer.on("/js-external/res.min.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/js-external/res.min.js", "text/javascript");
-        logMessage("ESPAsyncWebServer", request->url(), "");
+void apiRestart(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    queueOperation(json, OperationType::Restart);
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiForceRestart(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command);
+    SSELogger.close();
+    ESP.restart();
+}
+
+void apiTurnOff(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    queueOperation(json, OperationType::TurnOff);
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiServerLoggingToggle(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    webserver_logging = !webserver_logging;
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiServerLoggingStatus(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    json["rsp"] = webserver_logging;
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiServerLimits(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    DynamicJsonDocument json_limits{2048};
+    json_limits["rsp"]["in-flight"] = web_requests_in_flight;
+    json_limits["rsp"]["in-flight-max"] = web_requests_in_flight_max;
+    json_limits["rsp"]["in-flight-limit"] = WEB_REQUESTS_IN_FLIGHT;
+    json_limits["rsp"]["rejected-busy"] = web_requests_busy;
+    for (int i{}; i <= WEB_RATE_CONTROL; ++i) {
+        JsonObject json_class{json_limits["rsp"]["classes"].createNestedObject()};
+        json_class["class"] = web_rate_class_names[i];
+        json_class["rate"] = web_rate_limits[i].rate;
+        json_class["burst"] = web_rate_limits[i].burst;
+        json_class["rejected"] = web_requests_limited[i];
+    }
+    json_limits["rsp"].createNestedArray("clients");
+    for (const WebRateClient &client : web_rate_clients) {
+        if (client.address == 0) continue;
+        JsonObject json_client{json_limits["rsp"]["clients"].createNestedObject()};
+        json_client["ip"] = IPAddress{client.address}.toString();
+        json_client["age"] = millis() - client.time;
+        json_client["rejected"] = client.rejected;
+    }
+    serializeJson(json_limits, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiServerLimitsReset(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    // the in flight requests are still counted
+    web_requests_in_flight_max = web_requests_in_flight;
+    web_requests_busy = 0;
+    for (uint32_t &i : web_requests_limited) i = 0;
+    for (WebRateClient &client : web_rate_clients) client.rejected = 0;
+    json.clear();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+/* web authentication */
+
+void apiAuthAllowlist(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    JsonArray json_allowlist{json.createNestedArray("rsp")};
+    for (int i{}; i < web_allowlist_size; ++i) {
+        char cidr[19]{};
+        formatCIDR(web_allowlist[i], cidr);
+        json_allowlist.add(cidr);
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiAuthAllowlistSet(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    // check, the allowlist is replaced only if all the ranges are valid
+    const JsonArrayConst json_cidr{json["cidr"].as<JsonArrayConst>()};
+    WebAllowlistEntry allowlist[WEB_ALLOWLIST_SIZE]{};
+    bool cidr_error{false};
+    for (int i{}; i < json_cidr.size() && i < WEB_ALLOWLIST_SIZE; ++i)
+        if (!json_cidr[i].is<const char *>() || !parseCIDR(json_cidr[i].as<const char *>(), allowlist[i])) cidr_error = true;
+    const int allowlist_size{static_cast<int>(json_cidr.size())};
+    json.clear();
+    if (allowlist_size > WEB_ALLOWLIST_SIZE) {
+        json["rsp"] = "Error: too many ranges";
+    } else if (cidr_error) {
+        json["rsp"] = "Error: ranges must be IPv4 CIDR strings, from /1 to /32";
+    } else {
+        memcpy(web_allowlist, allowlist, sizeof(web_allowlist));
+        web_allowlist_size = allowlist_size;
+        saveWebAllowlist();
+        json["rsp"] = "done";
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiAuthSessionsRevoke(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    // new key, the issued tokens are no longer valid
+    esp_fill_random(web_session_key, sizeof(web_session_key));
+    json.clear();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiHelp(AsyncWebServerRequest *request, JsonDocument &json, const String &command);
+
+/* status */
+
+void apiStatus(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    /* Served from the snapshot buffer, serialized once per version,
+     * so polling costs nothing while the status does not change. */
+    uint32_t version{};
+    const std::shared_ptr<const String> buffer{statusBuffer(version)};
+    const String etag{statusETag(version)};
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match").indexOf(etag) >= 0) {
+        AsyncWebServerResponse *response_status{request->beginResponse(304)};
+        response_status->addHeader("ETag", etag);
+        request->send(response_status);
+        if (webserver_logging) logMessage("ESPAsyncWebServer", request->url(), command + ": not modified");
+    } else {
+        AsyncWebServerResponse *response_status{request->beginResponse("application/json", buffer->length(), [buffer](uint8_t *_data, size_t _max_len, size_t _index) -> size_t {
+            const size_t length{std::min(_max_len, buffer->length() - _index)};
+            memcpy(_data, buffer->c_str() + _index, length);
+            return length;
+        })};
+        response_status->addHeader("ETag", etag);
+        response_status->addHeader("Cache-Control", "no-cache");
+        request->send(response_status);
+        if (webserver_logging) logMessage("ESPAsyncWebServer", request->url(), command + ": " + *buffer);
+    }
+}
+
+void apiStatusWait(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    /* Long poll: the response is a chunked one whose filler answers
+     * RESPONSE_TRY_AGAIN (polled by the async tcp task about every
+     * 500 ms) until the status values change after the version
+     * given, or the timeout expires. Nothing is blocked meanwhile. */
+    String response{};
+    const uint32_t since{json["version"].as<uint32_t>()};
+    const unsigned long timeout{json.containsKey("timeout") ? std::min(json["timeout"].as<unsigned long>(), static_cast<unsigned long>(STATUS_WAIT_MAX)) : STATUS_WAIT_DEFAULT};
+    json.clear();
+    if (status_waiters >= STATUS_WAIT_REQUESTS) {
+        json["rsp"] = "Error: too many status-wait requests";
+        serializeJson(json, response);
+        request->send(200, "application/json", response);
+        logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+    } else {
+        const std::shared_ptr<StatusWaiter> waiter{std::make_shared<StatusWaiter>()};
+        const unsigned long start_time{millis()};
+        std::shared_ptr<const String> buffer{};
+        AsyncWebServerResponse *response_status{request->beginChunkedResponse("application/json", [waiter, since, timeout, start_time, buffer](uint8_t *_data, size_t _max_len, size_t _index) mutable -> size_t {
+            if (!buffer) {
+                // a version newer than the current one is from before a restart: answer at once
+                const StatusRecord record{statusRecord()};
+                if (record.change_version <= since && since <= record.version && millis() - start_time < timeout) return RESPONSE_TRY_AGAIN;
+                // the async tcp task never waits for the status task
+                if (xSemaphoreTake(xSemaphore_status, 0) != pdTRUE) return RESPONSE_TRY_AGAIN;
+                uint32_t version{};
+                buffer = statusBuffer(version);
+                xSemaphoreGive(xSemaphore_status);
+            }
+            const size_t length{std::min(_max_len, buffer->length() - _index)};
+            memcpy(_data, buffer->c_str() + _index, length);
+            return length;
+        })};
+        response_status->addHeader("Cache-Control", "no-store");
+        request->send(response_status);
+        if (webserver_logging) logMessage("ESPAsyncWebServer", request->url(), command + ": waiting");
+    }
+}
+
+//////////
+
+// command registry, index and argument check (shared with the host benchmark)
+#include "api_commands.hpp"
+
+// max size of an /api/batch request body, in bytes
+#define API_BATCH_BODY_SIZE 512
+
+ApiCommandStats api_command_stats[API_COMMANDS]{};
+
+/**
+ * @brief Return the error of the first precondition not satisfied by a status snapshot, or nullptr.
+ */
+const char *apiPreconditionError(const uint8_t _preconditions, const StatusValues &_state) {
+    const auto relay{[&_state](const Relay _relay) { return (_state.relays >> static_cast<int>(_relay) & 1) == 1; }};
+    const auto optoin{[&_state](const OptoInC _optoin) { return (_state.optoins >> customOptoIn.getNumber(_optoin) & 1) == 1; }};
+    if ((_preconditions & API_AUTO) && !optoin(AUTO_O)) return "Error: dome in manual mode";
+    if ((_preconditions & API_MANUAL) && optoin(AUTO_O)) return "Error: dome in automatic mode";
+    if ((_preconditions & API_AC) && !optoin(AC_PRESENCE_O)) return "Error: no AC";
+    if ((_preconditions & API_SWITCHBOARD) && !optoin(SWITCHBOARD_STATUS_O)) return "Error: switchboard off";
+    if ((_preconditions & API_NOT_MOVING) && (relay(CW_MOTOR) || relay(CCW_MOTOR))) return "Error: dome is moving";
+    if ((_preconditions & API_NOT_FINDING_ZERO) && _state.finding_zero) return "Error: finding zero";
+    if ((_preconditions & API_NOT_PARKING) && _state.finding_park) return "Error: parking";
+    return nullptr;
+}
+
+/**
+ * @brief Take the locks of a command (all or none), return true if successful.
+ */
+bool takeApiLocks(const uint8_t _locks) {
+    if ((_locks & API_LOCK_LOOP) && xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) return false;
+    if ((_locks & API_LOCK_STATUS) && xSemaphoreTake(xSemaphore_status, pdMS_TO_TICKS(50)) != pdTRUE) {
+        if (_locks & API_LOCK_LOOP) xSemaphoreGive(xSemaphore);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Give back the locks of a command.
+ */
+void giveApiLocks(const uint8_t _locks) {
+    if (_locks & API_LOCK_STATUS) xSemaphoreGive(xSemaphore_status);
+    if (_locks & API_LOCK_LOOP) xSemaphoreGive(xSemaphore);
+}
+
+/**
+ * @brief Check a command of a batch against a status snapshot, then update the snapshot with the expected effect of
+ * the command, for the next ones. Return the error, or nullptr.
+ */
+const char *checkBatchCommand(JsonObjectConst _item, StatusValues &_state, OperationType &_type, int &_target) {
+    const ApiCommand *api_command{_item["cmd"].is<const char *>() ? findApiCommand(_item["cmd"].as<const char *>()) : nullptr};
+    if (!_item["cmd"].is<const char *>() || (api_command != nullptr && !apiArgumentValid(*api_command, _item))) return "Error: wrong syntax";
+    if (api_command == nullptr) return "Error: unknown command";
+    // only the commands of the command queue
+    bool queued{false};
+    for (int i{}; i <= static_cast<int>(OperationType::TurnOff) && !queued; ++i) {
+        _type = static_cast<OperationType>(i);
+        queued = strcmp(operationName(_type), api_command->name) == 0;
+    }
+    if (!queued) return "Error: not allowed in batch";
+    const char *error{apiPreconditionError(api_command->preconditions, _state)};
+    if (error != nullptr) return error;
+    _target = _type == OperationType::SlewToAz ? _item["az-target"].as<int>() : -1;
+    if (_type == OperationType::SlewToAz && (_target < 0 || _target > 360)) return "Error: target out of bound";
+
+    switch (_type) {
+        case OperationType::Abort:
+            _state.finding_zero = _state.finding_park = false;
+            _state.relays &= ~(1 << static_cast<int>(CW_MOTOR) | 1 << static_cast<int>(CCW_MOTOR));
+            break;
+        case OperationType::SlewToAz:
+            _state.relays |= 1 << static_cast<int>(CW_MOTOR);
+            break;
+        // the next commands of the batch wait for the end of the procedure
+        case OperationType::Park:
+            _state.in_park = true;
+            _state.relays &= ~(1 << static_cast<int>(CW_MOTOR) | 1 << static_cast<int>(CCW_MOTOR));
+            break;
+        case OperationType::FindZero:
+            _state.in_park = false;
+            _state.relays &= ~(1 << static_cast<int>(CW_MOTOR) | 1 << static_cast<int>(CCW_MOTOR));
+            break;
+        case OperationType::IgniteSwitchboard:
+            _state.optoins |= 1 << customOptoIn.getNumber(SWITCHBOARD_STATUS_O);
+            break;
+        default:
+            break;
+    }
+    return nullptr;
+}
+
+void apiHelp(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    /* Generated from the registry. The dispatch times (deserialization,
+     * lookup and checks, handler excluded) are measured on each request. */
+    String response{};
+    DynamicJsonDocument json_help{8192};
+    for (int i{}; i < API_COMMANDS; ++i) {
+        const ApiCommand &api_command{api_commands[i]};
+        const ApiCommandStats &stats{api_command_stats[i]};
+        JsonObject json_command{json_help["rsp"].createNestedObject()};
+        json_command["cmd"] = api_command.name;
+        json_command["class"] = web_rate_class_names[api_command.rate_class];
+        if (api_command.argument != nullptr) json_command["args"][api_command.argument] = api_argument_names[static_cast<int>(api_command.argument_type)];
+        for (int j{}; j < sizeof(api_precondition_names) / sizeof(api_precondition_names[0]); ++j)
+            if (api_command.preconditions >> j & 1) json_command["requires"].add(api_precondition_names[j]);
+        for (int j{}; j < sizeof(api_lock_names) / sizeof(api_lock_names[0]); ++j)
+            if (api_command.locks >> j & 1) json_command["locks"].add(api_lock_names[j]);
+        json_command["calls"] = stats.calls;
+        json_command["dispatch-mean-us"] = stats.calls == 0 ? 0 : static_cast<uint32_t>(stats.total_us / stats.calls);
+        json_command["dispatch-max-us"] = stats.max_us;
+    }
+    serializeJson(json_help, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+//////////
+
+void startWebServer() {
+    /////////////
+    // WEBPAGES
+
+    // pages, gzipped in flash (the css and js are served by onNotFound)
+
+    WebServer.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!admitWebRequest(request, WEB_RATE_PAGE)) return;
+        char set_cookie[WEB_SESSION_SET_COOKIE_SIZE]{};
+        if (!authenticateWebRequest(request, set_cookie)) return request->requestAuthentication();
+        sendWebAsset(request, *findWebAsset("/dashboard.html"), set_cookie);
     });
 
-    WebServer.on("/js-external/sa2.min.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/js-external/sa2.min.js", "text/javascript");
-        logMessage("ESPAsyncWebServer", request->url(), "");
+    WebServer.on("/log", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!admitWebRequest(request, WEB_RATE_PAGE)) return;
+        char set_cookie[WEB_SESSION_SET_COOKIE_SIZE]{};
+        if (!authenticateWebRequest(request, set_cookie)) return request->requestAuthentication();
+        sendWebAsset(request, *findWebAsset("/log.html"), set_cookie);
     });
 
     ///////////
@@ -111,11 +1053,16 @@ void startWebServer() {
 
     WebServer.on("/api", HTTP_GET, [](AsyncWebServerRequest *request) {
         if (request->hasParam("json")) {
-            StaticJsonDocument<192> json{};
+            const unsigned long start_time{micros()};
+            // admission by the class of the command, before any parsing (the strictest class if unknown)
+            const String &json_request{request->getParam("json")->value()};
+            const ApiCommand *api_command{findRawApiCommand(json_request.c_str())};
+            if (!admitWebRequest(request, api_command == nullptr ? WEB_RATE_CONTROL : api_command->rate_class)) return;
+            StaticJsonDocument<384> json{};
             String response{};
 
             // try deserialization
-            const DeserializationError d_error{deserializeJson(json, request->getParam("json")->value())};
+            const DeserializationError d_error{deserializeJson(json, json_request)};
             if (d_error) {
                 json["rsp"] = "Error: wrong syntax";
                 serializeJson(json, response);
@@ -124,11 +1071,10 @@ void startWebServer() {
                 return;
             }
 
-            // check json syntax
-            const bool c1{json.containsKey("cmd") && json["cmd"].is<String>()};
-            const bool c2{json["cmd"] != "slew-to-az" || (json["cmd"] == "slew-to-az" && json.containsKey("az-target"))};
-            const bool c3{json["cmd"] != "encoder-writeconf" || (json["cmd"] == "encoder-writeconf" && json.containsKey("config") && json["config"].is<JsonArrayConst>())};
-            if (!(c1 && c2 && c3)) {
+            // check json syntax, the parsed command must be the admitted one
+            const bool c1{json.containsKey("cmd") && json["cmd"].is<String>() && findApiCommand(json["cmd"].as<const char *>()) == api_command};
+            const bool c2{api_command == nullptr || apiArgumentValid(*api_command, json.as<JsonObjectConst>())};
+            if (!(c1 && c2)) {
                 json.clear();
                 json["rsp"] = "Error: wrong syntax";
                 serializeJson(json, response);
@@ -139,418 +1085,164 @@ void startWebServer() {
 
             // save command, and handle request
             const String command{json["cmd"].as<String>()};
-
-            /* dome-related functions */
-
-            if (command == "abort") {
+            if (api_command == nullptr) {
                 json.clear();
-                if (!AUTO) {
-                    json["rsp"] = "Error: dome in manual mode";
-                } else if (!SWITCHBOARD_STATUS) {
-                    json["rsp"] = "Error: switchboard off";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else if (!MOVEMENT_STATUS) {
-                    status_finding_zero = status_finding_park = false;
-                    xSemaphoreGive(xSemaphore);
-                    json["rsp"] = "done";
-                } else {
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    status_finding_zero = status_finding_park = false;
-                    stopSlewing();
-                    xSemaphoreGive(xSemaphore);
-                    return;
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "slew-to-az") {
-                const int new_target_az{json["az-target"].as<int>()};
-                json.clear();
-                if (!AUTO) {
-                    json["rsp"] = "Error: dome in manual mode";
-                } else if (!AC_PRESENCE) {
-                    json["rsp"] = "Error: no AC";
-                } else if (!SWITCHBOARD_STATUS) {
-                    json["rsp"] = "Error: switchboard off";
-                } else if (status_finding_zero) {
-                    json["rsp"] = "Error: finding zero";
-                } else if (status_finding_park) {
-                    json["rsp"] = "Error: parking";
-                } else if (new_target_az < 0 || new_target_az > 360) {
-                    json["rsp"] = "Error: target out of bound";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    startSlewing(new_target_az);
-                    xSemaphoreGive(xSemaphore);
-                    return;
-                }
+                json["rsp"] = "Error: unknown command";
                 serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "park") {
-                // allow
-                json.clear();
-                if (!AUTO) {
-                    json["rsp"] = "Error: dome in manual mode";
-                } else if (!SWITCHBOARD_STATUS) {
-                    json["rsp"] = "Error: switchboard off";
-                } else if (status_finding_zero) {
-                    json["rsp"] = "Error: finding zero";
-                } else if (status_finding_park || status_park) {
-                    json["rsp"] = "done";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else if (!MOVEMENT_STATUS && current_az > PARK_POSITION - 2 && current_az < PARK_POSITION + 2) {
-                    json["rsp"] = "done";
-                    status_park = true;
-                    EEPROM.writeBool(EEPROM_PARK_STATE_ADDRESS, status_park);
-                    EEPROM.commit();
-                    xSemaphoreGive(xSemaphore);
-                } else {
-                    json["rsp"] = "done";
+                request->send(400, "application/json", response);
+                logMessage("ESPAsyncWebServer", request->url(), response);
+            } else {
+                // the commands on the web authentication need an authenticated client (no session is started here)
+                char set_cookie[WEB_SESSION_SET_COOKIE_SIZE]{};
+                if ((api_command->preconditions & API_AUTHENTICATED) && !authenticateWebRequest(request, set_cookie)) return request->requestAuthentication();
+                const char *error{apiPreconditionError(api_command->preconditions, statusRecord().values)};
+                const uint32_t dispatch_us{static_cast<uint32_t>(micros() - start_time)};
+                ApiCommandStats &stats{api_command_stats[api_command - api_commands]};
+                ++stats.calls;
+                stats.total_us += dispatch_us;
+                stats.max_us = std::max(stats.max_us, dispatch_us);
+                if (error == nullptr && !takeApiLocks(api_command->locks)) error = "Error: mutex acquired";
+                if (error != nullptr) {
+                    json.clear();
+                    json["rsp"] = error;
                     serializeJson(json, response);
                     request->send(200, "application/json", response);
                     logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    park();
-                    xSemaphoreGive(xSemaphore);
-                    return;
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "find-zero") {
-                json.clear();
-                if (!AUTO) {
-                    json["rsp"] = "Error: dome in manual mode";
-                } else if (!AC_PRESENCE) {
-                    json["rsp"] = "Error: no AC";
-                } else if (!SWITCHBOARD_STATUS) {
-                    json["rsp"] = "Error: switchboard off";
-                } else if (MOVEMENT_STATUS) {
-                    json["rsp"] = "Error: dome moving";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
                 } else {
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    status_finding_zero = true;
-                    xSemaphoreGive(xSemaphore);
-                    return;
+                    api_command->handler(request, json, command);
+                    giveApiLocks(api_command->locks);
                 }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
             }
+        }
 
-            /* encoder-related functions */
-
-            else if (command == "encoder-readconf") {
-                json.clear();
-                if (xSemaphoreTake(xSemaphore_rs485, SEMAPHORE_RS485_TIMEOUT) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                    serializeJson(json, response);
-                } else {
-                    KMPProDinoESP32.rs485Write(static_cast<byte>(0xC1));
-                    std::vector<byte> config{readFromSerial485()};
-                    xSemaphoreGive(xSemaphore_rs485);
-                    StaticJsonDocument<384> json_conf{};
-                    for (int i{}; i < config.size(); ++i) json_conf["bytes"][i] = config[i];
-                    json_conf["decoded data"]["steps / degree"] = static_cast<int>(config[0]);
-                    json_conf["decoded data"]["steps / dome revolution"] = static_cast<int>(config[2] | config[1] << 8);
-                    json_conf["decoded data"]["zero azimuth"] = static_cast<int>(config[4] | config[3] << 8);
-                    json_conf["decoded data"]["zero offset steps"] = static_cast<int>(config[6] | config[5] << 8);
-                    json_conf["decoded data"]["checksum"] = static_cast<int>(config[7]);
-                    config.pop_back();
-                    byte checksum{};
-                    for (auto i : config) checksum += i;
-                    checksum = ~checksum + 1;
-                    json_conf["validation"] = config[7] == checksum;
-                    serializeJson(json_conf, response);
-                }
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
+        else {
+            if (!admitWebRequest(request, WEB_RATE_CONTROL)) return;
+            const char response[] PROGMEM{R"({"rsp":"Error: unknown params"})"};
+            request->send_P(400, "application/json", response);
+            logMessage("ESPAsyncWebServer", request->url(), response);
+        }
+    });
 
-            else if (command == "encoder-writeconf") {
-                // check
-                const DynamicJsonDocument json_writeconf{json};
-                const JsonArrayConst encoder_config{json_writeconf["config"].as<JsonArrayConst>()};
+    WebServer.on(
+        "/api/batch", HTTP_POST,
+        [](AsyncWebServerRequest *request) {
+            /* The body is a json array of commands of the command queue, e.g.
+             * [{"cmd":"ignite-switchboard"},{"cmd":"find-zero"}]. All the
+             * commands are checked against the same status snapshot (updated
+             * with the expected effect of the previous ones), then queued all
+             * together, or none if one fails. */
+            if (!admitWebRequest(request, WEB_RATE_CONTROL)) return;
+            DynamicJsonDocument json{2 * API_BATCH_BODY_SIZE};
+            String response{};
+            const char *body{static_cast<const char *>(request->_tempObject)};
+            if (body == nullptr || deserializeJson(json, body) || !json.is<JsonArrayConst>() || json.size() == 0 || json.size() > OPERATION_QUEUE_SIZE) {
                 json.clear();
-                bool config_type_error{false};
-                for (auto i : encoder_config)
-                    if (!i.is<byte>()) config_type_error = true;
-                if (AUTO) {
-                    json["rsp"] = "Error: dome in automatic mode";
-                } else if (!AC_PRESENCE) {
-                    json["rsp"] = "Error: no AC";
-                } else if (MOVEMENT_STATUS) {
-                    json["rsp"] = "Error: dome is moving";
-                } else if (config_type_error) {
-                    json["rsp"] = "Error: type must be byte (uint8_t)";
-                } else if (encoder_config.size() != 7) {
-                    json["rsp"] = "Error: config must be of 7 bytes";
-                } else {
-                    byte config[]{
-                        static_cast<byte>(0xC0),
-                        encoder_config[0].as<byte>(),
-                        encoder_config[1].as<byte>(),
-                        encoder_config[2].as<byte>(),
-                        encoder_config[3].as<byte>(),
-                        encoder_config[4].as<byte>(),
-                        encoder_config[5].as<byte>(),
-                        encoder_config[6].as<byte>(),
-                        static_cast<byte>(0)};
-                    byte checksum{};
-                    for (auto i : config) checksum += i;
-                    checksum = ~checksum + 1;
-                    config[8] = checksum;
-                    if (xSemaphoreTake(xSemaphore_rs485, SEMAPHORE_RS485_TIMEOUT) != pdTRUE) {
-                        json["rsp"] = "Error: mutex acquired";
-                    } else {
-                        KMPProDinoESP32.rs485Write(config, sizeof(config));
-                        xSemaphoreGive(xSemaphore_rs485);
-                        json["rsp"] = "done";
-                    }
-                }
+                json["rsp"] = "Error: wrong syntax";
                 serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+                request->send(400, "application/json", response);
+                logMessage("ESPAsyncWebServer", request->url(), response);
+                return;
             }
 
-            else if (command == "encoder-resetconf") {
-                json.clear();
-                if (AUTO) {
-                    json["rsp"] = "Error: dome in automatic mode";
-                } else if (!AC_PRESENCE) {
-                    json["rsp"] = "Error: no AC";
-                } else if (MOVEMENT_STATUS) {
-                    json["rsp"] = "Error: dome is moving";
-                } else if (xSemaphoreTake(xSemaphore_rs485, SEMAPHORE_RS485_TIMEOUT) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    KMPProDinoESP32.rs485Write(static_cast<byte>(0x44));
-                    xSemaphoreGive(xSemaphore_rs485);
-                    json["rsp"] = "done";
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+            // check all the commands, then queue them
+            const JsonArrayConst commands{json.as<JsonArrayConst>()};
+            const int count{static_cast<int>(commands.size())};
+            StatusValues state{statusRecord().values};
+            OperationType types[OPERATION_QUEUE_SIZE]{};
+            int targets[OPERATION_QUEUE_SIZE]{};
+            uint32_t ids[OPERATION_QUEUE_SIZE]{};
+            const char *error{nullptr};
+            int failed{-1};
+            for (int i{}; i < count && error == nullptr; ++i) {
+                error = checkBatchCommand(commands[i], state, types[i], targets[i]);
+                if (error != nullptr) failed = i;
             }
+            if (error == nullptr && !submitOperationBatch(types, targets, count, ids)) error = "Error: command queue full";
 
-            else if (command == "encoder-disablezero") {
-                json.clear();
-                if (AUTO) {
-                    json["rsp"] = "Error: dome in automatic mode";
-                } else if (!AC_PRESENCE) {
-                    json["rsp"] = "Error: no AC";
-                } else if (MOVEMENT_STATUS) {
-                    json["rsp"] = "Error: dome is moving";
-                } else if (xSemaphoreTake(xSemaphore_rs485, SEMAPHORE_RS485_TIMEOUT) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
+            DynamicJsonDocument json_batch{1024};
+            json_batch["rsp"] = error == nullptr ? "done" : error;
+            for (int i{}; i < count; ++i) {
+                JsonObject result{json_batch["results"].createNestedObject()};
+                result["cmd"] = commands[i]["cmd"];
+                if (error == nullptr) {
+                    result["rsp"] = "done";
+                    result["op-id"] = ids[i];
                 } else {
-                    KMPProDinoESP32.rs485Write(static_cast<byte>(0x23));
-                    xSemaphoreGive(xSemaphore_rs485);
-                    json["rsp"] = "done";
+                    result["rsp"] = i == failed ? error : "Error: batch rejected";
                 }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
             }
+            serializeJson(json_batch, response);
+            request->send(200, "application/json", response);
+            logMessage("ESPAsyncWebServer", request->url(), response);
+        },
+        nullptr,
+        [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+            // collect the body, freed with the request (a body too long is dropped)
+            if (total > API_BATCH_BODY_SIZE) return;
+            if (index == 0) request->_tempObject = calloc(total + 1, 1);
+            if (request->_tempObject != nullptr) memcpy(static_cast<uint8_t *>(request->_tempObject) + index, data, len);
+        });
 
-            /* system management */
-
-            else if (command == "ignite-switchboard") {
-                json.clear();
-                if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    if (!status_switchboard_ignited) {
-                        switchboardIgnition();
-                        status_switchboard_ignited = true;
-                    }
-                    xSemaphoreGive(xSemaphore);
-                    return;
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
+    //////////////////
+    // TRAJECTORIES
 
-            else if (command == "reset-EEPROM") {
-                json.clear();
-                if (MOVEMENT_STATUS) {
-                    json["rsp"] = "Error: dome is moving";
-                } else if (!AC_PRESENCE) {
-                    json["rsp"] = "Error: no AC";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    EEPROM.writeBool(EEPROM_INITIALIZED_ADDRESS, false);
-                    EEPROM.commit();
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    SSELogger.close();
-                    ESP.restart();
-                    xSemaphoreGive(xSemaphore);
-                    return;
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
+    WebServer.on("/trajectory", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!admitWebRequest(request, WEB_RATE_PAGE)) return;
+        const int slews{request->hasParam("slews") ? static_cast<int>(request->getParam("slews")->value().toInt()) : 1};
+        const bool binary{request->hasParam("format") && request->getParam("format")->value() == "bin"};
+        if (slews < 1 || slews > TRAJECTORY_SLEWS) {
+            const char response[] PROGMEM{R"({"rsp":"Error: wrong slews number"})"};
+            request->send_P(400, "application/json", response);
+            logMessage("ESPAsyncWebServer", request->url(), response);
+            return;
+        }
 
-            else if (command == "restart") {
-                json.clear();
-                if (MOVEMENT_STATUS) {
-                    json["rsp"] = "Error: dome is moving";
-                } else if (!AC_PRESENCE) {
-                    json["rsp"] = "Error: no AC";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
+        /* The samples are streamed one at a time straight from the ring buffer,
+         * so no copy of the trajectories is allocated. The binary format is an
+         * 8 bytes header ("TRJ", version, sample size, reserved), followed by
+         * the raw little-endian TrajectorySample structs. */
+        uint32_t begin{}, end{};
+        trajectoryRange(slews, begin, end);
+        bool header_sent{false};
+        AsyncWebServerResponse *response{request->beginChunkedResponse(binary ? "application/octet-stream" : "text/csv", [=](uint8_t *buffer, size_t max_len, size_t index) mutable -> size_t {
+            size_t length{};
+            if (!header_sent) {
+                if (binary) {
+                    const uint8_t header[8]{'T', 'R', 'J', 1, sizeof(TrajectorySample) & 0xFF, sizeof(TrajectorySample) >> 8, 0, 0};
+                    if (max_len < sizeof(header)) return 0;
+                    memcpy(buffer, header, sizeof(header));
+                    length = sizeof(header);
                 } else {
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    shutDown();
-                    SSELogger.close();
-                    ESP.restart();
-                    xSemaphoreGive(xSemaphore);
-                    return;
+                    length = snprintf(reinterpret_cast<char *>(buffer), max_len, "slew,type,timestamp,azimuth,estimate,target,cw,ccw,latency-us\n");
+                    if (length >= max_len) return 0;
                 }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+                header_sent = true;
             }
-
-            else if (command == "force-restart") {
-                json.clear();
-                json["rsp"] = "done";
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command);
-                SSELogger.close();
-                ESP.restart();
-            }
-
-            else if (command == "turn-off") {
-                json.clear();
-                if (!AUTO) {
-                    json["rsp"] = "Error: dome in manual mode";
-                } else if (!AC_PRESENCE) {
-                    json["rsp"] = "Error: no AC";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(300)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    shutDown();
-                    xSemaphoreGive(xSemaphore);
-                    return;
+            static const char *const type_names[]{"slew", "park", "find-zero", "manual"};
+            TrajectorySample sample{};
+            char line[96];
+            while (begin != end) {
+                // samples overwritten while streaming are skipped
+                if (!trajectorySample(begin, sample)) {
+                    ++begin;
+                    continue;
                 }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "server-logging-toggle") {
-                json.clear();
-                webserver_logging = !webserver_logging;
-                json["rsp"] = "done";
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "server-logging-status") {
-                json.clear();
-                json["rsp"] = webserver_logging;
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            /* status */
-
-            else if (command == "status") {
-                if (xSemaphoreTake(xSemaphore_status, pdMS_TO_TICKS(50)) != pdTRUE) {
-                    json.clear();
-                    json["rsp"] = "Error: mutex acquired";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+                if (binary) {
+                    if (max_len - length < sizeof(sample)) break;
+                    memcpy(buffer + length, &sample, sizeof(sample));
+                    length += sizeof(sample);
                 } else {
-                    // create json
-                    json_status.clear();
-                    json_status["rsp"]["firmware-version"] = FIRMWARE_VERSION;
-                    json_status["rsp"]["uptime"] = uptime_formatter::getUptime();
-                    json_status["rsp"]["dome-azimuth"] = status_finding_zero ? -1 : current_az;
-                    json_status["rsp"]["target-azimuth"] = target_az;
-                    json_status["rsp"]["movement-status"] = MOVEMENT_STATUS;
-                    json_status["rsp"]["in-park"] = status_park;
-                    json_status["rsp"]["finding-park"] = status_finding_park;
-                    json_status["rsp"]["finding-zero"] = status_finding_zero;
-                    for (int i{}; i < 4; ++i) json_status["rsp"]["relay"]["list"][i] = KMPProDinoESP32.getRelayState(i);
-                    json_status["rsp"]["relay"]["cw-motor"] = IS_MOVING_CW;
-                    json_status["rsp"]["relay"]["ccw-motor"] = IS_MOVING_CCW;
-                    json_status["rsp"]["relay"]["switchboard"] = KMPProDinoESP32.getRelayState(SWITCHBOARD);
-                    for (int i{}; i < 8; ++i) json_status["rsp"]["optoin"]["list"][i] = customOptoIn.getState(i);
-                    json_status["rsp"]["optoin"]["auto"] = customOptoIn.getState(AUTO_O);
-                    json_status["rsp"]["optoin"]["switchboard-status"] = SWITCHBOARD_STATUS;
-                    json_status["rsp"]["optoin"]["ac-presence"] = AC_PRESENCE;
-                    json_status["rsp"]["optoin"]["manual-cw-button"] = MAN_CW;
-                    json_status["rsp"]["optoin"]["manual-ccw-button"] = MAN_CCW;
-                    json_status["rsp"]["optoin"]["manual-ignition"] = MAN_IGNITION;
-                    json_status["rsp"]["wifi"]["hostname"] = HOSTNAME;
-                    json_status["rsp"]["wifi"]["mac-address"] = WiFi.macAddress();
-                    // clean, serialize and send
-                    response_status.clear();
-                    serializeJson(json_status, response_status);
-                    request->send(200, "application/json", response_status);
-                    if (webserver_logging) logMessage("ESPAsyncWebServer", request->url(), command + ": " + response_status);
-                    xSemaphoreGive(xSemaphore_status);
+                    const size_t line_length{static_cast<size_t>(snprintf(line, sizeof(line), "%u,%s,%lu,%d,%d.%d,%d,%u,%u,%lu\n", sample.slew, type_names[static_cast<int>(sample.type)], static_cast<unsigned long>(sample.timestamp), sample.azimuth, sample.estimate / 10, abs(sample.estimate % 10), sample.target, sample.relays & 1, (sample.relays >> 1) & 1, static_cast<unsigned long>(sample.latency_us)))};
+                    if (max_len - length < line_length) break;
+                    memcpy(buffer + length, line, line_length);
+                    length += line_length;
                 }
+                ++begin;
             }
-
-            else {
-                json.clear();
-                json["rsp"] = "Error: unknown command";
-                serializeJson(json, response);
-                request->send(400, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), response);
-            }
-        }
-
-        else {
-            const char response[] PROGMEM{R"({"rsp":"Error: unknown params"})"};
-            request->send_P(400, "application/json", response);
-            logMessage("ESPAsyncWebServer", request->url(), response);
-        }
+            return length;
+        })};
+        request->send(response);
+        logMessage("ESPAsyncWebServer", request->url(), String{"Streaming "} + (end - begin) + " samples");
     });
 
     ///////////////
@@ -562,20 +1254,51 @@ void startWebServer() {
 
     WebServer.addHandler(&SSELogger);
 
+    ///////////////////
+    // STATUS STREAM
+
+    StatusSSE.onConnect([](AsyncEventSourceClient *client) {
+        // snapshot of the last version sent to the other clients, so that the next deltas apply to it
+        if (xSemaphoreTake(xSemaphore_status, pdMS_TO_TICKS(50)) != pdTRUE) return client->close();
+        if (!status_sse_buffer) {
+            status_sse_buffer = statusBuffer(status_sse_version);
+            json_status_sse = json_status;
+            status_sse_time = millis();
+        }
+        client->send(status_sse_buffer->c_str(), "snapshot", status_sse_version);
+        xSemaphoreGive(xSemaphore_status);
+    });
+
+    WebServer.addHandler(&StatusSSE);
+
     //////////
     // OTHER
 
     WebServer.onNotFound([](AsyncWebServerRequest *request) {
-        const char response[] PROGMEM{R"({"rsp":"Error: not found"})"};
-        request->send_P(404, "application/json", response);
-        logMessage("ESPAsyncWebServer", request->url(), response);
+        if (!admitWebRequest(request, WEB_RATE_PAGE)) return;
+        // css and js, with the content hash in the name
+        const WebAsset *asset{request->method() == HTTP_GET ? findWebAsset(request->url().c_str()) : nullptr};
+        if (asset != nullptr && asset->immutable) {
+            sendWebAsset(request, *asset);
+        } else {
+            const char response[] PROGMEM{R"({"rsp":"Error: not found"})"};
+            request->send_P(404, "application/json", response);
+            logMessage("ESPAsyncWebServer", request->url(), response);
+        }
     });
 
     //////////
     // BEGIN
 
-    // prepare status string
-    response_status.reserve(JSON_S_SIZE);
+    // status ETag prefix
+    status_boot_id = esp_random();
+
+    // api commands index
+    buildApiIndex();
+
+    // web authentication: allowlist from NVS, session tokens key
+    loadWebAllowlist();
+    esp_fill_random(web_session_key, sizeof(web_session_key));
 
     // add default CORS header
     DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
@@ -0,0 +1,134 @@
+/*
+Remote REST dome controller
+https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+         Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* The /api command registry, with its index and the argument check; included
+ * once, by web_server.cpp after the handlers, and by the host benchmark
+ * (tools/api_dispatch_benchmark, with API_REGISTRY_HOST defined). */
+
+#ifndef _API_COMMANDS_HPP_
+#define _API_COMMANDS_HPP_
+
+#include <ArduinoJson.h>
+#include <string.h>
+
+#include "api_registry.hpp"
+
+// command registry, see the API description in the README
+constexpr ApiCommand api_commands[]{
+    // shutter-related functions
+    {"abort", API_HANDLER(apiAbort), WEB_RATE_CONTROL, API_AUTO},
+    {"close", API_HANDLER(apiClose), WEB_RATE_CONTROL, API_NO_ALERT | API_NETWORK | API_AUTO | API_UNLOCKED},
+    {"open", API_HANDLER(apiOpen), WEB_RATE_CONTROL, API_NO_ALERT | API_NETWORK | API_AUTO | API_UNLOCKED},
+    {"lock-movement", API_HANDLER(apiLockMovement), WEB_RATE_CONTROL},
+    {"unlock-movement", API_HANDLER(apiUnlockMovement), WEB_RATE_CONTROL},
+    // system management
+    {"reset-alert-status", API_HANDLER(apiResetAlertStatus), WEB_RATE_CONTROL, 0, API_LOCK_LOOP},
+    {"reset-EEPROM", API_HANDLER(apiResetEEPROM), WEB_RATE_CONTROL, API_NO_ALERT | API_NOT_MOVING, API_LOCK_LOOP},
+    {"restart", API_HANDLER(apiRestart), WEB_RATE_CONTROL, API_NOT_MOVING, API_LOCK_LOOP},
+    {"force-restart", API_HANDLER(apiForceRestart), WEB_RATE_CONTROL},
+    {"server-logging-toggle", API_HANDLER(apiServerLoggingToggle), WEB_RATE_CONTROL},
+    {"server-logging-status", API_HANDLER(apiServerLoggingStatus), WEB_RATE_QUERY},
+    {"server-limits", API_HANDLER(apiServerLimits), WEB_RATE_QUERY},
+    {"server-limits-reset", API_HANDLER(apiServerLimitsReset), WEB_RATE_CONTROL},
+    {"help", API_HANDLER(apiHelp), WEB_RATE_QUERY},
+    // web authentication
+    {"auth-allowlist", API_HANDLER(apiAuthAllowlist), WEB_RATE_QUERY, API_AUTHENTICATED},
+    {"auth-allowlist-set", API_HANDLER(apiAuthAllowlistSet), WEB_RATE_CONTROL, API_AUTHENTICATED, 0, "cidr", ApiArgument::Array},
+    {"auth-sessions-revoke", API_HANDLER(apiAuthSessionsRevoke), WEB_RATE_CONTROL, API_AUTHENTICATED},
+    // status
+    {"status", API_HANDLER(apiStatus), WEB_RATE_QUERY, 0, API_LOCK_STATUS},
+    {"status-wait", API_HANDLER(apiStatusWait), WEB_RATE_QUERY, 0, 0, "version", ApiArgument::UInt32}};
+#define API_COMMANDS (sizeof(api_commands) / sizeof(api_commands[0]))
+
+#define API_INDEX_SIZE 64
+static_assert(API_COMMANDS <= API_INDEX_SIZE / 2, "API_INDEX_SIZE too small");
+// open addressing index of api_commands by name hash (0xFF if empty slot), filled by startWebServer
+uint8_t api_index[API_INDEX_SIZE]{};
+
+/**
+ * @brief Fill the api_commands index.
+ */
+void buildApiIndex() {
+    memset(api_index, 0xFF, sizeof(api_index));
+    for (uint8_t i{}; i < API_COMMANDS; ++i) {
+        uint32_t slot{api_commands[i].hash % API_INDEX_SIZE};
+        while (api_index[slot] != 0xFF) slot = (slot + 1) % API_INDEX_SIZE;
+        api_index[slot] = i;
+    }
+}
+
+/**
+ * @brief Return the registry entry of a command, or nullptr if unknown.
+ */
+const ApiCommand *findApiCommand(const char *_name) {
+    const uint32_t hash{fnv1aHash(_name)};
+    for (uint32_t slot{hash % API_INDEX_SIZE}; api_index[slot] != 0xFF; slot = (slot + 1) % API_INDEX_SIZE) {
+        const ApiCommand &api_command{api_commands[api_index[slot]]};
+        if (api_command.hash == hash && strcmp(api_command.name, _name) == 0) return &api_command;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Return the registry entry of the command of a raw /api request, or nullptr, without parsing the json: the
+ * value of the first "cmd" key, if a plain string (no escapes). Used to admit the request before the parse.
+ */
+const ApiCommand *findRawApiCommand(const char *_json) {
+    const char *cursor{strstr(_json, "\"cmd\"")};
+    if (cursor == nullptr) return nullptr;
+    cursor += 5;
+    cursor += strspn(cursor, " \t\r\n");
+    if (*cursor++ != ':') return nullptr;
+    cursor += strspn(cursor, " \t\r\n");
+    if (*cursor++ != '"') return nullptr;
+    char name[32]{};
+    for (size_t i{}; cursor[i] != '"'; ++i) {
+        if (cursor[i] == 0 || cursor[i] == '\\' || i == sizeof(name) - 1) return nullptr;
+        name[i] = cursor[i];
+    }
+    return findApiCommand(name);
+}
+
+/**
+ * @brief Return true if the required argument of a command is present and of the right type.
+ */
+bool apiArgumentValid(const ApiCommand &_api_command, JsonObjectConst _json) {
+    if (_api_command.argument == nullptr) return true;
+    const JsonVariantConst argument{_json[_api_command.argument]};
+    switch (_api_command.argument_type) {
+        case ApiArgument::UInt32:
+            return argument.is<uint32_t>();
+        case ApiArgument::Array:
+            return argument.is<JsonArrayConst>();
+        default:
+            return true;
+    }
+}
+
+#endif  // _API_COMMANDS_HPP_
@@ -0,0 +1,110 @@
+/*
+Remote REST dome controller
+https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+         Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _API_REGISTRY_HPP_
+#define _API_REGISTRY_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief FNV-1a hash of a string; the offset basis can be changed, as seed of a perfect hash.
+ */
+constexpr uint32_t fnv1aHash(const char *_text, const uint32_t _hash = 2166136261u) {
+    return *_text == 0 ? _hash : fnv1aHash(_text + 1, (_hash ^ static_cast<uint8_t>(*_text)) * 16777619u);
+}
+
+//////////
+
+// request classes of the admission control, each with its token bucket (WEB_RATE_LIMITS)
+enum WebRateClass : uint8_t {
+    WEB_RATE_PAGE,    // web pages and their files
+    WEB_RATE_QUERY,   // api commands that only read
+    WEB_RATE_CONTROL  // api commands that act on the board, batches
+};
+constexpr const char *web_rate_class_names[]{"page", "query", "control"};
+
+/* The /api commands are described by the api_commands registry (api_commands.hpp): name,
+ * handler, rate class, required argument, preconditions and locks. The
+ * dispatcher looks up the command by the FNV-1a hash of its name (computed at
+ * compile time for the registry), then checks the rate limit, the argument,
+ * the preconditions and takes the locks,
+ * all driven by the registry, before calling the handler. The `help` command
+ * describes the registry. */
+
+// type of the required argument of a command
+enum class ApiArgument : uint8_t {
+    None,
+    UInt32,
+    Array
+};
+constexpr const char *api_argument_names[]{"none", "uint32", "array"};
+
+// command preconditions, bit mask (checked and reported in this order)
+enum ApiPrecondition : uint8_t {
+    API_NO_ALERT = 1 << 0,
+    API_NETWORK = 1 << 1,
+    API_AUTO = 1 << 2,
+    API_UNLOCKED = 1 << 3,
+    API_NOT_MOVING = 1 << 4,
+    API_AUTHENTICATED = 1 << 5  // client in the web allowlist, or with a session or Basic auth (checked first)
+};
+constexpr const char *api_precondition_names[]{"no-alert", "network", "auto", "unlocked", "not-moving", "authenticated"};
+
+// locks taken by the dispatcher around the handler, bit mask
+enum ApiLock : uint8_t {
+    API_LOCK_LOOP = 1 << 0,
+    API_LOCK_STATUS = 1 << 1
+};
+constexpr const char *api_lock_names[]{"loop", "status"};
+
+#ifdef API_REGISTRY_HOST
+// host tools: the registry without the handlers
+typedef const void *ApiHandler;
+#define API_HANDLER(handler) nullptr
+#else
+typedef void (*ApiHandler)(AsyncWebServerRequest *request, JsonDocument &json, const String &command);
+#define API_HANDLER(handler) handler
+#endif
+
+struct ApiCommand {
+    const char *name;
+    uint32_t hash;
+    ApiHandler handler;
+    WebRateClass rate_class;
+    const char *argument;  // required argument key, or nullptr
+    ApiArgument argument_type;
+    uint8_t preconditions;  // ApiPrecondition mask
+    uint8_t locks;          // ApiLock mask
+
+    constexpr ApiCommand(const char *_name, const ApiHandler _handler, const WebRateClass _rate_class, const uint8_t _preconditions = 0, const uint8_t _locks = 0, const char *_argument = nullptr, const ApiArgument _argument_type = ApiArgument::None)
+        : name{_name}, hash{fnv1aHash(_name)}, handler{_handler}, rate_class{_rate_class}, argument{_argument}, argument_type{_argument_type}, preconditions{_preconditions}, locks{_locks} {}
+};
+
+#endif  // _API_REGISTRY_HPP_
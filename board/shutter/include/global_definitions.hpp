@@ -66,7 +66,8 @@ SOFTWARE.
 #define UTIL_H
 #include "KMPProDinoESP32.h"
 
-/* Keep ESPAsyncWebServer on a random core since the net_task is more important. */
+/* Keep ESPAsyncWebServer on a random core since the net_task is more important;
+ * its load is bounded by the admission control (WEB_REQUESTS_IN_FLIGHT). */
 #define CONFIG_ASYNC_TCP_RUNNING_CORE -1
 
 #include <ArduinoJson.h>
@@ -74,12 +75,19 @@ SOFTWARE.
 #include <EEPROM.h>
 #include <ESP32Ping.h>
 #include <ESPAsyncWebServer.h>
+#include <Preferences.h>
 #include <SPIFFS.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
+#include <mbedtls/md.h>
 #include <uptime.h>
 #include <uptime_formatter.h>
 
+#include <atomic>
+#include <memory>
+
+#include "api_registry.hpp"
+
 ////////////////////////////////////////////////////////////////////////////////
 // VARIABLES
 
@@ -105,6 +113,20 @@ extern bool blink_led_loop;
  * during critical operations such as the final stages of the motion. */
 extern SemaphoreHandle_t xSemaphore;
 
+/* Input changes (expander INT output) are delivered by an interrupt as
+ * notifications to the loop task, so the loop reacts within a few
+ * milliseconds instead of polling the inputs. */
+// loop task handle, notified at each input change
+extern TaskHandle_t loop_task_handle;
+// max time between two loop passes without input changes (periodic work keeps its own timers)
+#define LOOP_INTERVAL pdMS_TO_TICKS(100)
+
+struct InputLatencyStats {
+    uint32_t last_us; // last input-to-relay reaction time, in microseconds
+    uint32_t max_us;  // max reaction time since start up
+    uint32_t count;   // number of measured reactions
+};
+
 //////////
 
 // shutter opening motor relay
@@ -117,15 +139,20 @@ extern SemaphoreHandle_t xSemaphore;
 // indicate if the shutter is moving due to an automatic command, aka if any relays is on
 #define MOVEMENT_STATUS (IS_OPENING || IS_CLOSING)
 
+/* The optoins are read once per control tick (one SPI transaction) into the
+ * optoin image, and the macros below are served from that snapshot. */
+
 // automatic-manual switch status
-#define AUTO KMPProDinoESP32.getOptoInState(OptoIn::OptoIn1)
+#define AUTO KMPProDinoESP32.getOptoInImageState(OptoIn::OptoIn1)
 // closing limit switch sensor
-#define CLOSED_SENSOR KMPProDinoESP32.getOptoInState(OptoIn::OptoIn2)
+#define CLOSED_SENSOR KMPProDinoESP32.getOptoInImageState(OptoIn::OptoIn2)
 // opening limit switch sensor
-#define OPENED_SENSOR KMPProDinoESP32.getOptoInState(OptoIn::OptoIn3)
+#define OPENED_SENSOR KMPProDinoESP32.getOptoInImageState(OptoIn::OptoIn3)
 
 // empirical time to let both motors close or open, aka the time between toggle and real open/close
 #define SENSOR_TOGGLING_TIME 4500
+// time with the relays off before reversing the motion
+#define SHUTTER_REVERSE_TIME 150
 // max time to wait before trigger the alert status
 #define ALERT_STATUS_WAIT 22000
 // aux variable to check that the shutter moving time is below ALERT_STATUS_WAIT
@@ -157,6 +184,36 @@ enum class EmergencyProcedure {
 // hold the status of the emergency procedure if no network
 extern EmergencyProcedure EP_status;
 
+/* Shutter motion state machine: in automatic mode the motor relays are driven
+ * only by the loop, that advances the motion once per control tick with
+ * deadline timers. The web server and the net task submit intents to a short
+ * queue, executed at the next tick, and never wait for the motion. */
+enum class ShutterIntent : uint8_t {
+    None,
+    Open,
+    Close,
+    Abort,
+};
+
+enum class ShutterMotion : uint8_t {
+    Idle,        // no motion since start up
+    Starting,    // relays off before reversing, for SHUTTER_REVERSE_TIME
+    Travelling,  // motor on, waiting for the starting limit switch to release and then for the final one
+    Seating,     // final limit switch reached, motor kept on for SENSOR_TOGGLING_TIME to complete the motion
+    Stopped,     // motion completed or aborted, relays off
+    Fault,       // a deadline expired, relays off and hardware alert status
+};
+
+struct ShutterMotionStatus {
+    ShutterMotion state;
+    ShutterIntent direction;  // Open or Close, None if no motion since start up
+    bool sensor_released;     // the starting limit switch released (or was not active at the start)
+    unsigned long state_time; // millis() of the last state change
+};
+
+// max number of pending intents
+#define SHUTTER_INTENT_QUEUE_SIZE 4
+
 enum class ShutterStatus {
     // static statuses
     PartiallyOpened = -1,
@@ -167,6 +224,49 @@ enum class ShutterStatus {
     Closing,
 };
 
+// lock shutter movement (the change state commands are rejected)
+extern bool lock_movement;
+
+/* Status snapshot: at the end of each tick the loop (the control task) copies
+ * the status into a plain record, and bumps its version only if a value
+ * changed (or after STATUS_REFRESH_INTERVAL, to refresh uptime and ages). The
+ * web server serializes the record once per version and serves the same
+ * buffer to every status request, tagged with the version as weak ETag. */
+// max time between two versions, in milliseconds
+#define STATUS_REFRESH_INTERVAL 5000
+// status-wait command: default and max wait, in milliseconds, and max pending requests
+#define STATUS_WAIT_DEFAULT 30000
+#define STATUS_WAIT_MAX 60000
+#define STATUS_WAIT_REQUESTS 4
+
+struct StatusValues {
+    ShutterStatus shutter_status;
+    ShutterMotion motion_state;
+    ShutterIntent motion_direction;
+    bool lock_movement;
+    bool network_status;
+    bool hardware_alert;
+    char hardware_alert_description[ALERT_STATUS_DESCRIPTION_SIZE];
+    bool network_alert;
+    EmergencyProcedure security_procedures;
+    uint8_t relays;   // bit i - relay i
+    uint8_t optoins;  // bit i - optoin i (image)
+    uint32_t spi_per_tick;
+    uint32_t spi_per_tick_max;
+    uint32_t latency_last_us;
+    uint32_t latency_max_us;
+    uint32_t reactions;
+};
+
+struct StatusRecord {
+    uint32_t version;           // from 1, bumped at each change (0 if not published yet)
+    uint32_t change_version;    // last version with changed values (the others only refresh uptime and ages)
+    unsigned long time;         // millis() of the version
+    unsigned long motion_time;  // millis() of the last motion state change
+    unsigned long image_time;   // millis() of the optoin image
+    StatusValues values;        // compared to detect the changes (timestamps excluded)
+};
+
 //////////
 
 #define HOSTNAME "shutter-controller"
@@ -178,8 +278,48 @@ enum class ShutterStatus {
 
 extern AsyncWebServer WebServer;
 extern AsyncEventSource SSELogger;
+/* Status stream: a "snapshot" event with the whole status at the connection,
+ * then a "delta" event with only the changed fields at each new status
+ * version, and a "heartbeat" event if nothing changed for a while. The events
+ * are pushed by the status task, woken by the loop at each new version. */
+extern AsyncEventSource StatusSSE;
+// status task handle, notified at each new status version
+extern TaskHandle_t status_task_handle;
+// max time without status events, in milliseconds
+#define STATUS_SSE_HEARTBEAT 2000
 #define WEBPAGE_LOGIN_USER "admin"     /* TODO put your webpage user */
 #define WEBPAGE_LOGIN_PASSWORD "admin" /* TODO put your webpage password */
+/* Web assets: the build step (web_assets.py) gzips the files of data/,
+ * renames the ones referenced by the pages with their content hash, and packs
+ * them in flash, in a table indexed by a perfect hash of the url
+ * (web_assets_bundle.h, generated in the build directory). */
+struct WebAsset {
+    const char *url;  // nullptr if empty slot
+    const char *type;
+    const char *etag;
+    bool immutable;       // hashed name, cached by the browsers without revalidation
+    const uint8_t *data;  // gzipped, in flash
+    size_t length;
+};
+// Cache-Control of the hashed assets (the pages are revalidated with their ETag)
+#define WEB_ASSETS_CACHE_CONTROL "public, max-age=31536000, immutable"
+/* Web authentication: the clients in the allowlist (IPv4 CIDR ranges, set
+ * with the auth-allowlist-set command and saved in NVS) are always
+ * authorized; the others log in once with Basic auth, then use a session
+ * token (cookie, HMAC of expiry and client address, key drawn at boot). */
+#define WEB_ALLOWLIST_SIZE 8
+#define WEB_ALLOWLIST_DEFAULT {"authorized_ip_1/32", "authorized_ip_2/32"} /* TODO put your authorized IP ranges here, used until set via API */
+#define WEB_SESSION_COOKIE "session"
+#define WEB_SESSION_DURATION 900  // in seconds
+#define WEB_SESSION_SET_COOKIE_SIZE 128
+/* Admission control: each client (by address, the least recently seen is
+ * replaced when the table is full) has a token bucket per request class;
+ * a request with no tokens left is answered 429, any request over the cap of
+ * requests in flight 503, at once and without taking any mutex. */
+#define WEB_REQUESTS_IN_FLIGHT 12
+#define WEB_RATE_CLIENTS 16
+// bucket of each class: refill (tokens per second, at least 1) and size
+#define WEB_RATE_LIMITS {{5, 30}, {10, 20}, {2, 5}}
 
 #define HTTP_REQUEST_TIMEOUT 5000
 struct httpResponseSummary {
@@ -212,8 +352,19 @@ struct httpResponseSummary {
  */
 void net_task(void *_parameter);
 
+/**
+ * @brief Status task: it pushes the status events to the StatusSSE clients.
+ */
+void status_task(void *_parameter);
+
 //////////
 
+/**
+ * @brief Advance the shutter motion by one control tick: execute the queued intents, then check the sensors and the
+ * deadlines of the current state. Called only by the loop task, with the global mutex taken.
+ */
+void advanceShutterMotion();
+
 /**
  * @brief Setup and connect to Wi-Fi.
  */
@@ -232,6 +383,12 @@ void flashLed(const uint32_t &_color, const int &_delayInterval);
  */
 ShutterStatus getShutterStatus();
 
+/**
+ * @brief Get the input-to-relay reaction time statistics.
+ * @return A copy of the InputLatencyStats.
+ */
+InputLatencyStats inputLatencyStats();
+
 /**
  * @brief Log on serial and using SSELogger, formatted as "[_identifier] _msg".
  * @param _identifier calling task identifier, e.g. "setup", "loop", ...
@@ -320,6 +477,43 @@ void logMessage(const char *_identifier1, const T &_identifier2, const String &_
 template <typename T, typename V, LOGMESSAGE_ENABLEIF(T), LOGMESSAGE_ENABLEIF(V)>
 void logMessage(const char *_identifier1, const T &_identifier2, const V &_msg);
 
+/**
+ * @brief Latency probe: record the time elapsed from the input change that woke the loop, to be called just after the
+ * relays are switched in reaction to it. Only the first reaction to each change is recorded.
+ */
+void probeInputLatency();
+
+/**
+ * @brief Push the status events to the StatusSSE clients: the changed fields if there is a new status version, else
+ * the heartbeat if it is due. Called only by the status task.
+ */
+void pushStatusEvents();
+
+/**
+ * @brief Copy the status into the status snapshot, bumping its version if something changed. Called only by the
+ * loop task, at the end of each tick.
+ */
+void publishStatusRecord();
+
+/**
+ * @brief Get the status of the shutter motion state machine.
+ * @return A copy of the ShutterMotionStatus.
+ */
+ShutterMotionStatus shutterMotionStatus();
+
+/**
+ * @brief Get the name of a shutter motion state, for the status and the log.
+ * @param _state the state
+ * @return The state name.
+ */
+const char *shutterMotionName(const ShutterMotion _state);
+
+/**
+ * @brief Attach the interrupt of the optoins, that notifies the loop task at each change. Must be called by the loop
+ * task (i.e. in setup).
+ */
+void startInputInterrupts();
+
 /**
  * @brief Setup and start OTA.
  */
@@ -330,6 +524,27 @@ void startOTA();
  */
 void startWebServer();
 
+/**
+ * @brief Get the status snapshot. It never blocks the loop (short critical section).
+ * @return A copy of the last StatusRecord.
+ */
+StatusRecord statusRecord();
+
+/**
+ * @brief Submit an intent to the shutter motion state machine, without waiting for it: it is executed by the loop at
+ * the next control tick.
+ * @param _intent the intent
+ * @return true if queued, false if the queue is full.
+ */
+bool submitShutterIntent(const ShutterIntent _intent);
+
+/**
+ * @brief Wait for an input change, or for the timeout. Called only by the loop task, in place of delay.
+ * @param _timeout max time to wait
+ * @return true if an input changed, false if the timeout expired.
+ */
+bool waitInputChange(const TickType_t _timeout);
+
 //////////
 
 #endif  // _GLOBAL_DEFINITIONS_HPP_
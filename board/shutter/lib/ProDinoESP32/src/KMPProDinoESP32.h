@@ -215,6 +215,24 @@ class KMPProDinoESP32Class
 	* @return void
 	*/
 	void setAllRelaysState(bool state);
+
+	/**
+	* @brief Set the state of several relays at once, with a single SPI transaction (all the relays switch in the
+	*        same bus cycle).
+	*
+	* @param mask Relays to be set, bit 0 - Relay1 ... bit 3 - Relay4.
+	* @param values Relays state, bit 0 - Relay1 ... bit 3 - Relay4. 1 - On. Bits not in mask are ignored.
+	*
+	* @return void
+	*/
+	void setRelayMask(uint8_t mask, uint8_t values);
+
+	/**
+	* @brief Get the state of all relays from the output latch shadow, without SPI transactions.
+	*
+	* @return uint8_t Relays state, bit 0 - Relay1 ... bit 3 - Relay4. 1 - On.
+	*/
+	uint8_t getRelayMask(void);
 	/**
 	* @brief Set all relays in ON state.
 	*
@@ -228,7 +246,7 @@ class KMPProDinoESP32Class
 	*/
 	void setAllRelaysOff();
 	/**
-	* @brief Get relay state.
+	* @brief Get relay state, from the output latch shadow (no SPI transaction).
 	*
 	* @param relayNumber Relay number from 0 to RELAY_COUNT - 1
 	*
@@ -236,7 +254,7 @@ class KMPProDinoESP32Class
 	*/
 	bool getRelayState(uint8_t relayNumber);
 	/**
-	* @brief Get relay state.
+	* @brief Get relay state, from the output latch shadow (no SPI transaction).
 	*
 	* @param relay Relay1, Relay2 ...
 	*
@@ -265,6 +283,55 @@ class KMPProDinoESP32Class
 
 	uint8_t getOptoInState(void);
 
+	/**
+	* @brief Enable the interrupt-on-change of all opto inputs. The expander INT output (IO36) is asserted
+	*        at each change and released by the next opto input reading.
+	*
+	* @param handler Function called in interrupt context at each change. Must be in IRAM.
+	*
+	* @return void
+	*/
+	void attachOptoInInterrupt(void (*handler)(void));
+
+	/**
+	* @brief Read all the opto inputs with a single SPI transaction and store them in the opto in image, to be called
+	*        once per control tick. Also count the SPI transactions of the previous tick.
+	*
+	* @return uint8_t The image, bit 0 - OptoIn1 ... bit 3 - OptoIn4. 1 - opto in is On.
+	*/
+	uint8_t updateOptoInImage(void);
+	/**
+	* @brief Get opto in state from the opto in image, without SPI transactions.
+	*
+	* @param optoInNumber OptoIn number from 0 to OPTOIN_COUNT - 1
+	*
+	* @return bool true - opto in is On, false is Off. If number is out of range - return false.
+	*/
+	bool getOptoInImageState(uint8_t optoInNumber);
+	/**
+	* @brief Get opto in state from the opto in image, without SPI transactions.
+	*
+	* @param optoIn OptoIn1, OptoIn2 ...
+	*
+	* @return bool true - opto in is On, false is Off.
+	*/
+	bool getOptoInImageState(OptoIn optoIn);
+	/**
+	* @brief Get the time of the last opto in image update.
+	*
+	* @return unsigned long millis() of the update.
+	*/
+	unsigned long getOptoInImageTime(void);
+	/**
+	* @brief Get the SPI transactions with the expander between the last two opto in image updates (i.e. in the last
+	*        control tick, from all the tasks).
+	*
+	* @param maxValue true - the max value since start up, false - the last value.
+	*
+	* @return uint32_t Transactions count.
+	*/
+	uint32_t getTickSpiTransactions(bool maxValue = false);
+
 	/**
 	* @brief Connect to RS485. With default configuration SERIAL_8N1.
 	*
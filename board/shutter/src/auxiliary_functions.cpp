@@ -58,9 +58,12 @@ void flashLed(const uint32_t &_color, const int &_delayInterval) {
 //////////
 
 ShutterStatus getShutterStatus() {
-    if (IS_OPENING)
+    // a motion in progress is reported also while the relays are off before reversing
+    const ShutterMotionStatus motion{shutterMotionStatus()};
+    const bool moving{motion.state == ShutterMotion::Starting || motion.state == ShutterMotion::Travelling || motion.state == ShutterMotion::Seating};
+    if (IS_OPENING || (moving && motion.direction == ShutterIntent::Open))
         return ShutterStatus::Opening;
-    else if (IS_CLOSING)
+    else if (IS_CLOSING || (moving && motion.direction == ShutterIntent::Close))
         return ShutterStatus::Closing;
     else if (OPENED_SENSOR)
         return ShutterStatus::Opened;
@@ -72,6 +75,203 @@ ShutterStatus getShutterStatus() {
 
 //////////
 
+// pending intents, executed by the loop
+QueueHandle_t shutter_intents{xQueueCreate(SHUTTER_INTENT_QUEUE_SIZE, sizeof(ShutterIntent))};
+// motion status, written by the loop and protected by shutter_motion_mux
+ShutterMotionStatus shutter_motion{ShutterMotion::Idle, ShutterIntent::None, false, 0};
+portMUX_TYPE shutter_motion_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// change the motion state, to be called only by the loop
+void setShutterMotion(const ShutterMotion _state, const ShutterIntent _direction, const bool _sensor_released) {
+    portENTER_CRITICAL(&shutter_motion_mux);
+    shutter_motion = ShutterMotionStatus{_state, _direction, _sensor_released, millis()};
+    portEXIT_CRITICAL(&shutter_motion_mux);
+    logMessage("shutterMotion", _direction == ShutterIntent::Open ? "open" : "close", shutterMotionName(_state));
+}
+
+// stop the motion and trigger the hardware alert status
+void faultShutterMotion(const ShutterMotionStatus &_motion, const char *_description) {
+    KMPProDinoESP32.setAllRelaysOff();
+    EEPROM.writeBool(EEPROM_ALERT_STATUS_ADDRESS, (hardware_alert_status = true));
+    if (strcmp(hardware_alert_status_description, "") == 0) {
+        snprintf(hardware_alert_status_description, sizeof(hardware_alert_status_description), "%s", _description);
+        EEPROM.writeString(EEPROM_ALERT_STATUS_DESCRIPTION_ADDRESS, hardware_alert_status_description);
+    }
+    EEPROM.commit();
+    logMessage("shutterMotion", String{"ERROR: "} + _description);
+    setShutterMotion(ShutterMotion::Fault, _motion.direction, _motion.sensor_released);
+}
+
+// execute an intent, to be called only by the loop
+void applyShutterIntent(const ShutterIntent _intent) {
+    const ShutterMotionStatus motion{shutterMotionStatus()};
+    const bool moving{motion.state == ShutterMotion::Starting || motion.state == ShutterMotion::Travelling || motion.state == ShutterMotion::Seating};
+    if (_intent == ShutterIntent::Abort) {
+        KMPProDinoESP32.setAllRelaysOff();
+        if (moving) setShutterMotion(ShutterMotion::Stopped, motion.direction, motion.sensor_released);
+        return;
+    }
+    // the checks of the web server are repeated, since the intent can be executed later
+    if (!AUTO || hardware_alert_status) {
+        logMessage("shutterMotion", "Intent discarded: manual mode or alert status");
+        return;
+    }
+    // already moving in the same direction, or already there
+    if (moving && motion.direction == _intent) return;
+    if (!moving && (_intent == ShutterIntent::Open ? OPENED_SENSOR : CLOSED_SENSOR)) return;
+    // reverse: relays off, the motor starts after SHUTTER_REVERSE_TIME
+    if (MOVEMENT_STATUS) {
+        KMPProDinoESP32.setAllRelaysOff();
+        setShutterMotion(ShutterMotion::Starting, _intent, false);
+        return;
+    }
+    start_movement_time = millis();
+    KMPProDinoESP32.setRelayState(_intent == ShutterIntent::Open ? OPENING_MOTOR : CLOSING_MOTOR, true);
+    setShutterMotion(ShutterMotion::Travelling, _intent, false);
+}
+
+void advanceShutterMotion() {
+    // intents, in submission order
+    ShutterIntent intent{};
+    while (xQueueReceive(shutter_intents, &intent, 0) == pdTRUE) applyShutterIntent(intent);
+
+    const ShutterMotionStatus motion{shutterMotionStatus()};
+    const unsigned long now{millis()};
+    const bool opening{motion.direction == ShutterIntent::Open};
+    switch (motion.state) {
+        case ShutterMotion::Starting:
+            if (!AUTO) {
+                setShutterMotion(ShutterMotion::Stopped, motion.direction, motion.sensor_released);
+            } else if (now - motion.state_time >= SHUTTER_REVERSE_TIME) {
+                start_movement_time = now;
+                KMPProDinoESP32.setRelayState(opening ? OPENING_MOTOR : CLOSING_MOTOR, true);
+                setShutterMotion(ShutterMotion::Travelling, motion.direction, false);
+            }
+            break;
+        case ShutterMotion::Travelling:
+            if (!AUTO) {
+                // the relays are turned off by the loop manual handling
+                setShutterMotion(ShutterMotion::Stopped, motion.direction, motion.sensor_released);
+            } else if (!motion.sensor_released) {
+                // the starting limit switch must release within SENSOR_TOGGLING_TIME
+                if (!(opening ? CLOSED_SENSOR : OPENED_SENSOR)) {
+                    portENTER_CRITICAL(&shutter_motion_mux);
+                    shutter_motion.sensor_released = true;
+                    portEXIT_CRITICAL(&shutter_motion_mux);
+                } else if (now - start_movement_time > SENSOR_TOGGLING_TIME) {
+                    faultShutterMotion(motion, opening ? "the closing limit switch sensor did not toggle in time during the opening procedure" : "the opening limit switch sensor did not toggle in time during the closing procedure");
+                }
+            } else if (opening ? OPENED_SENSOR : CLOSED_SENSOR) {
+                // the sensors become true BEFORE the full closure or aperture
+                logMessage("shutterMotion", "Stopping shutter...");
+                setShutterMotion(ShutterMotion::Seating, motion.direction, true);
+            } else if (now - start_movement_time > ALERT_STATUS_WAIT) {
+                faultShutterMotion(motion, "the shutter did not stop within the maximum time");
+            }
+            break;
+        case ShutterMotion::Seating:
+            if (!AUTO) {
+                setShutterMotion(ShutterMotion::Stopped, motion.direction, true);
+            } else if (now - motion.state_time >= SENSOR_TOGGLING_TIME) {
+                KMPProDinoESP32.setAllRelaysOff();
+                logMessage("shutterMotion", "Shutter stopped");
+                setShutterMotion(ShutterMotion::Stopped, motion.direction, true);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+ShutterMotionStatus shutterMotionStatus() {
+    portENTER_CRITICAL(&shutter_motion_mux);
+    const ShutterMotionStatus motion{shutter_motion};
+    portEXIT_CRITICAL(&shutter_motion_mux);
+    return motion;
+}
+
+const char *shutterMotionName(const ShutterMotion _state) {
+    switch (_state) {
+        case ShutterMotion::Idle:
+            return "idle";
+        case ShutterMotion::Starting:
+            return "starting";
+        case ShutterMotion::Travelling:
+            return "travelling";
+        case ShutterMotion::Seating:
+            return "seating";
+        case ShutterMotion::Stopped:
+            return "stopped";
+        case ShutterMotion::Fault:
+        default:
+            return "fault";
+    }
+}
+
+bool submitShutterIntent(const ShutterIntent _intent) {
+    if (xQueueSend(shutter_intents, &_intent, 0) != pdTRUE) {
+        logMessage("submitShutterIntent", "Error: intent queue full");
+        return false;
+    }
+    // wake up the loop, it executes the intent at once
+    if (loop_task_handle != NULL) xTaskNotifyGive(loop_task_handle);
+    return true;
+}
+
+//////////
+
+// status snapshot, written only by the loop and protected by status_record_mux
+StatusRecord status_record{};
+portMUX_TYPE status_record_mux = portMUX_INITIALIZER_UNLOCKED;
+
+void publishStatusRecord() {
+    // zero the padding too, since the values are compared as raw bytes
+    StatusValues values;
+    memset(&values, 0, sizeof(values));
+    values.shutter_status = getShutterStatus();
+    const ShutterMotionStatus motion{shutterMotionStatus()};
+    values.motion_state = motion.state;
+    values.motion_direction = motion.direction;
+    values.lock_movement = lock_movement;
+    values.network_status = network_connection_status;
+    values.hardware_alert = hardware_alert_status;
+    strncpy(values.hardware_alert_description, hardware_alert_status_description, sizeof(values.hardware_alert_description) - 1);
+    values.network_alert = network_alert_status;
+    values.security_procedures = EP_status;
+    values.relays = KMPProDinoESP32.getRelayMask();
+    for (int i{}; i < 4; ++i)
+        if (KMPProDinoESP32.getOptoInImageState(i)) values.optoins |= 1 << i;
+    values.spi_per_tick = KMPProDinoESP32.getTickSpiTransactions();
+    values.spi_per_tick_max = KMPProDinoESP32.getTickSpiTransactions(true);
+    const InputLatencyStats input_latency{inputLatencyStats()};
+    values.latency_last_us = input_latency.last_us;
+    values.latency_max_us = input_latency.max_us;
+    values.reactions = input_latency.count;
+
+    // new version only if something changed, or to refresh uptime and ages (only the loop writes the record)
+    const unsigned long now{millis()};
+    const bool changed{status_record.version == 0 || memcmp(&values, &status_record.values, sizeof(values)) != 0};
+    if (!changed && now - status_record.time < STATUS_REFRESH_INTERVAL) return;
+    portENTER_CRITICAL(&status_record_mux);
+    ++status_record.version;
+    if (changed) status_record.change_version = status_record.version;
+    status_record.time = now;
+    status_record.motion_time = motion.state_time;
+    status_record.image_time = KMPProDinoESP32.getOptoInImageTime();
+    status_record.values = values;
+    portEXIT_CRITICAL(&status_record_mux);
+    if (status_task_handle != NULL) xTaskNotifyGive(status_task_handle);
+}
+
+StatusRecord statusRecord() {
+    portENTER_CRITICAL(&status_record_mux);
+    const StatusRecord record{status_record};
+    portEXIT_CRITICAL(&status_record_mux);
+    return record;
+}
+
+//////////
+
 // semaphore for serial log, to avoid serial concurrent writing
 SemaphoreHandle_t xSemaphore_log{xSemaphoreCreateMutex()};
 // buffer for logging messages
@@ -141,6 +341,62 @@ void logMessage(const char *_identifier1, const T &_identifier2, const V &_msg)
 
 //////////
 
+// micros() of the first input change not yet seen by the loop, 0 if none (written by the interrupt handler)
+std::atomic<uint32_t> input_change_time{0};
+// micros() of the input change that woke the current loop pass, 0 if none or already probed
+uint32_t input_pass_time{0};
+// reaction time statistics, protected by input_latency_mux
+InputLatencyStats input_latency_stats{};
+portMUX_TYPE input_latency_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Interrupt handler of the optoin changes.
+ */
+void IRAM_ATTR inputChangeISR() {
+    // 0 means no change, so the (very unlikely) 0 timestamp is moved by 1 us
+    const uint32_t now{static_cast<uint32_t>(micros())};
+    uint32_t expected{0};
+    input_change_time.compare_exchange_strong(expected, now != 0 ? now : 1);
+    BaseType_t higher_priority_task_woken{pdFALSE};
+    vTaskNotifyGiveFromISR(loop_task_handle, &higher_priority_task_woken);
+    if (higher_priority_task_woken) portYIELD_FROM_ISR();
+}
+
+InputLatencyStats inputLatencyStats() {
+    portENTER_CRITICAL(&input_latency_mux);
+    const InputLatencyStats stats{input_latency_stats};
+    portEXIT_CRITICAL(&input_latency_mux);
+    return stats;
+}
+
+void probeInputLatency() {
+    if (input_pass_time == 0) return;
+    const uint32_t latency{static_cast<uint32_t>(micros()) - input_pass_time};
+    input_pass_time = 0;
+    portENTER_CRITICAL(&input_latency_mux);
+    input_latency_stats.last_us = latency;
+    input_latency_stats.max_us = max(input_latency_stats.max_us, latency);
+    ++input_latency_stats.count;
+    portEXIT_CRITICAL(&input_latency_mux);
+}
+
+void startInputInterrupts() {
+    loop_task_handle = xTaskGetCurrentTaskHandle();
+    KMPProDinoESP32.attachOptoInInterrupt(inputChangeISR);
+    KMPProDinoESP32.updateOptoInImage();
+}
+
+bool waitInputChange(const TickType_t _timeout) {
+    // the changes happened while the loop was busy are pending notifications, so they are returned immediately
+    const bool changed{ulTaskNotifyTake(pdTRUE, _timeout) > 0};
+    input_pass_time = input_change_time.exchange(0);
+    // new control tick: every input macro is served from this snapshot
+    KMPProDinoESP32.updateOptoInImage();
+    return changed;
+}
+
+//////////
+
 void startOTA() {
     ArduinoOTA.setHostname(HOSTNAME);
     ArduinoOTA.setPassword(OTA_PASSWORD);
@@ -35,6 +35,8 @@ bool blink_led_loop{true};
 
 SemaphoreHandle_t xSemaphore{xSemaphoreCreateMutex()};
 
+TaskHandle_t loop_task_handle{NULL};
+
 bool hardware_alert_status{};
 char hardware_alert_status_description[ALERT_STATUS_DESCRIPTION_SIZE]{};
 unsigned long start_movement_time{millis()};
@@ -44,8 +46,13 @@ bool network_alert_status{false};
 
 EmergencyProcedure EP_status{EmergencyProcedure::NotNeeded};
 
+bool lock_movement{false};
+
 AsyncWebServer WebServer{80};
 AsyncEventSource SSELogger{"/log_sse"};
+AsyncEventSource StatusSSE{"/status_sse"};
+
+TaskHandle_t status_task_handle{NULL};
 
 //////////
 
@@ -59,6 +66,7 @@ void setup() {
     logMessage("setup", "Setup board");
     KMPProDinoESP32.begin(ProDino_ESP32_Ethernet, false, false);
     KMPProDinoESP32.setStatusLed(yellow);
+    startInputInterrupts();
 
     // EEPROM
     logMessage("setup", "Reading EEPROM");
@@ -84,6 +92,11 @@ void setup() {
     startOTA();
     // start network task
     xTaskCreateUniversal(net_task, "net_task", 4096, NULL, 2, NULL, NET_TASK_CORE);
+    // start status task, that pushes the status events
+    xTaskCreateUniversal(status_task, "status_task", 4096, NULL, 1, &status_task_handle, -1);
+
+    // first status snapshot, then refreshed by the loop
+    publishStatusRecord();
 
     // end
     logMessage("setup", "End SETUP, starting LOOP");
@@ -92,44 +105,25 @@ void setup() {
 //////////
 
 void loop() {
-    delay(100);
+    // next pass at the first input change, or after LOOP_INTERVAL
+    waitInputChange(LOOP_INTERVAL);
     // blink led on/off every two seconds
     if (blink_led_loop) KMPProDinoESP32.processStatusLed(blue, 1000);
 
     if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(50)) == pdTRUE) {
-        // handle auto
-        if (AUTO) {
-            // security control
-            if (MOVEMENT_STATUS && (millis() - start_movement_time) > ALERT_STATUS_WAIT) {
-                KMPProDinoESP32.setAllRelaysOff();
-                EEPROM.writeBool(EEPROM_ALERT_STATUS_ADDRESS, (hardware_alert_status = true));
-                if (strcmp(hardware_alert_status_description, "") == 0) {
-                    snprintf(hardware_alert_status_description, sizeof(hardware_alert_status_description), "the shutter did not stop within the maximum time");
-                    logMessage("loop", String{"ERROR: "} + hardware_alert_status_description);
-                    EEPROM.writeString(EEPROM_ALERT_STATUS_DESCRIPTION_ADDRESS, hardware_alert_status_description);
-                }
-                EEPROM.commit();
-                logMessage("loop", "ERROR: alert status");
-            }
-            // standard handle
-            if (MOVEMENT_STATUS && (CLOSED_SENSOR || OPENED_SENSOR)) {
-                logMessage("loop", "Stopping shutter...");
-                // empirical time to let both motors close or open
-                /* DO NOT EXTRACT THIS DELAY FROM THE INSIDE OF THE MUTEX!
-                 * The mutex must be acquired to allow the closure (or
-                 * aperture) to be fully completed (the sensors become
-                 * true BEFORE the complete the full closure or aperture). */
-                const unsigned long t{millis()};
-                while (AUTO && (millis() - t) < SENSOR_TOGGLING_TIME) delay(50);
-                KMPProDinoESP32.setAllRelaysOff();
-                logMessage("loop", "Shutter stopped");
-            }
-        }
+        // handle auto: intents, sensors and deadlines of the shutter motion (a motion in progress is stopped in
+        // manual mode)
+        advanceShutterMotion();
         // handle manual
-        else if (MOVEMENT_STATUS) {
+        if (!AUTO && MOVEMENT_STATUS) {
+            const uint32_t spi_start{MCP23S08.GetTransactionCount()};
             KMPProDinoESP32.setAllRelaysOff();
-            logMessage("loop", "Shutter moving in manual mode, turning off relays");
+            probeInputLatency();
+            const uint32_t spi_transactions{MCP23S08.GetTransactionCount() - spi_start};
+            logMessage("loop", String{"Shutter moving in manual mode, turning off relays ("} + spi_transactions + " SPI transactions)");
         }
+        // status snapshot for the web server, with the values of this tick
+        publishStatusRecord();
         xSemaphoreGive(xSemaphore);
     }
 }
@@ -224,35 +218,11 @@ void net_task(void* _parameter) {
                 EP_status = EmergencyProcedure::Running;
             }
             network_alert_status = true;
-            if (!CLOSED_SENSOR && !IS_CLOSING && !hardware_alert_status) {
+            // same path of the close command, the loop executes the motion
+            if (!CLOSED_SENSOR && getShutterStatus() != ShutterStatus::Closing && !hardware_alert_status) {
                 logMessage("net_task", "EP | shutter", "Closing shutter...");
                 EP_status = EmergencyProcedure::Running;
-                if (xSemaphoreTake(xSemaphore, portMAX_DELAY) == pdTRUE) {
-                    if (MOVEMENT_STATUS) {
-                        KMPProDinoESP32.setAllRelaysOff();
-                        delay(150);
-                    }
-                    start_movement_time = millis();
-                    KMPProDinoESP32.setRelayState(CLOSING_MOTOR, true);
-                    // let the opening sensor change
-                    /* DO NOT EXTRACT THIS DELAY FROM THE INSIDE OF THE MUTEX!
-                     * The mutex must be acquired in order to block the loop
-                     * shutter handle until the sensor is changed. */
-                    const unsigned long t{millis()};
-                    while (OPENED_SENSOR && AUTO) {
-                        delay(50);
-                        // safety stop
-                        if ((millis() - t) > SENSOR_TOGGLING_TIME) {
-                            snprintf(hardware_alert_status_description, sizeof(hardware_alert_status_description), "the opening limit switch sensor did not toggle in time during the closing procedure");
-                            logMessage("net_task", "EP | shutter", String{"ERROR: "} + hardware_alert_status_description);
-                            EEPROM.writeString(EEPROM_ALERT_STATUS_DESCRIPTION_ADDRESS, hardware_alert_status_description);
-                            EEPROM.commit();
-                            start_movement_time -= ALERT_STATUS_WAIT;
-                            break;
-                        }
-                    }
-                    xSemaphoreGive(xSemaphore);
-                }
+                submitShutterIntent(ShutterIntent::Close);
             }
             if (CLOSED_SENSOR)
                 EP_status = EmergencyProcedure::Completed;
@@ -261,3 +231,13 @@ void net_task(void* _parameter) {
         }
     }
 }
+
+//////////
+
+void status_task(void* _parameter) {
+    for (;;) {
+        // woken by the loop at each new status version, or at the heartbeat interval
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STATUS_SSE_HEARTBEAT));
+        pushStatusEvents();
+    }
+}
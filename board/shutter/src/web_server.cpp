@@ -28,85 +28,768 @@ SOFTWARE.
 */
 
 #include "global_definitions.hpp"
+// generated by web_assets.py in the build directory
+#include "web_assets_bundle.h"
 
 //////////
 
 /**
- * @brief Return true if unknown client IP, else false; used for web auth.
+ * @brief Return the web asset of an url, or nullptr if not found.
  */
-bool unknown_IP(const String &clientIP) {
-    return clientIP != "authorized_ip_1" &&  // TODO put your authorized IP address here
-           clientIP != "authorized_ip_2";    // TODO put your authorized IP address here
+const WebAsset *findWebAsset(const char *_url) {
+    const WebAsset &asset{web_assets[fnv1aHash(_url, WEB_ASSETS_SEED) >> (32 - WEB_ASSETS_SLOT_BITS)]};
+    return asset.url != nullptr && strcmp(asset.url, _url) == 0 ? &asset : nullptr;
+}
+
+/**
+ * @brief Send a web asset, gzipped, straight from flash: the immutable ones are cached for a year, the others are
+ * revalidated with their ETag (304 if not modified). A not empty _set_cookie is added as Set-Cookie header.
+ */
+void sendWebAsset(AsyncWebServerRequest *request, const WebAsset &_asset, const char *_set_cookie = "") {
+    if (!_asset.immutable && request->hasHeader("If-None-Match") && request->header("If-None-Match") == _asset.etag) {
+        AsyncWebServerResponse *response{request->beginResponse(304)};
+        response->addHeader("ETag", _asset.etag);
+        if (*_set_cookie != 0) response->addHeader("Set-Cookie", _set_cookie);
+        request->send(response);
+    } else {
+        AsyncWebServerResponse *response{request->beginResponse_P(200, _asset.type, _asset.data, _asset.length)};
+        response->addHeader("Content-Encoding", "gzip");
+        if (_asset.immutable) {
+            response->addHeader("Cache-Control", WEB_ASSETS_CACHE_CONTROL);
+        } else {
+            response->addHeader("Cache-Control", "no-cache");
+            response->addHeader("ETag", _asset.etag);
+        }
+        if (*_set_cookie != 0) response->addHeader("Set-Cookie", _set_cookie);
+        request->send(response);
+    }
+    logMessage("ESPAsyncWebServer", request->url(), "");
+}
+
+//////////
+
+// trusted address ranges, network and mask in the IPAddress representation (set only by the async tcp task)
+struct WebAllowlistEntry {
+    uint32_t network;
+    uint32_t mask;
+};
+WebAllowlistEntry web_allowlist[WEB_ALLOWLIST_SIZE]{};
+int web_allowlist_size{};
+// key of the session tokens, drawn at boot (the tokens do not survive a restart)
+uint8_t web_session_key[32]{};
+
+/**
+ * @brief Parse an IPv4 CIDR range ("a.b.c.d/n", or "a.b.c.d" for a single address), return false if not valid (/0,
+ * every address, is not valid).
+ */
+bool parseCIDR(const char *_cidr, WebAllowlistEntry &_entry) {
+    const char *slash{strchr(_cidr, '/')};
+    const int prefix{slash == nullptr ? 32 : atoi(slash + 1)};
+    IPAddress address{};
+    if (!address.fromString(slash == nullptr ? String{_cidr} : String{_cidr}.substring(0, slash - _cidr)) || prefix < 1 || prefix > 32) return false;
+    const uint32_t mask{0xFFFFFFFFu << (32 - prefix)};
+    _entry.mask = static_cast<uint32_t>(IPAddress(mask >> 24, mask >> 16 & 0xFF, mask >> 8 & 0xFF, mask & 0xFF));
+    _entry.network = static_cast<uint32_t>(address) & _entry.mask;
+    return true;
+}
+
+/**
+ * @brief Write a CIDR range in _cidr (at least 19 characters).
+ */
+void formatCIDR(const WebAllowlistEntry &_entry, char *_cidr) {
+    const IPAddress address{_entry.network}, mask{_entry.mask};
+    int prefix{};
+    for (int i{}; i < 4; ++i) prefix += __builtin_popcount(mask[i]);
+    snprintf(_cidr, 19, "%u.%u.%u.%u/%d", address[0], address[1], address[2], address[3], prefix);
+}
+
+/**
+ * @brief Load the allowlist from NVS, or the default one if never set.
+ */
+void loadWebAllowlist() {
+    Preferences preferences{};
+    preferences.begin("web-auth", true);
+    const size_t length{preferences.getBytesLength("allowlist")};
+    if (length != 0 && length <= sizeof(web_allowlist) && length % sizeof(WebAllowlistEntry) == 0) {
+        web_allowlist_size = preferences.getBytes("allowlist", web_allowlist, length) / sizeof(WebAllowlistEntry);
+    } else {
+        web_allowlist_size = 0;
+        for (const char *cidr : WEB_ALLOWLIST_DEFAULT)
+            if (web_allowlist_size < WEB_ALLOWLIST_SIZE && parseCIDR(cidr, web_allowlist[web_allowlist_size])) ++web_allowlist_size;
+    }
+    preferences.end();
+    logMessage("loadWebAllowlist", String{web_allowlist_size} + " address ranges");
+}
+
+/**
+ * @brief Save the allowlist in NVS.
+ */
+void saveWebAllowlist() {
+    Preferences preferences{};
+    preferences.begin("web-auth", false);
+    preferences.putBytes("allowlist", web_allowlist, web_allowlist_size * sizeof(WebAllowlistEntry));
+    preferences.end();
+}
+
+/**
+ * @brief HMAC-SHA256 of a session token (expiry time and client address).
+ */
+void webSessionMAC(const uint32_t _expiry, const uint32_t _address, uint8_t (&_mac)[32]) {
+    const uint32_t message[2]{_expiry, _address};
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), web_session_key, sizeof(web_session_key), reinterpret_cast<const uint8_t *>(message), sizeof(message), _mac);
+}
+
+/**
+ * @brief Return true if the request has a valid session token for its client address, in the session cookie
+ * ("<expiry, 8 hex digits><first 16 bytes of the MAC, 32 hex digits>").
+ */
+bool validWebSession(AsyncWebServerRequest *request, const uint32_t _address) {
+    if (!request->hasHeader("Cookie")) return false;
+    // the cookie name only at the start of the header or after "; " (not e.g. in "xsession=")
+    const char *token{request->getHeader("Cookie")->value().c_str()};
+    while (token != nullptr && strncmp(token, WEB_SESSION_COOKIE "=", sizeof(WEB_SESSION_COOKIE)) != 0) {
+        token = strstr(token, "; ");
+        if (token != nullptr) token += 2;
+    }
+    if (token == nullptr) return false;
+    token += sizeof(WEB_SESSION_COOKIE);
+    uint8_t bytes[20]{};
+    for (int i{}; i < 40; ++i) {
+        const char c{token[i]};
+        const int nibble{c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1};
+        if (nibble < 0) return false;
+        bytes[i / 2] = bytes[i / 2] << 4 | nibble;
+    }
+    const uint32_t expiry{static_cast<uint32_t>(bytes[0]) << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3]};
+    if (static_cast<uint32_t>(esp_timer_get_time() / 1000000) >= expiry) return false;
+    uint8_t mac[32]{};
+    webSessionMAC(expiry, _address, mac);
+    // constant time comparison
+    uint8_t difference{};
+    for (int i{}; i < 16; ++i) difference |= mac[i] ^ bytes[4 + i];
+    return difference == 0;
+}
+
+/**
+ * @brief Authenticate a web page request: the client address is in the allowlist, or the request has a valid session
+ * token, or valid Basic auth credentials, that start a new session (its Set-Cookie header is written in _set_cookie,
+ * else left empty). Return false if the client must authenticate.
+ */
+bool authenticateWebRequest(AsyncWebServerRequest *request, char (&_set_cookie)[WEB_SESSION_SET_COOKIE_SIZE]) {
+    const uint32_t address{static_cast<uint32_t>(request->client()->remoteIP())};
+    for (int i{}; i < web_allowlist_size; ++i)
+        if ((address & web_allowlist[i].mask) == web_allowlist[i].network) return true;
+    if (validWebSession(request, address)) return true;
+    if (!request->authenticate(WEBPAGE_LOGIN_USER, WEBPAGE_LOGIN_PASSWORD)) return false;
+
+    const uint32_t expiry{static_cast<uint32_t>(esp_timer_get_time() / 1000000) + WEB_SESSION_DURATION};
+    uint8_t mac[32]{};
+    webSessionMAC(expiry, address, mac);
+    int length{snprintf(_set_cookie, WEB_SESSION_SET_COOKIE_SIZE, WEB_SESSION_COOKIE "=%08x", static_cast<unsigned>(expiry))};
+    for (int i{}; i < 16; ++i) length += snprintf(_set_cookie + length, WEB_SESSION_SET_COOKIE_SIZE - length, "%02x", mac[i]);
+    snprintf(_set_cookie + length, WEB_SESSION_SET_COOKIE_SIZE - length, "; Max-Age=%d; Path=/; HttpOnly; SameSite=Strict", WEB_SESSION_DURATION);
+    return true;
+}
+
+//////////
+
+// request buckets of the clients, in thousandths of token (used only by the async tcp task, so no mutex)
+struct WebRateClient {
+    uint32_t address;  // 0 if empty slot
+    uint32_t time;     // last refill, in milliseconds
+    uint32_t tokens[WEB_RATE_CONTROL + 1];
+    uint32_t rejected;
+};
+struct WebRateLimit {
+    uint32_t rate;
+    uint32_t burst;
+};
+constexpr WebRateLimit web_rate_limits[] WEB_RATE_LIMITS;
+static_assert(sizeof(web_rate_limits) / sizeof(web_rate_limits[0]) == WEB_RATE_CONTROL + 1, "WEB_RATE_LIMITS needs a bucket per class");
+WebRateClient web_rate_clients[WEB_RATE_CLIENTS]{};
+// admission counters, see the server-limits command
+int web_requests_in_flight{};
+int web_requests_in_flight_max{};
+uint32_t web_requests_busy{};
+uint32_t web_requests_limited[WEB_RATE_CONTROL + 1]{};
+// bodies of the rejections, in flash (read after admitWebRequest returns)
+static const char web_response_busy[] PROGMEM{R"({"rsp":"Error: server busy"})"};
+static const char web_response_limited[] PROGMEM{R"({"rsp":"Error: too many requests"})"};
+
+/**
+ * @brief Admission control of a request: answer 503 if too many requests are in flight, or 429 if the client has no
+ * tokens left for the class of the request, and return false; else count the request in flight until its
+ * disconnection, and return true.
+ */
+bool admitWebRequest(AsyncWebServerRequest *request, const WebRateClass _class) {
+    /* The rejections are not logged, under a flood the log would cost more
+     * than the answer: they are only counted (server-limits command). */
+    if (web_requests_in_flight >= WEB_REQUESTS_IN_FLIGHT) {
+        ++web_requests_busy;
+        AsyncWebServerResponse *response_busy{request->beginResponse_P(503, "application/json", web_response_busy)};
+        response_busy->addHeader("Retry-After", "1");
+        request->send(response_busy);
+        return false;
+    }
+
+    // bucket of the client, or the least recently used one
+    const uint32_t address{static_cast<uint32_t>(request->client()->remoteIP())};
+    const uint32_t now{static_cast<uint32_t>(millis())};
+    WebRateClient *client{&web_rate_clients[0]};
+    for (WebRateClient &i : web_rate_clients) {
+        if (i.address == address) {
+            client = &i;
+            break;
+        }
+        if (now - i.time > now - client->time) client = &i;
+    }
+    if (client->address != address) {
+        *client = WebRateClient{address, now};
+        for (int i{}; i <= WEB_RATE_CONTROL; ++i) client->tokens[i] = web_rate_limits[i].burst * 1000;
+    } else {
+        // one minute is enough to fill any bucket, and avoids overflows
+        const uint32_t elapsed{std::min(now - client->time, static_cast<uint32_t>(60000))};
+        for (int i{}; i <= WEB_RATE_CONTROL; ++i) client->tokens[i] = std::min(client->tokens[i] + elapsed * web_rate_limits[i].rate, web_rate_limits[i].burst * 1000);
+        client->time = now;
+    }
+
+    if (client->tokens[_class] < 1000) {
+        ++client->rejected;
+        ++web_requests_limited[_class];
+        AsyncWebServerResponse *response_limited{request->beginResponse_P(429, "application/json", web_response_limited)};
+        response_limited->addHeader("Retry-After", "1");  // refill of at least one token per second
+        request->send(response_limited);
+        return false;
+    }
+    client->tokens[_class] -= 1000;
+    web_requests_in_flight_max = std::max(++web_requests_in_flight, web_requests_in_flight_max);
+    request->onDisconnect([]() { --web_requests_in_flight; });
+    return true;
 }
 
 //////////
 
-#define JSON_S_SIZE 700
+#define JSON_S_SIZE 1024
 // status json, allocated in global stack
 StaticJsonDocument<JSON_S_SIZE> json_status{};
-// status string for json_status serialization
-String response_status{};
-// semaphore for status json, to avoid too much allocations
+/* Serialized status of the last StatusRecord version. It is never modified,
+ * but replaced at the next version: the responses still being sent keep their
+ * own reference. */
+std::shared_ptr<const String> status_buffer{};
+uint32_t status_buffer_version{};
+// random number drawn at boot, so an ETag is never reused after a restart
+uint32_t status_boot_id{};
+// last status sent to the StatusSSE clients (nullptr if no client), and its json to compute the deltas
+std::shared_ptr<const String> status_sse_buffer{};
+uint32_t status_sse_version{};
+StaticJsonDocument<JSON_S_SIZE> json_status_sse{};
+unsigned long status_sse_time{};
+// delta json, allocated in global stack
+StaticJsonDocument<JSON_S_SIZE> json_status_delta{};
+// semaphore for the status buffers and jsons, shared by the web server and the status task
 SemaphoreHandle_t xSemaphore_status{xSemaphoreCreateMutex()};
 
-// lock dome movement
-bool lock_movement{false};
+// pending status-wait requests, counted by a StatusWaiter held by their response (deleted also at disconnection)
+int status_waiters{};
+struct StatusWaiter {
+    StatusWaiter() { ++status_waiters; }
+    ~StatusWaiter() { --status_waiters; }
+};
+
+/**
+ * @brief Get the serialized status, serializing the StatusRecord only if its version changed. To be called with
+ * xSemaphore_status taken.
+ */
+std::shared_ptr<const String> statusBuffer(uint32_t &_version) {
+    const StatusRecord record{statusRecord()};
+    _version = record.version;
+    if (status_buffer && status_buffer_version == record.version) return status_buffer;
+
+    const StatusValues &values{record.values};
+    json_status.clear();
+    json_status["rsp"]["firmware-version"] = FIRMWARE_VERSION;
+    json_status["rsp"]["uptime"] = uptime_formatter::getUptime();
+    json_status["rsp"]["shutter-status"] = static_cast<int>(values.shutter_status);
+    json_status["rsp"]["movement-status"] = (values.relays >> static_cast<int>(OPENING_MOTOR) & 1) == 1 || (values.relays >> static_cast<int>(CLOSING_MOTOR) & 1) == 1;
+    json_status["rsp"]["motion"]["state"] = shutterMotionName(values.motion_state);
+    json_status["rsp"]["motion"]["direction"] = values.motion_direction == ShutterIntent::Open ? "open" : (values.motion_direction == ShutterIntent::Close ? "close" : "none");
+    json_status["rsp"]["motion"]["age"] = record.time - record.motion_time;
+    json_status["rsp"]["lock-movement"] = values.lock_movement;
+    json_status["rsp"]["network-status"] = values.network_status;
+    json_status["rsp"]["alert"]["hardware"]["status"] = values.hardware_alert;
+    json_status["rsp"]["alert"]["hardware"]["description"] = values.hardware_alert_description;
+    json_status["rsp"]["alert"]["network"]["status"] = values.network_alert;
+    json_status["rsp"]["alert"]["network"]["security-procedures"] = static_cast<int>(values.security_procedures);
+    for (int i{}; i < 4; ++i) json_status["rsp"]["relay"]["list"][i] = (values.relays >> i & 1) == 1;
+    json_status["rsp"]["relay"]["opening-motor"] = (values.relays >> static_cast<int>(OPENING_MOTOR) & 1) == 1;
+    json_status["rsp"]["relay"]["closing-motor"] = (values.relays >> static_cast<int>(CLOSING_MOTOR) & 1) == 1;
+    for (int i{}; i < 4; ++i) json_status["rsp"]["optoin"]["list"][i] = (values.optoins >> i & 1) == 1;
+    json_status["rsp"]["optoin"]["auto"] = (values.optoins >> static_cast<int>(OptoIn::OptoIn1) & 1) == 1;
+    json_status["rsp"]["optoin"]["closed-sensor"] = (values.optoins >> static_cast<int>(OptoIn::OptoIn2) & 1) == 1;
+    json_status["rsp"]["optoin"]["opened-sensor"] = (values.optoins >> static_cast<int>(OptoIn::OptoIn3) & 1) == 1;
+    json_status["rsp"]["io-image"]["age"] = record.time - record.image_time;
+    json_status["rsp"]["io-image"]["spi-per-tick"] = values.spi_per_tick;
+    json_status["rsp"]["io-image"]["spi-per-tick-max"] = values.spi_per_tick_max;
+    json_status["rsp"]["input-latency"]["last-us"] = values.latency_last_us;
+    json_status["rsp"]["input-latency"]["max-us"] = values.latency_max_us;
+    json_status["rsp"]["input-latency"]["reactions"] = values.reactions;
+    json_status["rsp"]["wifi"]["hostname"] = HOSTNAME;
+    json_status["rsp"]["wifi"]["mac-address"] = WiFi.macAddress();
+    json_status["rsp"]["version"] = record.version;
+
+    String buffer{};
+    buffer.reserve(JSON_S_SIZE);
+    serializeJson(json_status, buffer);
+    status_buffer = std::make_shared<const String>(std::move(buffer));
+    status_buffer_version = record.version;
+    return status_buffer;
+}
+
+/**
+ * @brief Weak ETag of a status version.
+ */
+String statusETag(const uint32_t _version) {
+    char etag[24];
+    snprintf(etag, sizeof(etag), "W/\"%08x-%u\"", status_boot_id, _version);
+    return etag;
+}
+
+/**
+ * @brief Add to _delta the fields of _current that differ from _previous, with the same nesting (the arrays are
+ * added whole). The keys are linked, not copied: all the status keys are string literals.
+ */
+void statusDelta(JsonObjectConst _previous, JsonObjectConst _current, JsonObject _delta) {
+    for (JsonPairConst field : _current) {
+        const char *key{field.key().c_str()};
+        const JsonVariantConst previous{_previous[key]};
+        if (field.value().is<JsonObjectConst>() && previous.is<JsonObjectConst>()) {
+            JsonObject nested{_delta.createNestedObject(key)};
+            statusDelta(previous.as<JsonObjectConst>(), field.value().as<JsonObjectConst>(), nested);
+            if (nested.size() == 0) _delta.remove(key);
+        } else if (field.value() != previous) {
+            _delta[key] = field.value();
+        }
+    }
+}
+
+void pushStatusEvents() {
+    if (xSemaphoreTake(xSemaphore_status, pdMS_TO_TICKS(50)) != pdTRUE) return;
+    if (StatusSSE.count() == 0) {
+        // nothing to serialize without clients, the next one starts from a new snapshot
+        status_sse_buffer.reset();
+    } else if (status_sse_buffer) {
+        uint32_t version{};
+        const std::shared_ptr<const String> buffer{statusBuffer(version)};
+        if (version != status_sse_version) {
+            json_status_delta.clear();
+            statusDelta(json_status_sse.as<JsonObjectConst>(), json_status.as<JsonObjectConst>(), json_status_delta.to<JsonObject>());
+            String delta{};
+            serializeJson(json_status_delta, delta);
+            StatusSSE.send(delta.c_str(), "delta", version);
+            status_sse_buffer = buffer;
+            status_sse_version = version;
+            json_status_sse = json_status;
+            status_sse_time = millis();
+        } else if (millis() - status_sse_time >= STATUS_SSE_HEARTBEAT) {
+            StatusSSE.send(String{version}.c_str(), "heartbeat", version);
+            status_sse_time = millis();
+        }
+    }
+    xSemaphoreGive(xSemaphore_status);
+}
 
 // variable for disabling webserver logging
 bool webserver_logging{false};
 
 //////////
 
-void startWebServer() {
-    /////////////
-    // WEBPAGES
+// dispatch statistics of a command, only accessed by the async tcp task
+struct ApiCommandStats {
+    uint32_t calls;
+    uint64_t total_us;
+    uint32_t max_us;
+};
+
+/* shutter-related functions */
+
+void apiAbort(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    if (!submitShutterIntent(ShutterIntent::Abort)) {
+        json["rsp"] = "Error: intent queue full";
+    } else {
+        json["rsp"] = "done";
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    WebServer.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (unknown_IP(request->client()->remoteIP().toString()) && !request->authenticate(WEBPAGE_LOGIN_USER, WEBPAGE_LOGIN_PASSWORD))
-            return request->requestAuthentication();
-        request->send(SPIFFS, "/dashboard.html", "text/html");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiClose(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    if (getShutterStatus() == ShutterStatus::Closed || getShutterStatus() == ShutterStatus::Closing) {
+        json["rsp"] = "done";
+    } else if (!submitShutterIntent(ShutterIntent::Close)) {
+        json["rsp"] = "Error: intent queue full";
+    } else {
+        json["rsp"] = "done";
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    WebServer.on("/log", HTTP_GET, [](AsyncWebServerRequest *request) {
-        if (unknown_IP(request->client()->remoteIP().toString()) && !request->authenticate(WEBPAGE_LOGIN_USER, WEBPAGE_LOGIN_PASSWORD))
-            return request->requestAuthentication();
-        request->send(SPIFFS, "/log.html", "text/html");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiOpen(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    if (getShutterStatus() == ShutterStatus::Opened || getShutterStatus() == ShutterStatus::Opening) {
+        json["rsp"] = "done";
+    } else if (!submitShutterIntent(ShutterIntent::Open)) {
+        json["rsp"] = "Error: intent queue full";
+    } else {
+        json["rsp"] = "done";
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    // css
+void apiLockMovement(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    lock_movement = true;
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    WebServer.on("/css/style.css", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/css/style.css", "text/css");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiUnlockMovement(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    lock_movement = false;
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    WebServer.on("/css/sa2.min.css", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/css/sa2.min.css", "text/css");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+/* system management */
+
+void apiResetAlertStatus(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    EEPROM.writeBool(EEPROM_ALERT_STATUS_ADDRESS, (hardware_alert_status = false));
+    hardware_alert_status_description[0] = 0;
+    EEPROM.writeString(EEPROM_ALERT_STATUS_DESCRIPTION_ADDRESS, hardware_alert_status_description);
+    EEPROM.commit();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
 
-    // js
+void apiResetEEPROM(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    EEPROM.writeBool(EEPROM_INITIALIZED_ADDRESS, false);
+    EEPROM.commit();
+    // the loop semaphore is held until the reboot, to ensure no critical operation is in progress
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+    SSELogger.close();
+    ESP.restart();
+}
 
-    WebServer.on("/js/dashboard.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/js/dashboard.js", "text/javascript");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiRestart(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    // the loop semaphore is held until the reboot, to ensure no critical operation is in progress
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+    SSELogger.close();
+    ESP.restart();
+}
 
-    WebServer.on("/js/log.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/js/log.js", "text/javascript");
-        logMessage("ESPAsyncWebServer", request->url(), "");
-    });
+void apiForceRestart(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command);
+    SSELogger.close();
+    ESP.restart();
+}
+
+void apiServerLoggingToggle(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    webserver_logging = !webserver_logging;
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiServerLoggingStatus(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    json["rsp"] = webserver_logging;
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiServerLimits(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    DynamicJsonDocument json_limits{2048};
+    json_limits["rsp"]["in-flight"] = web_requests_in_flight;
+    json_limits["rsp"]["in-flight-max"] = web_requests_in_flight_max;
+    json_limits["rsp"]["in-flight-limit"] = WEB_REQUESTS_IN_FLIGHT;
+    json_limits["rsp"]["rejected-busy"] = web_requests_busy;
+    for (int i{}; i <= WEB_RATE_CONTROL; ++i) {
+        JsonObject json_class{json_limits["rsp"]["classes"].createNestedObject()};
+        json_class["class"] = web_rate_class_names[i];
+        json_class["rate"] = web_rate_limits[i].rate;
+        json_class["burst"] = web_rate_limits[i].burst;
+        json_class["rejected"] = web_requests_limited[i];
+    }
+    json_limits["rsp"].createNestedArray("clients");
+    for (const WebRateClient &client : web_rate_clients) {
+        if (client.address == 0) continue;
+        JsonObject json_client{json_limits["rsp"]["clients"].createNestedObject()};
+        json_client["ip"] = IPAddress{client.address}.toString();
+        json_client["age"] = millis() - client.time;
+        json_client["rejected"] = client.rejected;
+    }
+    serializeJson(json_limits, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiServerLimitsReset(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    // the in flight requests are still counted
+    web_requests_in_flight_max = web_requests_in_flight;
+    web_requests_busy = 0;
+    for (uint32_t &i : web_requests_limited) i = 0;
+    for (WebRateClient &client : web_rate_clients) client.rejected = 0;
+    json.clear();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+/* web authentication */
+
+void apiAuthAllowlist(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    json.clear();
+    JsonArray json_allowlist{json.createNestedArray("rsp")};
+    for (int i{}; i < web_allowlist_size; ++i) {
+        char cidr[19]{};
+        formatCIDR(web_allowlist[i], cidr);
+        json_allowlist.add(cidr);
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiAuthAllowlistSet(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    // check, the allowlist is replaced only if all the ranges are valid
+    const JsonArrayConst json_cidr{json["cidr"].as<JsonArrayConst>()};
+    WebAllowlistEntry allowlist[WEB_ALLOWLIST_SIZE]{};
+    bool cidr_error{false};
+    for (int i{}; i < json_cidr.size() && i < WEB_ALLOWLIST_SIZE; ++i)
+        if (!json_cidr[i].is<const char *>() || !parseCIDR(json_cidr[i].as<const char *>(), allowlist[i])) cidr_error = true;
+    const int allowlist_size{static_cast<int>(json_cidr.size())};
+    json.clear();
+    if (allowlist_size > WEB_ALLOWLIST_SIZE) {
+        json["rsp"] = "Error: too many ranges";
+    } else if (cidr_error) {
+        json["rsp"] = "Error: ranges must be IPv4 CIDR strings, from /1 to /32";
+    } else {
+        memcpy(web_allowlist, allowlist, sizeof(web_allowlist));
+        web_allowlist_size = allowlist_size;
+        saveWebAllowlist();
+        json["rsp"] = "done";
+    }
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiAuthSessionsRevoke(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    String response{};
+    // new key, the issued tokens are no longer valid
+    esp_fill_random(web_session_key, sizeof(web_session_key));
+    json.clear();
+    json["rsp"] = "done";
+    serializeJson(json, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+void apiHelp(AsyncWebServerRequest *request, JsonDocument &json, const String &command);
+
+/* status */
+
+void apiStatus(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    /* Served from the snapshot buffer, serialized once per version,
+     * so polling costs nothing while the status does not change. */
+    uint32_t version{};
+    const std::shared_ptr<const String> buffer{statusBuffer(version)};
+    const String etag{statusETag(version)};
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match").indexOf(etag) >= 0) {
+        AsyncWebServerResponse *response_status{request->beginResponse(304)};
+        response_status->addHeader("ETag", etag);
+        request->send(response_status);
+        if (webserver_logging) logMessage("ESPAsyncWebServer", request->url(), command + ": not modified");
+    } else {
+        AsyncWebServerResponse *response_status{request->beginResponse("application/json", buffer->length(), [buffer](uint8_t *_data, size_t _max_len, size_t _index) -> size_t {
+            const size_t length{std::min(_max_len, buffer->length() - _index)};
+            memcpy(_data, buffer->c_str() + _index, length);
+            return length;
+        })};
+        response_status->addHeader("ETag", etag);
+        response_status->addHeader("Cache-Control", "no-cache");
+        request->send(response_status);
+        if (webserver_logging) logMessage("ESPAsyncWebServer", request->url(), command + ": " + *buffer);
+    }
+}
+
+void apiStatusWait(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    /* Long poll: the response is a chunked one whose filler answers
+     * RESPONSE_TRY_AGAIN (polled by the async tcp task about every
+     * 500 ms) until the status values change after the version
+     * given, or the timeout expires. Nothing is blocked meanwhile. */
+    String response{};
+    const uint32_t since{json["version"].as<uint32_t>()};
+    const unsigned long timeout{json.containsKey("timeout") ? std::min(json["timeout"].as<unsigned long>(), static_cast<unsigned long>(STATUS_WAIT_MAX)) : STATUS_WAIT_DEFAULT};
+    json.clear();
+    if (status_waiters >= STATUS_WAIT_REQUESTS) {
+        json["rsp"] = "Error: too many status-wait requests";
+        serializeJson(json, response);
+        request->send(200, "application/json", response);
+        logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+    } else {
+        const std::shared_ptr<StatusWaiter> waiter{std::make_shared<StatusWaiter>()};
+        const unsigned long start_time{millis()};
+        std::shared_ptr<const String> buffer{};
+        AsyncWebServerResponse *response_status{request->beginChunkedResponse("application/json", [waiter, since, timeout, start_time, buffer](uint8_t *_data, size_t _max_len, size_t _index) mutable -> size_t {
+            if (!buffer) {
+                // a version newer than the current one is from before a restart: answer at once
+                const StatusRecord record{statusRecord()};
+                if (record.change_version <= since && since <= record.version && millis() - start_time < timeout) return RESPONSE_TRY_AGAIN;
+                // the async tcp task never waits for the status task
+                if (xSemaphoreTake(xSemaphore_status, 0) != pdTRUE) return RESPONSE_TRY_AGAIN;
+                uint32_t version{};
+                buffer = statusBuffer(version);
+                xSemaphoreGive(xSemaphore_status);
+            }
+            const size_t length{std::min(_max_len, buffer->length() - _index)};
+            memcpy(_data, buffer->c_str() + _index, length);
+            return length;
+        })};
+        response_status->addHeader("Cache-Control", "no-store");
+        request->send(response_status);
+        if (webserver_logging) logMessage("ESPAsyncWebServer", request->url(), command + ": waiting");
+    }
+}
+
+//////////
+
+// command registry, index and argument check (shared with the host benchmark)
+#include "api_commands.hpp"
+
+ApiCommandStats api_command_stats[API_COMMANDS]{};
 
-    WebServer.on("/js-external/res.min.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/js-external/res.min.js", "text/javascript");
-        logMessage("ESPAsyncWebServer", request->url(), "");
+/**
+ * @brief Return the error of the first precondition not satisfied, or nullptr.
+ */
+const char *apiPreconditionError(const uint8_t _preconditions) {
+    if ((_preconditions & API_NO_ALERT) && hardware_alert_status) return "Error: shutter in alert status";
+    if ((_preconditions & API_NETWORK) && network_alert_status) return "Error: no network";
+    if ((_preconditions & API_AUTO) && !AUTO) return "Error: shutter in manual mode";
+    if ((_preconditions & API_UNLOCKED) && lock_movement) return "Error: shutter locked";
+    if ((_preconditions & API_NOT_MOVING) && MOVEMENT_STATUS) return "Error: shutter is moving";
+    return nullptr;
+}
+
+/**
+ * @brief Take the locks of a command (all or none), return true if successful.
+ */
+bool takeApiLocks(const uint8_t _locks) {
+    if ((_locks & API_LOCK_LOOP) && xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(50)) != pdTRUE) return false;
+    if ((_locks & API_LOCK_STATUS) && xSemaphoreTake(xSemaphore_status, pdMS_TO_TICKS(50)) != pdTRUE) {
+        if (_locks & API_LOCK_LOOP) xSemaphoreGive(xSemaphore);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Give back the locks of a command.
+ */
+void giveApiLocks(const uint8_t _locks) {
+    if (_locks & API_LOCK_STATUS) xSemaphoreGive(xSemaphore_status);
+    if (_locks & API_LOCK_LOOP) xSemaphoreGive(xSemaphore);
+}
+
+void apiHelp(AsyncWebServerRequest *request, JsonDocument &json, const String &command) {
+    /* Generated from the registry. The dispatch times (deserialization,
+     * lookup and checks, handler excluded) are measured on each request. */
+    String response{};
+    DynamicJsonDocument json_help{4096};
+    for (int i{}; i < API_COMMANDS; ++i) {
+        const ApiCommand &api_command{api_commands[i]};
+        const ApiCommandStats &stats{api_command_stats[i]};
+        JsonObject json_command{json_help["rsp"].createNestedObject()};
+        json_command["cmd"] = api_command.name;
+        json_command["class"] = web_rate_class_names[api_command.rate_class];
+        if (api_command.argument != nullptr) json_command["args"][api_command.argument] = api_argument_names[static_cast<int>(api_command.argument_type)];
+        for (int j{}; j < sizeof(api_precondition_names) / sizeof(api_precondition_names[0]); ++j)
+            if (api_command.preconditions >> j & 1) json_command["requires"].add(api_precondition_names[j]);
+        for (int j{}; j < sizeof(api_lock_names) / sizeof(api_lock_names[0]); ++j)
+            if (api_command.locks >> j & 1) json_command["locks"].add(api_lock_names[j]);
+        json_command["calls"] = stats.calls;
+        json_command["dispatch-mean-us"] = stats.calls == 0 ? 0 : static_cast<uint32_t>(stats.total_us / stats.calls);
+        json_command["dispatch-max-us"] = stats.max_us;
+    }
+    serializeJson(json_help, response);
+    request->send(200, "application/json", response);
+    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
+}
+
+//////////
+
+void startWebServer() {
+    /////////////
+    // WEBPAGES
+
+    // pages, gzipped in flash (the css and js are served by onNotFound)
+
+    WebServer.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!admitWebRequest(request, WEB_RATE_PAGE)) return;
+        char set_cookie[WEB_SESSION_SET_COOKIE_SIZE]{};
+        if (!authenticateWebRequest(request, set_cookie)) return request->requestAuthentication();
+        sendWebAsset(request, *findWebAsset("/dashboard.html"), set_cookie);
     });
 
-    WebServer.on("/js-external/sa2.min.js", HTTP_GET, [](AsyncWebServerRequest *request) {
-        request->send(SPIFFS, "/js-external/sa2.min.js", "text/javascript");
-        logMessage("ESPAsyncWebServer", request->url(), "");
+    WebServer.on("/log", HTTP_GET, [](AsyncWebServerRequest *request) {
+        if (!admitWebRequest(request, WEB_RATE_PAGE)) return;
+        char set_cookie[WEB_SESSION_SET_COOKIE_SIZE]{};
+        if (!authenticateWebRequest(request, set_cookie)) return request->requestAuthentication();
+        sendWebAsset(request, *findWebAsset("/log.html"), set_cookie);
     });
 
     ////////
@@ -114,11 +797,16 @@ void startWebServer() {
 
     WebServer.on("/api", HTTP_GET, [](AsyncWebServerRequest *request) {
         if (request->hasParam("json")) {
-            StaticJsonDocument<64> json{};
+            const unsigned long start_time{micros()};
+            // admission by the class of the command, before any parsing (the strictest class if unknown)
+            const String &json_request{request->getParam("json")->value()};
+            const ApiCommand *api_command{findRawApiCommand(json_request.c_str())};
+            if (!admitWebRequest(request, api_command == nullptr ? WEB_RATE_CONTROL : api_command->rate_class)) return;
+            StaticJsonDocument<384> json{};
             String response{};
 
             // try deserialization
-            const DeserializationError d_error{deserializeJson(json, request->getParam("json")->value())};
+            const DeserializationError d_error{deserializeJson(json, json_request)};
             if (d_error) {
                 json["rsp"] = "Error: wrong syntax";
                 serializeJson(json, response);
@@ -127,9 +815,10 @@ void startWebServer() {
                 return;
             }
 
-            // check json syntax
-            const bool c1{json.containsKey("cmd") && json["cmd"].is<String>()};
-            if (!c1) {
+            // check json syntax, the parsed command must be the admitted one
+            const bool c1{json.containsKey("cmd") && json["cmd"].is<String>() && findApiCommand(json["cmd"].as<const char *>()) == api_command};
+            const bool c2{api_command == nullptr || apiArgumentValid(*api_command, json.as<JsonObjectConst>())};
+            if (!(c1 && c2)) {
                 json.clear();
                 json["rsp"] = "Error: wrong syntax";
                 serializeJson(json, response);
@@ -138,277 +827,40 @@ void startWebServer() {
                 return;
             }
 
-            // save command, clear json, and handle request
+            // save command, and handle request
             const String command{json["cmd"].as<String>()};
-            json.clear();
-
-            /* shutter-related functions */
-
-            if (command == "abort") {
-                if (!AUTO) {
-                    json["rsp"] = "Error: shutter in manual mode";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(50)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    KMPProDinoESP32.setAllRelaysOff();
-                    xSemaphoreGive(xSemaphore);
-                    json["rsp"] = "done";
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "close") {
-                if (hardware_alert_status) {
-                    json["rsp"] = "Error: shutter in alert status";
-                } else if (network_alert_status) {
-                    json["rsp"] = "Error: no network";
-                } else if (!AUTO) {
-                    json["rsp"] = "Error: shutter in manual mode";
-                } else if (lock_movement) {
-                    json["rsp"] = "Error: shutter locked";
-                } else if (getShutterStatus() == ShutterStatus::Closed || getShutterStatus() == ShutterStatus::Closing) {
-                    json["rsp"] = "done";
-                } else {
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    if (xSemaphoreTake(xSemaphore, portMAX_DELAY) == pdTRUE) {
-                        if (MOVEMENT_STATUS) {
-                            KMPProDinoESP32.setAllRelaysOff();
-                            delay(150);
-                        }
-                        start_movement_time = millis();
-                        KMPProDinoESP32.setRelayState(CLOSING_MOTOR, true);
-                        // let the opening sensor change
-                        /* DO NOT EXTRACT THIS DELAY FROM THE INSIDE OF THE MUTEX!
-                         * The mutex must be acquired in order to block the loop
-                         * shutter handle until the sensor is changed. */
-                        const unsigned long t{millis()};
-                        while (OPENED_SENSOR && AUTO) {
-                            delay(50);
-                            // safety stop
-                            if ((millis() - t) > SENSOR_TOGGLING_TIME) {
-                                snprintf(hardware_alert_status_description, sizeof(hardware_alert_status_description), "the opening limit switch sensor did not toggle in time during the closing procedure");
-                                logMessage("ESPAsyncWebServer", request->url(), String{"ERROR: "} + hardware_alert_status_description);
-                                EEPROM.writeString(EEPROM_ALERT_STATUS_DESCRIPTION_ADDRESS, hardware_alert_status_description);
-                                EEPROM.commit();
-                                start_movement_time -= ALERT_STATUS_WAIT;
-                                break;
-                            }
-                        }
-                        xSemaphoreGive(xSemaphore);
-                    }
-                    return;
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "open") {
-                if (hardware_alert_status) {
-                    json["rsp"] = "Error: shutter in alert status";
-                } else if (network_alert_status) {
-                    json["rsp"] = "Error: no network";
-                } else if (!AUTO) {
-                    json["rsp"] = "Error: shutter in manual mode";
-                } else if (lock_movement) {
-                    json["rsp"] = "Error: shutter locked";
-                } else if (getShutterStatus() == ShutterStatus::Opened || getShutterStatus() == ShutterStatus::Opening) {
-                    json["rsp"] = "done";
-                } else {
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    if (xSemaphoreTake(xSemaphore, portMAX_DELAY) == pdTRUE) {
-                        if (MOVEMENT_STATUS) {
-                            KMPProDinoESP32.setAllRelaysOff();
-                            delay(150);
-                        }
-                        start_movement_time = millis();
-                        KMPProDinoESP32.setRelayState(OPENING_MOTOR, true);
-                        // let the closing sensor change
-                        /* DO NOT EXTRACT THIS DELAY FROM THE INSIDE OF THE MUTEX!
-                         * The mutex must be acquired in order to block the loop
-                         * shutter handle until the sensor is changed. */
-                        const unsigned long t{millis()};
-                        while (CLOSED_SENSOR && AUTO) {
-                            delay(50);
-                            // safety stop
-                            if ((millis() - t) > SENSOR_TOGGLING_TIME) {
-                                snprintf(hardware_alert_status_description, sizeof(hardware_alert_status_description), "the closing limit switch sensor did not toggle in time during the opening procedure");
-                                logMessage("ESPAsyncWebServer", request->url(), String{"ERROR: "} + hardware_alert_status_description);
-                                EEPROM.writeString(EEPROM_ALERT_STATUS_DESCRIPTION_ADDRESS, hardware_alert_status_description);
-                                EEPROM.commit();
-                                start_movement_time -= ALERT_STATUS_WAIT;
-                                break;
-                            }
-                        }
-                        xSemaphoreGive(xSemaphore);
-                    }
-                    return;
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "lock-movement") {
-                lock_movement = true;
-                json["rsp"] = "done";
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "unlock-movement") {
-                lock_movement = false;
-                json["rsp"] = "done";
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            /* system management */
-
-            else if (command == "reset-alert-status") {
-                if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(50)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    EEPROM.writeBool(EEPROM_ALERT_STATUS_ADDRESS, (hardware_alert_status = false));
-                    hardware_alert_status_description[0] = 0;
-                    EEPROM.writeString(EEPROM_ALERT_STATUS_DESCRIPTION_ADDRESS, hardware_alert_status_description);
-                    EEPROM.commit();
-                    xSemaphoreGive(xSemaphore);
-                    json["rsp"] = "done";
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "reset-EEPROM") {
-                if (hardware_alert_status) {
-                    json["rsp"] = "Error: shutter in alert status";
-                } else if (MOVEMENT_STATUS) {
-                    json["rsp"] = "Error: shutter is moving";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(50)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    EEPROM.writeBool(EEPROM_INITIALIZED_ADDRESS, false);
-                    EEPROM.commit();
-                    // do not give back the semaphore to ensure no critical operation is in progress during the reboot
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    SSELogger.close();
-                    ESP.restart();
-                    xSemaphoreGive(xSemaphore);
-                    return;
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "restart") {
-                if (MOVEMENT_STATUS) {
-                    json["rsp"] = "Error: shutter is moving";
-                } else if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(50)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
-                } else {
-                    // take the semaphore to ensure no critical operation is in progress during the reboot
-                    json["rsp"] = "done";
-                    serializeJson(json, response);
-                    request->send(200, "application/json", response);
-                    logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-                    SSELogger.close();
-                    ESP.restart();
-                    xSemaphoreGive(xSemaphore);
-                    return;
-                }
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "force-restart") {
-                json["rsp"] = "done";
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command);
-                SSELogger.close();
-                ESP.restart();
-            }
-
-            else if (command == "server-logging-toggle") {
-                webserver_logging = !webserver_logging;
-                json["rsp"] = "done";
-                serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            else if (command == "server-logging-status") {
-                json["rsp"] = webserver_logging;
+            if (api_command == nullptr) {
+                json.clear();
+                json["rsp"] = "Error: unknown command";
                 serializeJson(json, response);
-                request->send(200, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
-            }
-
-            /* status */
-
-            else if (command == "status") {
-                if (xSemaphoreTake(xSemaphore_status, pdMS_TO_TICKS(50)) != pdTRUE) {
-                    json["rsp"] = "Error: mutex acquired";
+                request->send(400, "application/json", response);
+                logMessage("ESPAsyncWebServer", request->url(), response);
+            } else {
+                // the commands on the web authentication need an authenticated client (no session is started here)
+                char set_cookie[WEB_SESSION_SET_COOKIE_SIZE]{};
+                if ((api_command->preconditions & API_AUTHENTICATED) && !authenticateWebRequest(request, set_cookie)) return request->requestAuthentication();
+                const char *error{apiPreconditionError(api_command->preconditions)};
+                const uint32_t dispatch_us{static_cast<uint32_t>(micros() - start_time)};
+                ApiCommandStats &stats{api_command_stats[api_command - api_commands]};
+                ++stats.calls;
+                stats.total_us += dispatch_us;
+                stats.max_us = std::max(stats.max_us, dispatch_us);
+                if (error == nullptr && !takeApiLocks(api_command->locks)) error = "Error: mutex acquired";
+                if (error != nullptr) {
+                    json.clear();
+                    json["rsp"] = error;
                     serializeJson(json, response);
                     request->send(200, "application/json", response);
                     logMessage("ESPAsyncWebServer", request->url(), command + ": " + response);
                 } else {
-                    // create json
-                    json_status.clear();
-                    json_status["rsp"]["firmware-version"] = FIRMWARE_VERSION;
-                    json_status["rsp"]["uptime"] = uptime_formatter::getUptime();
-                    json_status["rsp"]["shutter-status"] = static_cast<int>(getShutterStatus());
-                    json_status["rsp"]["movement-status"] = MOVEMENT_STATUS;
-                    json_status["rsp"]["lock-movement"] = lock_movement;
-                    json_status["rsp"]["network-status"] = network_connection_status;
-                    json_status["rsp"]["alert"]["hardware"]["status"] = hardware_alert_status;
-                    json_status["rsp"]["alert"]["hardware"]["description"] = hardware_alert_status_description;
-                    json_status["rsp"]["alert"]["network"]["status"] = network_alert_status;
-                    json_status["rsp"]["alert"]["network"]["security-procedures"] = static_cast<int>(EP_status);
-                    for (int i{}; i < 4; ++i) json_status["rsp"]["relay"]["list"][i] = KMPProDinoESP32.getRelayState(i);
-                    json_status["rsp"]["relay"]["opening-motor"] = IS_OPENING;
-                    json_status["rsp"]["relay"]["closing-motor"] = IS_CLOSING;
-                    for (int i{}; i < 4; ++i) json_status["rsp"]["optoin"]["list"][i] = KMPProDinoESP32.getOptoInState(i);
-                    json_status["rsp"]["optoin"]["auto"] = AUTO;
-                    json_status["rsp"]["optoin"]["closed-sensor"] = CLOSED_SENSOR;
-                    json_status["rsp"]["optoin"]["opened-sensor"] = OPENED_SENSOR;
-                    json_status["rsp"]["wifi"]["hostname"] = HOSTNAME;
-                    json_status["rsp"]["wifi"]["mac-address"] = WiFi.macAddress();
-                    // serialize and send
-                    response_status.clear();
-                    serializeJson(json_status, response_status);
-                    request->send(200, "application/json", response_status);
-                    if (webserver_logging) logMessage("ESPAsyncWebServer", request->url(), command + ": " + response_status);
-                    xSemaphoreGive(xSemaphore_status);
+                    api_command->handler(request, json, command);
+                    giveApiLocks(api_command->locks);
                 }
             }
-
-            else {
-                json["rsp"] = "Error: unknown command";
-                serializeJson(json, response);
-                request->send(400, "application/json", response);
-                logMessage("ESPAsyncWebServer", request->url(), response);
-            }
         }
 
         else {
+            if (!admitWebRequest(request, WEB_RATE_CONTROL)) return;
             const char response[] PROGMEM{R"({"rsp":"Error: unknown params"})"};
             request->send_P(400, "application/json", response);
             logMessage("ESPAsyncWebServer", request->url(), response);
@@ -424,20 +876,51 @@ void startWebServer() {
 
     WebServer.addHandler(&SSELogger);
 
+    ///////////////////
+    // STATUS STREAM
+
+    StatusSSE.onConnect([](AsyncEventSourceClient *client) {
+        // snapshot of the last version sent to the other clients, so that the next deltas apply to it
+        if (xSemaphoreTake(xSemaphore_status, pdMS_TO_TICKS(50)) != pdTRUE) return client->close();
+        if (!status_sse_buffer) {
+            status_sse_buffer = statusBuffer(status_sse_version);
+            json_status_sse = json_status;
+            status_sse_time = millis();
+        }
+        client->send(status_sse_buffer->c_str(), "snapshot", status_sse_version);
+        xSemaphoreGive(xSemaphore_status);
+    });
+
+    WebServer.addHandler(&StatusSSE);
+
     //////////
     // OTHER
 
     WebServer.onNotFound([](AsyncWebServerRequest *request) {
-        const char response[] PROGMEM{R"({"rsp":"Error: not found"})"};
-        request->send_P(404, "application/json", response);
-        logMessage("ESPAsyncWebServer", request->url(), response);
+        if (!admitWebRequest(request, WEB_RATE_PAGE)) return;
+        // css and js, with the content hash in the name
+        const WebAsset *asset{request->method() == HTTP_GET ? findWebAsset(request->url().c_str()) : nullptr};
+        if (asset != nullptr && asset->immutable) {
+            sendWebAsset(request, *asset);
+        } else {
+            const char response[] PROGMEM{R"({"rsp":"Error: not found"})"};
+            request->send_P(404, "application/json", response);
+            logMessage("ESPAsyncWebServer", request->url(), response);
+        }
     });
 
     //////////
     // BEGIN
 
-    // prepare status string
-    response_status.reserve(JSON_S_SIZE);
+    // status ETag prefix
+    status_boot_id = esp_random();
+
+    // api commands index
+    buildApiIndex();
+
+    // web authentication: allowlist from NVS, session tokens key
+    loadWebAllowlist();
+    esp_fill_random(web_session_key, sizeof(web_session_key));
 
     // add default CORS header
     DefaultHeaders::Instance().addHeader("Access-Control-Allow-Origin", "*");
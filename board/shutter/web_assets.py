@@ -0,0 +1,155 @@
+# Remote REST dome controller
+# https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+#
+# Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+# SPDX-License-Identifier: MIT
+# Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+# Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+#          Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+#
+# Permission is hereby  granted, free of charge, to any  person obtaining a copy
+# of this software and associated  documentation files (the "Software"), to deal
+# in the Software  without restriction, including without  limitation the rights
+# to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+# copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+# IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+# FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+# AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+# LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# PlatformIO pre-build script: pack the web assets of data/ into the firmware.
+#
+# Every file is gzipped (level 9, no timestamp, so the output is reproducible)
+# and its hash is the first 8 hex digits of the SHA-256 of its content. The
+# references of the pages to the other files are rewritten with the hash in
+# the name (e.g. js/dashboard.js becomes js/dashboard.3f2a1b9c.js), so these
+# names can be cached forever by the browsers. The pages (html) keep their
+# name, and are revalidated with their hash as ETag.
+#
+# The files are written as PROGMEM arrays in web_assets_bundle.h (in the build
+# directory, included by web_server.cpp), with a table of WebAsset indexed by
+# a perfect hash of the url: the top WEB_ASSETS_SLOT_BITS bits of the FNV-1a
+# hash with WEB_ASSETS_SEED as offset basis are different for every url.
+#
+# Outside PlatformIO (e.g. for tools/web_assets_benchmark) the script writes the
+# bundle in the folder given as argument: python3 web_assets.py <folder>
+
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+try:
+    Import("env")
+    SOURCE_DIR = os.path.join(env.subst("$PROJECT_DIR"), "data")
+    OUTPUT_DIR = os.path.join(env.subst("$BUILD_DIR"), "web_assets")
+except NameError:
+    env = None
+    SOURCE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "data")
+    OUTPUT_DIR = sys.argv[1]
+OUTPUT_FILE = os.path.join(OUTPUT_DIR, "web_assets_bundle.h")
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "text/javascript",
+}
+
+
+def content_hash(content):
+    return hashlib.sha256(content).hexdigest()[:8]
+
+
+def hashed_name(path, digest):
+    root, extension = os.path.splitext(path)
+    return f"{root}.{digest}{extension}"
+
+
+def fnv1a_hash(text, seed):
+    value = seed
+    for byte in text.encode("utf-8"):
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value
+
+
+def perfect_hash(urls):
+    # table at most half full, then the first seed without collisions (the top bits of the hash are the most mixed)
+    bits = 1
+    while 1 << bits < 2 * len(urls):
+        bits += 1
+    seed = 2166136261
+    while len({fnv1a_hash(url, seed) >> (32 - bits) for url in urls}) != len(urls):
+        seed = (seed + 1) & 0xFFFFFFFF
+    return seed, bits
+
+
+def build_web_assets():
+    files = []
+    for directory, _, names in os.walk(SOURCE_DIR):
+        for name in names:
+            files.append(os.path.relpath(os.path.join(directory, name), SOURCE_DIR).replace(os.sep, "/"))
+
+    # assets first, then the pages that reference them
+    assets = {}
+    bundle = []
+    for path in sorted(f for f in files if not f.endswith(".html")):
+        with open(os.path.join(SOURCE_DIR, path), "rb") as file:
+            content = file.read()
+        digest = content_hash(content)
+        assets[path] = hashed_name(path, digest)
+        bundle.append(("/" + assets[path], CONTENT_TYPES.get(os.path.splitext(path)[1], "application/octet-stream"), digest, True, content))
+
+    for path in sorted(f for f in files if f.endswith(".html")):
+        with open(os.path.join(SOURCE_DIR, path), "r", encoding="utf-8") as file:
+            page = file.read()
+        page = re.sub(r'(href|src)="(/?)([^"]+)"', lambda match: f'{match.group(1)}="{match.group(2)}{assets.get(match.group(3), match.group(3))}"', page)
+        content = page.encode("utf-8")
+        bundle.append(("/" + path, "text/html", content_hash(content), False, content))
+
+    seed, bits = perfect_hash([url for url, *_ in bundle])
+    table = [None] * (1 << bits)
+    lines = [
+        "// Generated by web_assets.py from data/, do not edit.",
+        "",
+        "#pragma once",
+        "",
+        f"#define WEB_ASSETS_SEED {seed}u",
+        f"#define WEB_ASSETS_SLOT_BITS {bits}",
+        "",
+    ]
+    size = 0
+    for i, (url, content_type, digest, immutable, content) in enumerate(bundle):
+        compressed = gzip.compress(content, compresslevel=9, mtime=0)
+        size += len(compressed)
+        lines.append(f"// {url}, {len(content)} bytes")
+        lines.append(f"const uint8_t web_asset_{i}[] PROGMEM{{")
+        for offset in range(0, len(compressed), 16):
+            lines.append("    " + ", ".join(f"0x{byte:02x}" for byte in compressed[offset:offset + 16]) + ",")
+        lines.append("};")
+        table[fnv1a_hash(url, seed) >> (32 - bits)] = f'{{"{url}", "{content_type}", "\\"{digest}\\"", {"true" if immutable else "false"}, web_asset_{i}, sizeof(web_asset_{i})}}'
+    lines.append("")
+    lines.append("const WebAsset web_assets[1 << WEB_ASSETS_SLOT_BITS]{")
+    lines.extend(f"    {entry or '{}'}," for entry in table)
+    lines.append("};")
+    output = "\n".join(lines) + "\n"
+
+    # rewritten only if changed, not to rebuild web_server.cpp at each build
+    os.makedirs(OUTPUT_DIR, exist_ok=True)
+    if not os.path.exists(OUTPUT_FILE) or open(OUTPUT_FILE).read() != output:
+        with open(OUTPUT_FILE, "w") as file:
+            file.write(output)
+    print(f"Web assets: {len(bundle)} files from {SOURCE_DIR}, {size} bytes gzipped")
+
+
+build_web_assets()
+if env is not None:
+    env.Append(CPPPATH=[OUTPUT_DIR])
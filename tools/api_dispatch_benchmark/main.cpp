@@ -0,0 +1,125 @@
+/*
+Remote REST dome controller
+https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+         Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* Host benchmark of the /api dispatch of a board firmware: for every command of
+ * the registry (api_commands.hpp, built with API_REGISTRY_HOST so without the
+ * handlers) a sample request is parsed, then the scan of the raw request
+ * (admission), the name hash, the index lookup and the argument check are
+ * timed, each on its own, in ns per call. The
+ * board is chosen by the include path. The host times are only relative: on
+ * the ESP32 (240 MHz, registry in flash) every figure is several times higher. */
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#define API_REGISTRY_HOST
+#include <ArduinoJson.h>
+
+#include "api_commands.hpp"
+
+// iterations of each timed loop
+#define ITERATIONS 200000
+
+typedef std::chrono::steady_clock Clock;
+
+// sinks, so that the timed calls are not optimized away
+volatile uint32_t hash_sink;
+volatile uintptr_t lookup_sink;
+volatile bool valid_sink;
+
+int failures{0};
+
+// sample request of a command, with its argument (if any) of the right type
+std::string sampleRequest(const ApiCommand &_api_command) {
+    std::string request{"{\"cmd\":\"" + std::string{_api_command.name} + "\""};
+    if (_api_command.argument != nullptr) {
+        request += ",\"" + std::string{_api_command.argument} + "\":";
+        switch (_api_command.argument_type) {
+            case ApiArgument::UInt32:
+                request += "42";
+                break;
+            case ApiArgument::Array:
+                request += "[1,2,3]";
+                break;
+            default:
+                request += "123.4";
+                break;
+        }
+    }
+    return request + "}";
+}
+
+// mean time of a call, in ns
+template <typename F>
+double timeCall(F _call) {
+    const Clock::time_point start{Clock::now()};
+    for (uint32_t i{}; i < ITERATIONS; ++i) _call();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ITERATIONS;
+}
+
+//////////
+
+int main() {
+    buildApiIndex();
+
+    std::printf("%-24s %10s %10s %10s %10s %10s %10s\n", "command", "parse", "scan", "hash", "lookup", "argument", "dispatch");
+    double total_dispatch{};
+    for (const ApiCommand &api_command : api_commands) {
+        const std::string request{sampleRequest(api_command)};
+        StaticJsonDocument<384> json;
+
+        const double parse{timeCall([&] { json.clear(); deserializeJson(json, request); })};
+        const char *volatile raw{request.c_str()};
+        const double scan{timeCall([&] { lookup_sink = reinterpret_cast<uintptr_t>(findRawApiCommand(raw)); })};
+        // the name is read through a volatile pointer, so the hash is not folded at compile time
+        const char *volatile name{json["cmd"].as<const char *>()};
+        const double hash{timeCall([&] { hash_sink = fnv1aHash(name); })};
+        const double lookup{timeCall([&] { lookup_sink = reinterpret_cast<uintptr_t>(findApiCommand(name)); })};
+        const double argument{timeCall([&] { valid_sink = apiArgumentValid(api_command, json.as<JsonObjectConst>()); })};
+
+        // the benchmark is meaningless if the dispatch does not work
+        if (findRawApiCommand(request.c_str()) != &api_command || findApiCommand(name) != &api_command || !apiArgumentValid(api_command, json.as<JsonObjectConst>())) {
+            std::printf("[FAIL] %s: not found, or sample argument refused\n", api_command.name);
+            ++failures;
+        }
+
+        // scan and lookup include the hash, as in the dispatcher
+        std::printf("%-24s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", api_command.name, parse, scan, hash, lookup, argument, scan + lookup + argument);
+        total_dispatch += scan + lookup + argument;
+    }
+    std::printf("\nmean dispatch (scan + lookup + argument): %.1f ns over %u commands\n", total_dispatch / API_COMMANDS, static_cast<unsigned>(API_COMMANDS));
+
+    if (findApiCommand("no-such-command") != nullptr || findRawApiCommand(R"({"cmd":"no-such-command"})") != nullptr) {
+        std::printf("[FAIL] unknown command found\n");
+        ++failures;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,323 @@
+/*
+Remote REST dome controller
+https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+         Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "plc_simulator.hpp"
+
+using namespace plc;
+
+// timeouts used by the dome firmware (RS485_RESPONSE_TIMEOUT and RS485_INTER_BYTE_TIMEOUT)
+#define RESPONSE_TIMEOUT microseconds(300000)
+#define INTER_BYTE_TIMEOUT microseconds(30000)
+
+struct Options {
+    bool loopback{false};
+    int baud{19200};
+    uint32_t seed{1};
+    double speed{3};
+    int requests{200};
+    Faults faults{};
+};
+
+//////////
+
+void printUsage(const char *_name) {
+    std::cout << "Usage: " << _name << " [options]\n"
+              << "  --loopback      run a scripted controller session over the in-process pipe, instead of the pty\n"
+              << "  --requests N    position requests of the loopback session (default 200)\n"
+              << "  --baud N        baud rate (default 19200)\n"
+              << "  --speed X       dome speed in degrees per second (default 3)\n"
+              << "  --latency US    extra response latency in microseconds\n"
+              << "  --jitter US     random extra response latency in microseconds\n"
+              << "  --drop P        probability to drop each response byte\n"
+              << "  --corrupt P     probability to corrupt the checksum of a configuration response\n"
+              << "  --seed N        random seed for the fault injection (default 1)\n";
+}
+
+bool parseOptions(int argc, char **argv, Options &_options) {
+    for (int i{1}; i < argc; ++i) {
+        const std::string option{argv[i]};
+        if (option == "--loopback") {
+            _options.loopback = true;
+            continue;
+        }
+        if (i + 1 >= argc) return false;
+        const char *value{argv[++i]};
+        if (option == "--requests")
+            _options.requests = std::atoi(value);
+        else if (option == "--baud")
+            _options.baud = std::atoi(value);
+        else if (option == "--speed")
+            _options.speed = std::atof(value);
+        else if (option == "--latency")
+            _options.faults.latency = microseconds{std::atol(value)};
+        else if (option == "--jitter")
+            _options.faults.jitter = microseconds{std::atol(value)};
+        else if (option == "--drop")
+            _options.faults.drop_probability = std::atof(value);
+        else if (option == "--corrupt")
+            _options.faults.corrupt_checksum_probability = std::atof(value);
+        else if (option == "--seed")
+            _options.seed = static_cast<uint32_t>(std::atol(value));
+        else
+            return false;
+    }
+    return _options.baud > 0 && _options.requests >= 0;
+}
+
+//////////
+
+std::string hex(const std::vector<uint8_t> &_bytes) {
+    std::string out{};
+    char buf[4]{};
+    for (auto i : _bytes) {
+        snprintf(buf, sizeof(buf), "%02X ", i);
+        out += buf;
+    }
+    return out;
+}
+
+void printStatus(const Simulator &_simulator) {
+    std::cout << "[status] azimuth " << _simulator.azimuth() << " (real " << _simulator.trueAzimuth() << ")"
+              << ", motion " << _simulator.motion()
+              << ", siren " << _simulator.sirenPlaying()
+              << ", zero search " << _simulator.zeroSearch()
+              << ", zero switch " << (_simulator.zeroEnabled() ? "enabled" : "disabled")
+              << ", config " << hex(_simulator.configuration().bytes()) << std::endl;
+}
+
+// console commands, to drive the dome motion and the faults while the simulator is running
+bool handleConsole(const std::string &_line, Simulator &_simulator) {
+    std::istringstream input{_line};
+    std::string command{};
+    double value{};
+    input >> command;
+    const bool has_value{static_cast<bool>(input >> value)};
+    const Clock::time_point now{Clock::now()};
+    if (command == "cw")
+        _simulator.setMotion(1, now);
+    else if (command == "ccw")
+        _simulator.setMotion(-1, now);
+    else if (command == "stop")
+        _simulator.setMotion(0, now);
+    else if (command == "speed" && has_value)
+        _simulator.setSpeed(value, now);
+    else if (command == "latency" && has_value)
+        _simulator.faults.latency = microseconds{static_cast<int64_t>(value)};
+    else if (command == "jitter" && has_value)
+        _simulator.faults.jitter = microseconds{static_cast<int64_t>(value)};
+    else if (command == "drop" && has_value)
+        _simulator.faults.drop_probability = value;
+    else if (command == "corrupt" && has_value)
+        _simulator.faults.corrupt_checksum_probability = value;
+    else if (command == "status")
+        printStatus(_simulator);
+    else if (command == "quit")
+        return false;
+    else
+        std::cout << "Commands: cw, ccw, stop, speed X, latency US, jitter US, drop P, corrupt P, status, quit" << std::endl;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PSEUDO-TERMINAL
+
+int runPty(Simulator &_simulator) {
+    const int master{posix_openpt(O_RDWR | O_NOCTTY)};
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("Error: pseudo-terminal");
+        return 1;
+    }
+    const char *slave_name{ptsname(master)};
+    // keep the slave open, otherwise the master reads fail while no client is connected
+    const int slave{open(slave_name, O_RDWR | O_NOCTTY)};
+    termios tty{};
+    tcgetattr(slave, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(slave, TCSANOW, &tty);
+
+    std::cout << "PLC simulator on " << slave_name << " (type help for the console commands)" << std::endl;
+    printStatus(_simulator);
+
+    std::string console{};
+    for (;;) {
+        // wake up for new bytes, console input, or the next byte to be sent
+        const Clock::time_point next{_simulator.nextTransmission()};
+        int timeout{100};
+        if (next != Clock::time_point::max())
+            timeout = static_cast<int>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count()));
+        pollfd fds[]{{master, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        poll(fds, 2, timeout);
+
+        // received bytes
+        if (fds[0].revents & POLLIN) {
+            uint8_t buf[64]{};
+            const ssize_t size{read(master, buf, sizeof(buf))};
+            const Clock::time_point now{Clock::now()};
+            for (ssize_t i{}; i < size; ++i) _simulator.receive(buf[i], now);
+            if (size > 0) std::cout << "[rx] " << hex(std::vector<uint8_t>(buf, buf + size)) << std::endl;
+        }
+
+        // bytes to be sent
+        const std::vector<uint8_t> out{_simulator.transmit(Clock::now())};
+        if (!out.empty()) {
+            if (write(master, out.data(), out.size()) < 0) perror("Error: write");
+            std::cout << "[tx] " << hex(out) << std::endl;
+        }
+
+        // console
+        if (fds[1].revents & (POLLIN | POLLHUP)) {
+            char buf[128]{};
+            const ssize_t size{read(STDIN_FILENO, buf, sizeof(buf))};
+            if (size <= 0) break;
+            console.append(buf, size);
+            size_t end{};
+            while ((end = console.find('\n')) != std::string::npos) {
+                const std::string line{console.substr(0, end)};
+                console.erase(0, end + 1);
+                if (!handleConsole(line, _simulator)) {
+                    close(slave);
+                    close(master);
+                    return 0;
+                }
+            }
+        }
+    }
+    close(slave);
+    close(master);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// LOOPBACK
+
+struct LinkStats {
+    std::vector<int64_t> round_trips{};  // microseconds
+    int timeouts{};
+    int short_frames{};
+    int checksum_errors{};
+
+    void print(const char *_name) {
+        std::sort(round_trips.begin(), round_trips.end());
+        int64_t total{};
+        for (auto i : round_trips) total += i;
+        std::cout << _name << ": " << round_trips.size() << " ok, " << timeouts << " timeouts, " << short_frames << " short frames, "
+                  << checksum_errors << " checksum errors";
+        if (!round_trips.empty())
+            std::cout << ", round trip us: min " << round_trips.front() << " mean " << total / static_cast<int64_t>(round_trips.size())
+                      << " p50 " << round_trips[round_trips.size() / 2] << " p99 " << round_trips[round_trips.size() * 99 / 100]
+                      << " max " << round_trips.back();
+        std::cout << std::endl;
+    }
+};
+
+// transaction as done by the firmware: write, then read the whole frame with its timeouts
+std::vector<uint8_t> transaction(BytePipe &_pipe, const std::vector<uint8_t> &_request, const size_t _frame_size, LinkStats &_stats) {
+    const Clock::time_point start{Clock::now()};
+    _pipe.write(_request);
+    const std::vector<uint8_t> response{_pipe.read(_frame_size, RESPONSE_TIMEOUT, INTER_BYTE_TIMEOUT)};
+    if (response.empty())
+        ++_stats.timeouts;
+    else if (response.size() != _frame_size)
+        ++_stats.short_frames;
+    else
+        _stats.round_trips.push_back(std::chrono::duration_cast<microseconds>(Clock::now() - start).count());
+    return response;
+}
+
+int runLoopback(Simulator &_simulator, const Options &_options) {
+    BytePipe pipe{_simulator, _options.baud};
+
+    // start up: write the position, as done by the setup of the dome firmware
+    pipe.write({WritePosition, 0x00, 0x5A});
+    printStatus(_simulator);
+
+    // position polling while the dome is moving
+    LinkStats position_stats{};
+    _simulator.setMotion(1, Clock::now());
+    for (int i{}; i < _options.requests; ++i) transaction(pipe, {Position}, 2, position_stats);
+    _simulator.setMotion(0, Clock::now());
+    position_stats.print("R");
+
+    // configuration reading
+    LinkStats config_stats{};
+    for (int i{}; i < 20; ++i) {
+        std::vector<uint8_t> config{transaction(pipe, {ReadConfig}, 8, config_stats)};
+        if (config.size() != 8) continue;
+        const uint8_t received_checksum{config.back()};
+        config.pop_back();
+        if (checksum(config.data(), config.size()) != received_checksum) {
+            ++config_stats.checksum_errors;
+            config_stats.round_trips.pop_back();
+        }
+    }
+    config_stats.print("0xC1");
+
+    // find zero: the controller starts the clockwise motion and waits for the zero response
+    LinkStats zero_stats{};
+    const Clock::time_point start{Clock::now()};
+    _simulator.setMotion(1, start);
+    pipe.write({FindZero});
+    std::vector<uint8_t> response{};
+    while (response.empty() && Clock::now() - start < std::chrono::seconds{400})
+        response = pipe.read(3, RESPONSE_TIMEOUT, INTER_BYTE_TIMEOUT);
+    _simulator.setMotion(0, Clock::now());
+    if (response.size() == 3 && response[0] == FindZero)
+        std::cout << "Z: zero " << (response[1] << 8 | response[2]) << " found in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count() << " ms" << std::endl;
+    else
+        std::cout << "Z: wrong response " << hex(response) << std::endl;
+    printStatus(_simulator);
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv) {
+    Options options{};
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    Simulator simulator{options.baud, options.seed};
+    simulator.faults = options.faults;
+    simulator.setSpeed(options.speed, Clock::now());
+    return options.loopback ? runLoopback(simulator, options) : runPty(simulator);
+}
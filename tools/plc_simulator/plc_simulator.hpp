@@ -0,0 +1,389 @@
+/*
+Remote REST dome controller
+https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+         Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* Host-side model of the dome encoder PLC, speaking the RS485 protocol described
+ * in board/dome/README.md. The model is transport-agnostic: bytes received from
+ * the controller are given to receive(), bytes to be sent back are taken from
+ * transmit() when due, so it can run behind a pseudo-terminal (main.cpp) or
+ * behind the in-process BytePipe. */
+
+#ifndef _PLC_SIMULATOR_HPP_
+#define _PLC_SIMULATOR_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace plc {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::microseconds;
+
+////////////////////////////////////////////////////////////////////////////////
+// PROTOCOL
+
+enum Command : uint8_t {
+    Siren = 0x42,           // B
+    Position = 0x52,        // R
+    WritePosition = 0x57,   // W
+    FindZero = 0x5A,        // Z
+    DefaultConfig = 0x44,   // D
+    DisableZero = 0x23,     // #
+    WriteConfig = 0xC0,
+    ReadConfig = 0xC1,
+};
+
+/**
+ * @brief Length of a request frame, command byte included.
+ * @param command command byte
+ * @return The frame length, 0 for unknown commands.
+ */
+inline size_t requestLength(const uint8_t command) {
+    switch (command) {
+        case Siren:
+        case Position:
+        case FindZero:
+        case DefaultConfig:
+        case DisableZero:
+        case ReadConfig:
+            return 1;
+        case WritePosition:
+            return 3;
+        case WriteConfig:
+            return 9;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Checksum of the configuration frames, calculated as neg(sum(bytes)) + 1 with byte overflow.
+ */
+inline uint8_t checksum(const uint8_t *data, const size_t size) {
+    uint8_t sum{};
+    for (size_t i{}; i < size; ++i) sum += data[i];
+    return ~sum + 1;
+}
+
+/**
+ * @brief Transmission time of one byte (8N1 framing, 10 bits per byte).
+ */
+inline microseconds byteTime(const int baud) {
+    return microseconds{10000000 / baud};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SIMULATOR
+
+// encoder configuration, same layout of the 0xC0 / 0xC1 frames
+struct Config {
+    uint8_t steps_per_degree{10};
+    uint16_t steps_per_revolution{3600};
+    uint16_t zero_azimuth{248};  // zero switch position (ZERO_POSITION in the dome firmware)
+    uint16_t zero_offset_steps{0};
+
+    std::vector<uint8_t> bytes() const {
+        return {steps_per_degree,
+                static_cast<uint8_t>(steps_per_revolution >> 8), static_cast<uint8_t>(steps_per_revolution),
+                static_cast<uint8_t>(zero_azimuth >> 8), static_cast<uint8_t>(zero_azimuth),
+                static_cast<uint8_t>(zero_offset_steps >> 8), static_cast<uint8_t>(zero_offset_steps)};
+    }
+};
+
+// fault injection, applied to the responses of the simulator
+struct Faults {
+    microseconds latency{0};                // extra delay before each response
+    microseconds jitter{0};                 // random extra delay, uniform in [0, jitter]
+    double drop_probability{0};             // probability to drop each response byte
+    double corrupt_checksum_probability{0};  // probability to corrupt the checksum of a 0xC1 response
+};
+
+class Simulator {
+   public:
+    explicit Simulator(const int _baud = 19200, const uint32_t _seed = 1) : baud{_baud}, rng{_seed} {
+        true_steps = counted_steps = static_cast<int64_t>(config.zero_azimuth + 90) * config.steps_per_degree;
+    }
+
+    Faults faults{};
+    // PLC processing time between the end of a request and the beginning of the response
+    microseconds processing_time{2000};
+    // bytes of a request more distant than this are considered a new frame
+    microseconds frame_gap{50000};
+
+    //////////
+    // dome model
+
+    /**
+     * @brief Set the dome motion, as commanded by the relays of the controller.
+     * @param _direction +1 clockwise (increasing azimuth), -1 counterclockwise, 0 stopped
+     */
+    void setMotion(const int _direction, const Clock::time_point _now) {
+        advance(_now);
+        direction = _direction;
+    }
+    int motion() const { return direction; }
+
+    /**
+     * @brief Set the dome rotation speed, in degrees per second.
+     */
+    void setSpeed(const double _speed, const Clock::time_point _now) {
+        advance(_now);
+        speed = _speed;
+    }
+
+    /**
+     * @brief Move the dome up to the given time, counting the encoder steps and handling the zero switch crossing.
+     */
+    void advance(const Clock::time_point _now) {
+        if (last_advance == Clock::time_point{}) last_advance = _now;
+        if (_now <= last_advance) return;
+        const double elapsed{std::chrono::duration<double>(_now - last_advance).count()};
+        last_advance = _now;
+        if (direction == 0) return;
+        step_remainder += direction * speed * config.steps_per_degree * elapsed;
+        const int64_t steps{static_cast<int64_t>(step_remainder)};
+        step_remainder -= steps;
+        for (int64_t i{}; i != steps; i += direction) {
+            true_steps += direction;
+            counted_steps += direction;
+            if (wrap(true_steps) == zeroSteps()) zeroCrossed();
+        }
+    }
+
+    // azimuth counted by the encoder (the one sent to the controller)
+    int azimuth() const { return static_cast<int>(wrap(counted_steps) / config.steps_per_degree) % 360; }
+    // real dome azimuth
+    int trueAzimuth() const { return static_cast<int>(wrap(true_steps) / config.steps_per_degree) % 360; }
+
+    bool sirenPlaying() const { return siren; }
+    bool zeroSearch() const { return zero_search; }
+    bool zeroEnabled() const { return zero_enabled; }
+    const Config &configuration() const { return config; }
+
+    //////////
+    // link
+
+    /**
+     * @brief Receive a byte from the controller.
+     */
+    void receive(const uint8_t _byte, const Clock::time_point _now) {
+        advance(_now);
+        if (!frame.empty() && _now - last_byte > frame_gap) frame.clear();
+        last_byte = _now;
+        if (frame.empty() && requestLength(_byte) == 0) return;  // noise or unknown command
+        frame.push_back(_byte);
+        if (frame.size() == requestLength(frame[0])) {
+            execute(_now);
+            frame.clear();
+        }
+    }
+
+    /**
+     * @brief Bytes to be sent to the controller that are due at the given time, already timed at the baud rate.
+     */
+    std::vector<uint8_t> transmit(const Clock::time_point _now) {
+        advance(_now);
+        std::vector<uint8_t> out{};
+        while (!tx.empty() && tx.front().due <= _now) {
+            out.push_back(tx.front().value);
+            tx.pop_front();
+        }
+        return out;
+    }
+
+    /**
+     * @brief Time of the next byte to be sent, Clock::time_point::max() if none.
+     */
+    Clock::time_point nextTransmission() const { return tx.empty() ? Clock::time_point::max() : tx.front().due; }
+
+   private:
+    struct TimedByte {
+        uint8_t value;
+        Clock::time_point due;
+    };
+
+    int64_t wrap(const int64_t _steps) const {
+        const int64_t revolution{config.steps_per_revolution};
+        return ((_steps % revolution) + revolution) % revolution;
+    }
+
+    int64_t zeroSteps() const { return static_cast<int64_t>(config.zero_azimuth) * config.steps_per_degree; }
+
+    void zeroCrossed() {
+        if (!zero_enabled) return;
+        // the zero switch realigns the counted position to the real one
+        counted_steps = true_steps;
+        if (zero_search) {
+            zero_search = false;
+            send({FindZero, static_cast<uint8_t>(config.zero_azimuth >> 8), static_cast<uint8_t>(config.zero_azimuth)}, last_advance);
+        }
+    }
+
+    void execute(const Clock::time_point _now) {
+        // any command stops the siren
+        siren = false;
+        switch (frame[0]) {
+            case Siren:
+                siren = true;
+                break;
+            case Position: {
+                const int position{azimuth()};
+                send({static_cast<uint8_t>(position >> 8), static_cast<uint8_t>(position)}, _now);
+                break;
+            }
+            case WritePosition: {
+                const int position{frame[1] << 8 | frame[2]};
+                if (position < 360) counted_steps = true_steps + (static_cast<int64_t>(position) * config.steps_per_degree - wrap(true_steps));
+                break;
+            }
+            case FindZero:
+                zero_search = zero_enabled;
+                break;
+            case DefaultConfig:
+                config = Config{};
+                zero_enabled = true;
+                break;
+            case DisableZero:
+                zero_enabled = false;
+                zero_search = false;
+                break;
+            case WriteConfig:
+                // ignored if the checksum is wrong
+                if (checksum(frame.data(), 8) == frame[8] && frame[1] != 0 && (frame[2] << 8 | frame[3]) != 0) {
+                    config.steps_per_degree = frame[1];
+                    config.steps_per_revolution = frame[2] << 8 | frame[3];
+                    config.zero_azimuth = frame[4] << 8 | frame[5];
+                    config.zero_offset_steps = frame[6] << 8 | frame[7];
+                }
+                break;
+            case ReadConfig: {
+                std::vector<uint8_t> response{config.bytes()};
+                response.push_back(checksum(response.data(), response.size()));
+                if (chance(faults.corrupt_checksum_probability)) response.back() ^= 0xFF;
+                send(response, _now);
+                break;
+            }
+        }
+    }
+
+    void send(const std::vector<uint8_t> &_bytes, const Clock::time_point _now) {
+        microseconds delay{processing_time + faults.latency};
+        if (faults.jitter.count() > 0) delay += microseconds{std::uniform_int_distribution<int64_t>{0, faults.jitter.count()}(rng)};
+        // the line is busy until the end of the previous response
+        Clock::time_point due{std::max(_now + delay, tx.empty() ? Clock::time_point{} : tx.back().due)};
+        for (auto i : _bytes) {
+            due += byteTime(baud);
+            if (!chance(faults.drop_probability)) tx.push_back({i, due});
+        }
+    }
+
+    bool chance(const double _probability) {
+        return _probability > 0 && std::uniform_real_distribution<double>{0, 1}(rng) < _probability;
+    }
+
+    const int baud;
+    std::mt19937 rng;
+    Config config{};
+
+    int direction{0};
+    double speed{3};  // degrees per second
+    double step_remainder{0};
+    int64_t true_steps{0};
+    int64_t counted_steps{0};
+    Clock::time_point last_advance{};
+
+    bool siren{false};
+    bool zero_search{false};
+    bool zero_enabled{true};
+
+    std::vector<uint8_t> frame{};
+    Clock::time_point last_byte{};
+    std::deque<TimedByte> tx{};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// IN-PROCESS LINK
+
+/* Controller side of an in-process link with the simulator: the request bytes
+ * are delivered at the baud rate, and read() behaves like the firmware reader
+ * (first byte and inter-byte timeouts), waiting in real time. */
+class BytePipe {
+   public:
+    explicit BytePipe(Simulator &_simulator, const int _baud = 19200) : simulator{_simulator}, baud{_baud} {}
+
+    void write(const std::vector<uint8_t> &_bytes) {
+        Clock::time_point now{Clock::now()};
+        // discard stale data already received, as writeToSerial485 does
+        simulator.transmit(now);
+        for (auto i : _bytes) {
+            now += byteTime(baud);
+            simulator.receive(i, now);
+        }
+        waitUntil(now);
+    }
+
+    /**
+     * @brief Read a response frame.
+     * @param _frame_size expected frame length, 0 if unknown
+     * @param _first_byte_timeout max time to wait for the first byte
+     * @param _inter_byte_timeout max time to wait between two bytes
+     */
+    std::vector<uint8_t> read(const size_t _frame_size, const microseconds _first_byte_timeout, const microseconds _inter_byte_timeout) {
+        std::vector<uint8_t> buffer{};
+        Clock::time_point deadline{Clock::now() + _first_byte_timeout};
+        while (_frame_size == 0 || buffer.size() < _frame_size) {
+            const Clock::time_point next{std::min(simulator.nextTransmission(), deadline)};
+            waitUntil(next);
+            const std::vector<uint8_t> bytes{simulator.transmit(next)};
+            if (bytes.empty()) break;  // timeout
+            buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+            deadline = next + _inter_byte_timeout;
+        }
+        return buffer;
+    }
+
+   private:
+    // sleep for the most part of the wait, then spin to keep microsecond accuracy
+    static void waitUntil(const Clock::time_point _time) {
+        if (_time - Clock::now() > microseconds{1000}) std::this_thread::sleep_until(_time - microseconds{1000});
+        while (Clock::now() < _time) {
+        }
+    }
+
+    Simulator &simulator;
+    const int baud;
+};
+
+}  // namespace plc
+
+#endif  // _PLC_SIMULATOR_HPP_
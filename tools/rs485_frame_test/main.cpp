@@ -0,0 +1,217 @@
+/*
+Remote REST dome controller
+https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+         Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* Host test of the frame logic of the dome RS485 reader (RS485Frame library):
+ * the responses of the PLC simulator, or scripted byte streams, are given to
+ * the parser with the timing of readFromSerial485 (first byte and inter-byte
+ * timeouts), in simulated time, and the completion time of each reading is
+ * checked: a complete frame must end the reading at its last byte. */
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "RS485Frame.hpp"
+#include "plc_simulator.hpp"
+
+using namespace plc;
+
+// timeouts used by the dome firmware (RS485_RESPONSE_TIMEOUT and RS485_INTER_BYTE_TIMEOUT)
+#define RESPONSE_TIMEOUT microseconds(300000)
+#define INTER_BYTE_TIMEOUT microseconds(30000)
+
+struct TimedByte {
+    uint8_t value;
+    Clock::time_point due;
+};
+
+struct Reading {
+    std::vector<uint8_t> response;
+    std::vector<uint8_t> zero_frame;
+    bool complete;
+    Clock::time_point end;
+};
+
+int failures{0};
+
+void check(const bool _condition, const std::string &_test, const std::string &_description) {
+    std::cout << (_condition ? "[pass] " : "[FAIL] ") << _test << ": " << _description << std::endl;
+    if (!_condition) ++failures;
+}
+
+long long us(const Clock::duration _duration) {
+    return std::chrono::duration_cast<microseconds>(_duration).count();
+}
+
+//////////
+
+// all the bytes the simulator is going to send, with their time
+std::vector<TimedByte> collect(Simulator &_simulator) {
+    std::vector<TimedByte> stream{};
+    for (Clock::time_point next{_simulator.nextTransmission()}; next != Clock::time_point::max(); next = _simulator.nextTransmission())
+        for (auto i : _simulator.transmit(next)) stream.push_back({i, next});
+    return stream;
+}
+
+// send a request to the simulator at the baud rate, return the end of the writing
+Clock::time_point request(Simulator &_simulator, const std::vector<uint8_t> &_bytes, Clock::time_point _time) {
+    for (auto i : _bytes) {
+        _time += byteTime(19200);
+        _simulator.receive(i, _time);
+    }
+    return _time;
+}
+
+/**
+ * @brief Read a response as readFromSerial485 does, in simulated time: the bytes already received at the start are
+ * parsed at once, then the reading waits for the next byte up to the first byte or inter-byte timeout, and ends as
+ * soon as the frame is complete.
+ */
+Reading read(const std::vector<TimedByte> &_stream, const uint8_t _command, const bool _demux, const Clock::time_point _start) {
+    RS485FrameParser parser{_command, _demux};
+    Reading reading{{}, {}, false, _start};
+    Clock::time_point deadline{_start + RESPONSE_TIMEOUT};
+    for (const TimedByte &i : _stream) {
+        const Clock::time_point arrival{std::max(i.due, _start)};
+        if (arrival > deadline) break;
+        reading.end = arrival;
+        switch (parser.feed(i.value)) {
+            case RS485FrameEvent::Response:
+            case RS485FrameEvent::Complete:
+                reading.response.push_back(i.value);
+                break;
+            case RS485FrameEvent::ZeroComplete:
+                reading.zero_frame.assign(parser.zeroFrame(), parser.zeroFrame() + 3);
+                break;
+            default:
+                break;
+        }
+        if (parser.complete()) break;
+        deadline = arrival + (parser.waitingFirstByte() ? RESPONSE_TIMEOUT : INTER_BYTE_TIMEOUT);
+    }
+    reading.complete = parser.complete();
+    if (!reading.complete) reading.end = deadline;
+    return reading;
+}
+
+//////////
+
+void testPosition() {
+    Simulator simulator{};
+    const Clock::time_point start{Clock::time_point{} + std::chrono::seconds{1}};
+    simulator.advance(start);
+    const Clock::time_point written{request(simulator, {Position}, start)};
+    const std::vector<TimedByte> stream{collect(simulator)};
+    const Reading reading{read(stream, Position, false, written)};
+    // PLC processing time, then two bytes at 19200 baud
+    const Clock::time_point expected{written + simulator.processing_time + 2 * byteTime(19200)};
+    check(reading.complete && reading.response.size() == 2, "position", "frame of 2 bytes complete");
+    check(reading.end == expected, "position", "reading ended at the last byte, " + std::to_string(us(reading.end - written)) + " us after the request");
+    check(reading.end - written < INTER_BYTE_TIMEOUT, "position", "no wait for a timeout after the frame");
+}
+
+void testConfiguration() {
+    Simulator simulator{};
+    const Clock::time_point start{Clock::time_point{} + std::chrono::seconds{1}};
+    simulator.advance(start);
+    const Clock::time_point written{request(simulator, {ReadConfig}, start)};
+    const std::vector<TimedByte> stream{collect(simulator)};
+    const Reading reading{read(stream, ReadConfig, false, written)};
+    check(reading.complete && reading.response.size() == 8, "configuration", "frame of 8 bytes complete");
+    check(reading.end == stream.back().due, "configuration", "reading ended at the last byte, " + std::to_string(us(reading.end - written)) + " us after the request");
+    check(checksum(reading.response.data(), 7) == reading.response[7], "configuration", "checksum valid");
+}
+
+void testZeroDemux() {
+    // the zero switch is crossed while the position is read: the zero frame arrives before the position response
+    Simulator simulator{};
+    const Clock::time_point start{Clock::time_point{} + std::chrono::seconds{1}};
+    simulator.advance(start);
+    request(simulator, {FindZero}, start);
+    simulator.setSpeed(360, start);
+    simulator.setMotion(-1, start);
+    // 90 degrees from the zero switch, crossed after 250 ms
+    const Clock::time_point polled{start + std::chrono::milliseconds{300}};
+    simulator.advance(polled);
+    simulator.setMotion(0, polled);
+    const Clock::time_point written{request(simulator, {Position}, polled)};
+    const std::vector<TimedByte> stream{collect(simulator)};
+    const Reading reading{read(stream, Position, true, written)};
+    check(reading.zero_frame.size() == 3 && reading.zero_frame[0] == FindZero, "zero demux", "zero frame picked out of the position response");
+    check(reading.complete && reading.response.size() == 2, "zero demux", "position frame of 2 bytes complete");
+    check(reading.end == stream.back().due, "zero demux", "reading ended at the last position byte, " + std::to_string(us(reading.end - written)) + " us after the request");
+}
+
+void testDroppedByte() {
+    Simulator simulator{};
+    const Clock::time_point start{Clock::time_point{} + std::chrono::seconds{1}};
+    simulator.advance(start);
+    const Clock::time_point written{request(simulator, {Position}, start)};
+    std::vector<TimedByte> stream{collect(simulator)};
+    stream.pop_back();
+    const Reading reading{read(stream, Position, false, written)};
+    check(!reading.complete && reading.response.size() == 1, "dropped byte", "short frame of 1 byte");
+    check(reading.end == stream.back().due + INTER_BYTE_TIMEOUT, "dropped byte", "reading ended after the inter-byte timeout");
+}
+
+void testNoResponse() {
+    const Clock::time_point start{Clock::time_point{} + std::chrono::seconds{1}};
+    const Reading reading{read({}, Position, false, start)};
+    check(!reading.complete && reading.response.empty(), "no response", "no data");
+    check(reading.end == start + RESPONSE_TIMEOUT, "no response", "reading ended after the first byte timeout");
+}
+
+void testStaleByteBeforeZero() {
+    // a late byte of a previous response is waiting when the zero frame is read (processZeroSerial485)
+    const Clock::time_point start{Clock::time_point{} + std::chrono::seconds{1}};
+    check(!frameStartSerial485(FindZero, 0x01) && frameStartSerial485(FindZero, FindZero), "stale byte", "only 0x5A starts a zero frame");
+    const std::vector<TimedByte> stream{{0x01, start},
+                                        {FindZero, start + microseconds{2000}},
+                                        {0x00, start + microseconds{2521}},
+                                        {0xF8, start + microseconds{3042}}};
+    const Reading reading{read(stream, FindZero, false, start)};
+    check(reading.complete && reading.response == std::vector<uint8_t>({FindZero, 0x00, 0xF8}), "stale byte", "stale byte skipped, zero frame complete");
+    check(reading.end == stream.back().due, "stale byte", "reading ended at the last byte of the zero frame");
+    const Reading stale{read({{0x01, start}}, FindZero, false, start)};
+    check(!stale.complete && stale.response.empty(), "stale byte", "a stale byte alone is not a zero frame");
+}
+
+//////////
+
+int main() {
+    testPosition();
+    testConfiguration();
+    testZeroDemux();
+    testDroppedByte();
+    testNoResponse();
+    testStaleByteBeforeZero();
+    std::cout << (failures == 0 ? "all tests passed" : std::to_string(failures) + " tests failed") << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+/*
+Remote REST dome controller
+https://github.com/societa-astronomica-g-v-schiaparelli/remote_REST_dome_controller
+
+Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+SPDX-License-Identifier: MIT
+Copyright (c) 2020-2022, Società Astronomica G. V. Schiaparelli <https://www.astrogeo.va.it/>.
+Authors: Paolo Galli <paolo.galli@astrogeo.va.it>
+         Luca Ghirotto <luca.ghirotto@astrogeo.va.it>
+
+Permission is hereby  granted, free of charge, to any  person obtaining a copy
+of this software and associated  documentation files (the "Software"), to deal
+in the Software  without restriction, including without  limitation the rights
+to  use, copy,  modify, merge,  publish, distribute,  sublicense, and/or  sell
+copies  of  the Software,  and  to  permit persons  to  whom  the Software  is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE  IS PROVIDED "AS  IS", WITHOUT WARRANTY  OF ANY KIND,  EXPRESS OR
+IMPLIED,  INCLUDING BUT  NOT  LIMITED TO  THE  WARRANTIES OF  MERCHANTABILITY,
+FITNESS FOR  A PARTICULAR PURPOSE AND  NONINFRINGEMENT. IN NO EVENT  SHALL THE
+AUTHORS  OR COPYRIGHT  HOLDERS  BE  LIABLE FOR  ANY  CLAIM,  DAMAGES OR  OTHER
+LIABILITY, WHETHER IN AN ACTION OF  CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE  OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* Host benchmark of the web asset lookup of a board firmware: the flash bundle
+ * (web_assets_bundle.h, generated by web_assets.py, perfect hash of the url)
+ * against the asset list of the SPIFFS version (a vector loaded at startup
+ * from assets.json, searched by url). For each asset, and for an unknown url,
+ * the mean time of a lookup is printed, in ns, with the time to build the
+ * list at startup. The SPIFFS accesses (mount, list parse, open and reads of
+ * the files) are not part of it: they can only be measured on the board. */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define API_REGISTRY_HOST
+#include "api_registry.hpp"
+
+#define PROGMEM
+
+// as in global_definitions.hpp
+struct WebAsset {
+    const char *url;  // nullptr if empty slot
+    const char *type;
+    const char *etag;
+    bool immutable;       // hashed name, cached by the browsers without revalidation
+    const uint8_t *data;  // gzipped, in flash
+    size_t length;
+};
+
+#include "web_assets_bundle.h"
+
+// iterations of each timed loop
+#define ITERATIONS 1000000
+
+typedef std::chrono::steady_clock Clock;
+
+// sink, so that the timed calls are not optimized away
+volatile uintptr_t lookup_sink;
+
+int failures{0};
+
+// mean time of a call, in ns
+template <typename F>
+double timeCall(F _call, const uint32_t _iterations = ITERATIONS) {
+    const Clock::time_point start{Clock::now()};
+    for (uint32_t i{}; i < _iterations; ++i) _call();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / _iterations;
+}
+
+//////////
+
+// bundle lookup, as findWebAsset in web_server.cpp
+const WebAsset *findWebAsset(const char *_url) {
+    const WebAsset &asset{web_assets[fnv1aHash(_url, WEB_ASSETS_SEED) >> (32 - WEB_ASSETS_SLOT_BITS)]};
+    return asset.url != nullptr && strcmp(asset.url, _url) == 0 ? &asset : nullptr;
+}
+
+// web asset of the SPIFFS version, loaded from assets.json (String fields, std::string here)
+struct ListedAsset {
+    std::string url;
+    std::string file;  // gzipped file
+    std::string type;
+    std::string etag;
+    bool immutable;
+};
+std::vector<ListedAsset> listed_assets{};
+
+// startup of the SPIFFS version, list parse excluded: the copy of the entries
+void loadListedAssets() {
+    listed_assets.clear();
+    for (const WebAsset &asset : web_assets)
+        if (asset.url != nullptr) listed_assets.push_back(ListedAsset{asset.url, std::string{asset.url} + ".gz", asset.type, asset.etag, asset.immutable});
+}
+
+// lookup of the SPIFFS version, by url (request->url() is a String)
+const ListedAsset *findListedAsset(const std::string &_url) {
+    for (const ListedAsset &asset : listed_assets)
+        if (asset.url == _url) return &asset;
+    return nullptr;
+}
+
+//////////
+
+int main() {
+    const double startup{timeCall(loadListedAssets, 10000)};
+
+    std::printf("%-36s %10s %10s\n", "url", "bundle", "list");
+    std::vector<std::string> urls{};
+    for (const WebAsset &asset : web_assets)
+        if (asset.url != nullptr) urls.push_back(asset.url);
+    urls.push_back("/no-such-asset.js");
+
+    double total_bundle{}, total_list{};
+    for (const std::string &url : urls) {
+        // the url is read through a volatile pointer, as a request url unknown at compile time
+        const char *volatile url_pointer{url.c_str()};
+        const std::string url_string{url};
+        const double bundle{timeCall([&] { lookup_sink = reinterpret_cast<uintptr_t>(findWebAsset(url_pointer)); })};
+        const double list{timeCall([&] { lookup_sink = reinterpret_cast<uintptr_t>(findListedAsset(url_string)); })};
+
+        // the benchmark is meaningless if the lookups do not agree
+        const WebAsset *asset{findWebAsset(url.c_str())};
+        const ListedAsset *listed{findListedAsset(url)};
+        if ((asset == nullptr) != (listed == nullptr) || (asset != nullptr && url != asset->url)) {
+            std::printf("[FAIL] %s: lookups disagree\n", url.c_str());
+            ++failures;
+        }
+
+        std::printf("%-36s %10.1f %10.1f\n", url.c_str(), bundle, list);
+        total_bundle += bundle;
+        total_list += list;
+    }
+    std::printf("\nmean lookup: bundle %.1f ns, list %.1f ns over %u urls\n", total_bundle / urls.size(), total_list / urls.size(), static_cast<unsigned>(urls.size()));
+    std::printf("startup: bundle none (constant table), list %.1f ns to copy %u entries (SPIFFS mount and list parse excluded)\n", startup, static_cast<unsigned>(listed_assets.size()));
+
+    size_t bundle_size{};
+    for (const WebAsset &asset : web_assets) bundle_size += asset.length;
+    std::printf("bundle: %u assets, %u bytes gzipped, %u slots\n", static_cast<unsigned>(listed_assets.size()), static_cast<unsigned>(bundle_size), 1u << WEB_ASSETS_SLOT_BITS);
+
+    return failures == 0 ? 0 : 1;
+}